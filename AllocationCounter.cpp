@@ -0,0 +1,84 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+    std::atomic<uint64_t> allocations { 0 };
+
+    void* allocate(std::size_t bytes) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(bytes == 0 ? 1 : bytes);
+    }
+
+    void* allocateAligned(std::size_t bytes, std::size_t alignment) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        if (bytes == 0) bytes = 1;
+#ifdef _WIN32
+        return _aligned_malloc(bytes, alignment);
+#else
+        // aligned_alloc wants a multiple of the alignment
+        return std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+#endif
+    }
+
+    void release(void* p) {
+        std::free(p);
+    }
+
+    void releaseAligned(void* p) {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+}
+
+namespace Particles {
+
+    uint64_t heapAllocationCount() {
+        return allocations.load(std::memory_order_relaxed);
+    }
+}
+
+void* operator new(std::size_t bytes) {
+    if (void* p = allocate(bytes)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t bytes) {
+    if (void* p = allocate(bytes)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept {
+    return allocate(bytes);
+}
+
+void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept {
+    return allocate(bytes);
+}
+
+void* operator new(std::size_t bytes, std::align_val_t alignment) {
+    if (void* p = allocateAligned(bytes, (std::size_t)alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t bytes, std::align_val_t alignment) {
+    if (void* p = allocateAligned(bytes, (std::size_t)alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, std::size_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { releaseAligned(p); }
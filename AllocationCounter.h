@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Particles {
+
+    // Heap allocations made through the global operator new so far, by
+    // every thread. Only available in programs that link
+    // AllocationCounter.cpp, which replaces the global allocation functions
+    // (ParticleSimBench does, for its alloc suite).
+    uint64_t heapAllocationCount();
+}
@@ -1,23 +1,50 @@
 #include "Color.h"
 
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
 namespace Color {
     
     // Define the global attraction matrix
     AttractionMatrix attractionMatrix;
 
-    bool loadAttractionMatrixFromFile(const std::string& filename) {
+    AttractionMatrix randomAttractionMatrix(int numSpecies, uint32_t seed) {
+        std::mt19937 rng { seed };
+        std::uniform_int_distribution<int> halves(2, 10);
+        std::bernoulli_distribution negate(0.5);
+
+        AttractionMatrix matrix(numSpecies);
+        for (int from = 0; from < numSpecies; ++from) {
+            for (int to = 0; to < numSpecies; ++to) {
+                const float magnitude = 0.5f * (float)halves(rng);
+                matrix(from, to) = negate(rng) ? -magnitude : magnitude;
+            }
+        }
+        return matrix;
+    }
+
+    bool readAttractionMatrix(const std::string& filename, AttractionMatrix& matrix, std::string& error) {
         std::ifstream file(filename);
         if (!file.is_open()) {
-            std::cerr << "Warning: Could not open attraction matrix file '" << filename 
-                      << "'. Using default matrix." << std::endl;
-            attractionMatrix = getDefaultAttractionMatrix();
+            error = "could not open '" + filename + "'";
             return false;
         }
 
-        attractionMatrix.clear();
+        // Lines are collected at full size, as the species count is only
+        // known once the largest index has been seen
+        AttractionMatrix full(MAX_SPECIES);
+        std::array<bool, MAX_SPECIES * MAX_SPECIES> seen {};
+        int numSpecies = 0;
+        size_t entries = 0;
+        bool duplicate = false;
         std::string line;
-        
+        int lineNumber = 0;
+
         while (std::getline(file, line)) {
+            ++lineNumber;
             // Skip empty lines and comments
             if (line.empty() || line[0] == '#') {
                 continue;
@@ -26,38 +53,48 @@ namespace Color {
             std::istringstream iss(line);
             int fromSpecies, toSpecies;
             float attractionValue;
-            
-            if (iss >> fromSpecies >> toSpecies >> attractionValue) {
-                // Validate species indices
-                if (fromSpecies >= 0 && fromSpecies < NUM_SPECIES && 
-                    toSpecies >= 0 && toSpecies < NUM_SPECIES) {
-                    
-                    attractionMatrix.emplace_back(
-                        static_cast<ColorSpecies>(fromSpecies),
-                        static_cast<ColorSpecies>(toSpecies),
-                        attractionValue
-                    );
-                } else {
-                    std::cerr << "Warning: Invalid species indices in line: " << line << std::endl;
-                }
-            } else {
-                std::cerr << "Warning: Could not parse line: " << line << std::endl;
+
+            if (!(iss >> fromSpecies >> toSpecies >> attractionValue)) {
+                error = "could not parse line " + std::to_string(lineNumber) + ": " + line;
+                return false;
+            }
+            // Validate species indices
+            if (fromSpecies < 0 || fromSpecies >= MAX_SPECIES || toSpecies < 0 || toSpecies >= MAX_SPECIES) {
+                error = "invalid species indices in line " + std::to_string(lineNumber) + ": " + line;
+                return false;
             }
+            full(fromSpecies, toSpecies) = attractionValue;
+            duplicate |= seen[fromSpecies * MAX_SPECIES + toSpecies];
+            seen[fromSpecies * MAX_SPECIES + toSpecies] = true;
+            numSpecies = std::max(numSpecies, std::max(fromSpecies, toSpecies) + 1);
+            ++entries;
         }
 
-        file.close();
+        // Verify we have exactly one entry per (from, to) pair of the N species
+        matrix = AttractionMatrix(numSpecies);
+        for (int from = 0; from < numSpecies; ++from) {
+            for (int to = 0; to < numSpecies; ++to) {
+                matrix(from, to) = full(from, to);
+            }
+        }
+        if (numSpecies < MIN_SPECIES || duplicate || entries != matrix.size()) {
+            error = "expected one entry for each of the " + std::to_string(matrix.size())
+                  + " species pairs, but got " + std::to_string(entries) + " entries";
+            return false;
+        }
+        return true;
+    }
 
-        // Verify we have the expected number of entries (8x8 = 64)
-        if (attractionMatrix.size() != NUM_SPECIES * NUM_SPECIES) {
-            std::cerr << "Warning: Expected " << (NUM_SPECIES * NUM_SPECIES) 
-                      << " entries, but got " << attractionMatrix.size() 
-                      << ". Using default matrix." << std::endl;
+    bool loadAttractionMatrixFromFile(const std::string& filename) {
+        std::string error;
+        if (!readAttractionMatrix(filename, attractionMatrix, error)) {
+            std::cerr << "Warning: Attraction matrix " << error << ". Using default matrix." << std::endl;
             attractionMatrix = getDefaultAttractionMatrix();
             return false;
         }
 
         std::cout << "Successfully loaded attraction matrix from '" << filename 
-                  << "' with " << attractionMatrix.size() << " entries." << std::endl;
+                  << "' with " << speciesCount(attractionMatrix) << " species." << std::endl;
         return true;
     }
-}
+}
\ No newline at end of file
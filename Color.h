@@ -1,12 +1,9 @@
 #pragma once
 
-#include <vector>
-#include <tuple>
-#include <unordered_map>
-#include <functional>
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
 
 namespace Color {
 
@@ -14,32 +11,17 @@ namespace Color {
         float r;
         float g;
         float b;
-        bool operator==(const Color& other) const {
+        constexpr bool operator==(const Color& other) const {
             return r == other.r && g == other.g && b == other.b;
         }
-        bool operator!=(const Color& other) const {
+        constexpr bool operator!=(const Color& other) const {
             return !(*this == other);
         }
     };
 
-    struct ColorHash {
-        std::size_t operator()(const Color& color) const noexcept {
-            std::size_t h1 = std::hash<float>{}(color.r);
-            std::size_t h2 = std::hash<float>{}(color.g);
-            std::size_t h3 = std::hash<float>{}(color.b);
-            return h1 ^ (h2 << 1) ^ (h3 << 2);
-        }
-    };
-    struct ColorEq {
-        bool operator()(const Color& a, const Color& b) const noexcept {
-            return a.r == b.r && a.g == b.g && a.b == b.b;
-        }
-    };
-
-    using ColorMap  = std::unordered_map<Color, float, ColorHash, ColorEq>;
-    using ColorMM   = std::unordered_map<Color, ColorMap, ColorHash, ColorEq>;
-
-    enum ColorSpecies {
+    // Names of the first eight species (the classic palette). Species are
+    // plain indices, so any value up to MAX_SPECIES - 1 is a valid ColorSpecies.
+    enum ColorSpecies : int {
         RED,
         GREEN,
         BLUE,
@@ -50,115 +32,119 @@ namespace Color {
         ORANGE,
     };
 
-    constexpr int NUM_SPECIES = 8;
-
-    const std::unordered_map<ColorSpecies, Color> colorMap = {
-		{ColorSpecies::RED, Color{ 1.0f, 0.0f, 0.0f }},
-		{ColorSpecies::GREEN, Color{ 0.0f, 1.0f, 0.0f }},
-		{ColorSpecies::BLUE, Color{ 0.0f, 0.0f, 1.0f }},
-		{ColorSpecies::YELLOW, Color{ 1.0f, 1.0f, 0.0f }},
-		{ColorSpecies::CYAN, Color{ 0.0f, 1.0f, 1.0f }},
-		{ColorSpecies::MAGENTA, Color{ 1.0f, 0.0f, 1.0f }},
-		{ColorSpecies::PURPLE, Color{ 0.5f, 0.0f, 1.0f }},
-		{ColorSpecies::ORANGE, Color{ 1.0f, 0.5f, 0.0f }},
-	};
-
-    inline ColorSpecies colorToSpecies(const Color& color) {
-        // Map colors to species indices (0-5 for the 6 ColorSpecies enum values)
-        if (color.r == 1.0f && color.g == 0.0f && color.b == 0.0f) return ColorSpecies::RED;
-        if (color.r == 0.0f && color.g == 1.0f && color.b == 0.0f) return ColorSpecies::GREEN;
-        if (color.r == 0.0f && color.g == 0.0f && color.b == 1.0f) return ColorSpecies::BLUE;
-        if (color.r == 1.0f && color.g == 1.0f && color.b == 0.0f) return ColorSpecies::YELLOW;
-        if (color.r == 0.0f && color.g == 1.0f && color.b == 1.0f) return ColorSpecies::CYAN;
-        if (color.r == 1.0f && color.g == 0.0f && color.b == 1.0f) return ColorSpecies::MAGENTA;
-        if (color.r == 0.5f && color.g == 0.0f && color.b == 1.0f) return ColorSpecies::PURPLE;
-        if (color.r == 1.0f && color.g == 0.5f && color.b == 0.0f) return ColorSpecies::ORANGE;
-        return ColorSpecies::RED; // default to RED if no match
-    };
+    // The species count is that of the loaded attraction matrix; see
+    // speciesCount(). The GPU packs species ids into bytes, and larger
+    // matrices would not fit the shared-memory tile of the tiled kernel.
+    constexpr int MIN_SPECIES = 2;
+    constexpr int MAX_SPECIES = 64;
+    constexpr int DEFAULT_SPECIES = 8; // size of getDefaultAttractionMatrix()
+
+    // Up to this many species the force kernels keep a particle's whole
+    // attraction column in registers (CPU: one template instance per count)
+    constexpr int MAX_UNROLLED_SPECIES = 16;
+
+    // The classic palette, indexed by species
+    constexpr std::array<Color, DEFAULT_SPECIES> classicPalette = {{
+        { 1.0f, 0.0f, 0.0f }, // RED
+        { 0.0f, 1.0f, 0.0f }, // GREEN
+        { 0.0f, 0.0f, 1.0f }, // BLUE
+        { 1.0f, 1.0f, 0.0f }, // YELLOW
+        { 0.0f, 1.0f, 1.0f }, // CYAN
+        { 1.0f, 0.0f, 1.0f }, // MAGENTA
+        { 0.5f, 0.0f, 1.0f }, // PURPLE
+        { 1.0f, 0.5f, 0.0f }, // ORANGE
+    }};
+
+    // Colour of a species: the classic palette for matrices of up to eight
+    // species, otherwise numSpecies hues evenly spaced around the colour wheel
+    constexpr Color speciesColor(int species, int numSpecies) {
+        if (numSpecies <= DEFAULT_SPECIES) {
+            return classicPalette[species];
+        }
+
+        // Fully saturated hue, stepped evenly from red. hue - 2 * floor(hue / 2)
+        // is exact, so x matches 1 - |fmod(hue, 2) - 1| bit for bit.
+        const float hue = 6.0f * (float)species / (float)numSpecies;
+        const int sector = (int)hue;
+        const float wrapped = hue - 2.0f * (float)(sector / 2) - 1.0f;
+        const float x = 1.0f - (wrapped < 0.0f ? -wrapped : wrapped);
+        switch (sector % 6) {
+            case 0:  return Color{ 1.0f, x, 0.0f };
+            case 1:  return Color{ x, 1.0f, 0.0f };
+            case 2:  return Color{ 0.0f, 1.0f, x };
+            case 3:  return Color{ 0.0f, x, 1.0f };
+            case 4:  return Color{ x, 0.0f, 1.0f };
+            default: return Color{ 1.0f, 0.0f, x };
+        }
+    }
 
-    using AttractionRow = std::tuple<ColorSpecies, ColorSpecies, float>;
-    using AttractionMatrix = std::vector<AttractionRow>;
+    // Dense numSpecies x numSpecies attraction weights, row-major:
+    // (from, to) is the weight of the "from to weight" line of a matrix
+    // file. The storage is fixed-size so copies never touch the heap and
+    // data() can go straight to a texture or a force kernel.
+    class AttractionMatrix {
+    public:
+        AttractionMatrix() = default;
+        // numSpecies species, all weights zero
+        explicit AttractionMatrix(int numSpecies) : numSpecies(numSpecies) {}
+        // numSpecies species with row-major weights
+        AttractionMatrix(int numSpecies, const float* rowMajor) : numSpecies(numSpecies) {
+            for (size_t i = 0; i < size(); ++i) weights[i] = rowMajor[i];
+        }
+
+        int species() const { return numSpecies; }
+        // Weights held, numSpecies * numSpecies
+        size_t size() const { return (size_t)numSpecies * (size_t)numSpecies; }
+        bool empty() const { return numSpecies == 0; }
+
+        float operator()(int from, int to) const { return weights[from * numSpecies + to]; }
+        float& operator()(int from, int to) { return weights[from * numSpecies + to]; }
+
+        const float* data() const { return weights.data(); }
+        float* data() { return weights.data(); }
+
+    private:
+        int numSpecies { 0 };
+        std::array<float, MAX_SPECIES * MAX_SPECIES> weights {};
+    };
 
     // Global attraction matrix that will be populated from file
     extern AttractionMatrix attractionMatrix;
 
-    // Function to load attraction matrix from file
+    // Species in a matrix
+    inline int speciesCount(const AttractionMatrix& matrix) {
+        return matrix.species();
+    }
+
+    // numSpecies x numSpecies matrix drawn from seed, with weights like those
+    // of randomize_attractions.py: a multiple of 0.5 between 1 and 5 in
+    // magnitude, either sign
+    AttractionMatrix randomAttractionMatrix(int numSpecies, uint32_t seed);
+
+    // Parses an attraction matrix file into matrix, one "from to weight" line
+    // per pair. The species count is taken from the largest index in the
+    // file (MIN_SPECIES..MAX_SPECIES). On failure error says why and the
+    // contents of matrix are unspecified.
+    bool readAttractionMatrix(const std::string& filename, AttractionMatrix& matrix, std::string& error);
+
+    // Function to load attraction matrix from file into attractionMatrix,
+    // falling back to the default matrix if it cannot be read
     bool loadAttractionMatrixFromFile(const std::string& filename = "attraction_matrix.txt");
 
-    // Default attraction matrix (fallback if file loading fails)
+    // Default attraction matrix (fallback if file loading fails), one row
+    // per "from" species of the classic palette
+    constexpr float defaultAttractionWeights[DEFAULT_SPECIES * DEFAULT_SPECIES] = {
+         3.0f, -3.5f, -2.5f, -4.0f, -2.5f, -2.0f,  2.0f,  3.5f, // RED
+        -4.0f,  2.5f, -3.5f,  3.5f,  3.5f,  2.5f,  4.5f, -2.5f, // GREEN
+        -2.0f, -2.0f,  2.0f,  4.5f,  4.0f, -1.0f,  1.5f, -3.0f, // BLUE
+        -3.0f,  3.0f,  3.0f, -3.0f, -3.5f, -1.5f,  3.5f, -5.0f, // YELLOW
+         3.5f,  3.0f,  4.0f,  1.5f, -1.0f,  3.0f,  3.5f, -3.5f, // CYAN
+        -1.0f,  4.5f, -1.5f,  2.0f, -5.0f,  1.5f,  4.0f,  2.5f, // MAGENTA
+         4.0f,  2.0f,  2.5f, -4.5f, -4.5f, -5.0f, -4.5f, -5.0f, // PURPLE
+        -4.5f, -4.5f, -4.5f, -2.5f, -4.0f, -1.5f,  3.5f,  2.0f, // ORANGE
+    };
+
     inline AttractionMatrix getDefaultAttractionMatrix() {
-        return AttractionMatrix{
-            {ColorSpecies::RED, ColorSpecies::RED, 3.0f},
-            {ColorSpecies::RED, ColorSpecies::GREEN, -3.5f},
-            {ColorSpecies::RED, ColorSpecies::BLUE, -2.5f},
-            {ColorSpecies::RED, ColorSpecies::YELLOW, -4.0f},
-            {ColorSpecies::RED, ColorSpecies::CYAN, -2.5f},
-            {ColorSpecies::RED, ColorSpecies::MAGENTA, -2.0f},
-            {ColorSpecies::RED, ColorSpecies::PURPLE, 2.0f},
-            {ColorSpecies::RED, ColorSpecies::ORANGE, 3.5f},
-
-            {ColorSpecies::GREEN, ColorSpecies::RED, -4.0f},
-            {ColorSpecies::GREEN, ColorSpecies::GREEN, 2.5f},
-            {ColorSpecies::GREEN, ColorSpecies::BLUE, -3.5f},
-            {ColorSpecies::GREEN, ColorSpecies::YELLOW, 3.5f},
-            {ColorSpecies::GREEN, ColorSpecies::CYAN, 3.5f},
-            {ColorSpecies::GREEN, ColorSpecies::MAGENTA, 2.5f},
-            {ColorSpecies::GREEN, ColorSpecies::PURPLE, 4.5f},
-            {ColorSpecies::GREEN, ColorSpecies::ORANGE, -2.5f},
-
-            {ColorSpecies::BLUE, ColorSpecies::RED, -2.0f},
-            {ColorSpecies::BLUE, ColorSpecies::GREEN, -2.0f},
-            {ColorSpecies::BLUE, ColorSpecies::BLUE, 2.0f},
-            {ColorSpecies::BLUE, ColorSpecies::YELLOW, 4.5f},
-            {ColorSpecies::BLUE, ColorSpecies::CYAN, 4.0f},
-            {ColorSpecies::BLUE, ColorSpecies::MAGENTA, -1.0f},
-            {ColorSpecies::BLUE, ColorSpecies::PURPLE, 1.5f},
-            {ColorSpecies::BLUE, ColorSpecies::ORANGE, -3.0f},
-
-            {ColorSpecies::YELLOW, ColorSpecies::RED, -3.0f},
-            {ColorSpecies::YELLOW, ColorSpecies::GREEN, 3.0f},
-            {ColorSpecies::YELLOW, ColorSpecies::BLUE, 3.0f},
-            {ColorSpecies::YELLOW, ColorSpecies::YELLOW, -3.0f},
-            {ColorSpecies::YELLOW, ColorSpecies::CYAN, -3.5f},
-            {ColorSpecies::YELLOW, ColorSpecies::MAGENTA, -1.5f},
-            {ColorSpecies::YELLOW, ColorSpecies::PURPLE, 3.5f},
-            {ColorSpecies::YELLOW, ColorSpecies::ORANGE, -5.0f},
-
-            {ColorSpecies::CYAN, ColorSpecies::RED, 3.5f},
-            {ColorSpecies::CYAN, ColorSpecies::GREEN, 3.0f},
-            {ColorSpecies::CYAN, ColorSpecies::BLUE, 4.0f},
-            {ColorSpecies::CYAN, ColorSpecies::YELLOW, 1.5f},
-            {ColorSpecies::CYAN, ColorSpecies::CYAN, -1.0f},
-            {ColorSpecies::CYAN, ColorSpecies::MAGENTA, 3.0f},
-            {ColorSpecies::CYAN, ColorSpecies::PURPLE, 3.5f},
-            {ColorSpecies::CYAN, ColorSpecies::ORANGE, -3.5f},
-
-            {ColorSpecies::MAGENTA, ColorSpecies::RED, -1.0f},
-            {ColorSpecies::MAGENTA, ColorSpecies::GREEN, 4.5f},
-            {ColorSpecies::MAGENTA, ColorSpecies::BLUE, -1.5f},
-            {ColorSpecies::MAGENTA, ColorSpecies::YELLOW, 2.0f},
-            {ColorSpecies::MAGENTA, ColorSpecies::CYAN, -5.0f},
-            {ColorSpecies::MAGENTA, ColorSpecies::MAGENTA, 1.5f},
-            {ColorSpecies::MAGENTA, ColorSpecies::PURPLE, 4.0f},
-            {ColorSpecies::MAGENTA, ColorSpecies::ORANGE, 2.5f},
-
-            {ColorSpecies::PURPLE, ColorSpecies::RED, 4.0f},
-            {ColorSpecies::PURPLE, ColorSpecies::GREEN, 2.0f},
-            {ColorSpecies::PURPLE, ColorSpecies::BLUE, 2.5f},
-            {ColorSpecies::PURPLE, ColorSpecies::YELLOW, -4.5f},
-            {ColorSpecies::PURPLE, ColorSpecies::CYAN, -4.5f},
-            {ColorSpecies::PURPLE, ColorSpecies::MAGENTA, -5.0f},
-            {ColorSpecies::PURPLE, ColorSpecies::PURPLE, -4.5f},
-            {ColorSpecies::PURPLE, ColorSpecies::ORANGE, -5.0f},
-
-            {ColorSpecies::ORANGE, ColorSpecies::RED, -4.5f},
-            {ColorSpecies::ORANGE, ColorSpecies::GREEN, -4.5f},
-            {ColorSpecies::ORANGE, ColorSpecies::BLUE, -4.5f},
-            {ColorSpecies::ORANGE, ColorSpecies::YELLOW, -2.5f},
-            {ColorSpecies::ORANGE, ColorSpecies::CYAN, -4.0f},
-            {ColorSpecies::ORANGE, ColorSpecies::MAGENTA, -1.5f},
-            {ColorSpecies::ORANGE, ColorSpecies::PURPLE, 3.5f},
-            {ColorSpecies::ORANGE, ColorSpecies::ORANGE, 2.0f},
-        };
+        return AttractionMatrix(DEFAULT_SPECIES, defaultAttractionWeights);
     }
 }
\ No newline at end of file
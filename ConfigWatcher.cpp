@@ -0,0 +1,193 @@
+#include "ConfigWatcher.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Particles {
+
+    // An editor's save can be several events in quick succession (truncate,
+    // write, close, rename); events are collected until the files have been
+    // quiet this long before anything is reparsed
+    constexpr int kSettleMs = 50;
+
+    static void splitPath(const std::string& path, std::string& directory, std::string& name) {
+        const std::filesystem::path full(path);
+        directory = full.has_parent_path() ? full.parent_path().string() : std::string(".");
+        name = full.filename().string();
+    }
+
+    ConfigWatcher::~ConfigWatcher() {
+        stop();
+    }
+
+    bool ConfigWatcher::start(const std::string& matrixPath, const std::string& paramsPath, std::string& error) {
+        stop();
+        matrixFile = WatchedFile {};
+        matrixFile.path = matrixPath;
+        paramsFile = WatchedFile {};
+        paramsFile.path = paramsPath;
+
+#ifdef __linux__
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (inotifyFd < 0 || stopFd < 0) {
+            error = "could not create an inotify instance";
+            stop();
+            return false;
+        }
+#endif
+        for (WatchedFile* file : { &matrixFile, &paramsFile }) {
+            if (file->path.empty()) continue;
+            splitPath(file->path, file->directory, file->name);
+#ifdef __linux__
+            // Watching a directory twice returns the same descriptor
+            file->watch = inotify_add_watch(inotifyFd, file->directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (file->watch < 0) {
+                error = "could not watch '" + file->directory + "'";
+                stop();
+                return false;
+            }
+#endif
+        }
+
+#ifndef __linux__
+        stopping = false;
+#endif
+        worker = std::thread([this] { run(); });
+        return true;
+    }
+
+    void ConfigWatcher::stop() {
+        if (worker.joinable()) {
+#ifdef __linux__
+            const uint64_t one = 1;
+            if (write(stopFd, &one, sizeof(one)) != (ssize_t)sizeof(one)) {
+                std::cout << "Config watcher: could not signal the worker" << std::endl;
+            }
+#else
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+#endif
+            worker.join();
+        }
+#ifdef __linux__
+        if (inotifyFd >= 0) close(inotifyFd);
+        if (stopFd >= 0) close(stopFd);
+        inotifyFd = -1;
+        stopFd = -1;
+#endif
+    }
+
+    bool ConfigWatcher::poll(ConfigUpdate& update, const SimulationParams& current) {
+        if (!ready.load(std::memory_order_acquire)) return false;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        update = std::move(pending);
+        update.params.integrator = current.integrator;
+        pending = ConfigUpdate {};
+        ready.store(false, std::memory_order_release);
+        return update.hasMatrix || update.hasParams;
+    }
+
+    void ConfigWatcher::reload(bool matrixChanged, bool paramsChanged) {
+        ConfigUpdate parsed;
+        std::string error;
+        if (matrixChanged) {
+            parsed.hasMatrix = Color::readAttractionMatrix(matrixFile.path, parsed.matrix, error);
+            if (!parsed.hasMatrix) {
+                std::cout << "Attraction matrix not reloaded: " << error << std::endl;
+            }
+        }
+        if (paramsChanged) {
+            parsed.hasParams = readSimulationParams(paramsFile.path, parsed.params, error);
+            if (!parsed.hasParams) {
+                std::cout << "Simulation parameters not reloaded: " << error << std::endl;
+            }
+        }
+        if (!parsed.hasMatrix && !parsed.hasParams) return;
+
+        // Merge with anything the main thread has not picked up yet
+        std::lock_guard<std::mutex> lock(mutex);
+        if (parsed.hasMatrix) {
+            pending.matrix = std::move(parsed.matrix);
+            pending.hasMatrix = true;
+        }
+        if (parsed.hasParams) {
+            pending.params = parsed.params;
+            pending.hasParams = true;
+        }
+        ready.store(true, std::memory_order_release);
+    }
+
+#ifdef __linux__
+    void ConfigWatcher::run() {
+        pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { stopFd, POLLIN, 0 } };
+        alignas(inotify_event) char buffer[4096];
+
+        for (;;) {
+            if (::poll(fds, 2, -1) < 0) continue; // EINTR
+            if (fds[1].revents != 0) return;
+
+            bool matrixChanged = false;
+            bool paramsChanged = false;
+            do {
+                ssize_t length;
+                while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                    for (char* at = buffer; at < buffer + length;) {
+                        const inotify_event* event = reinterpret_cast<const inotify_event*>(at);
+                        if (event->len > 0) {
+                            const std::string name = event->name;
+                            matrixChanged |= event->wd == matrixFile.watch && name == matrixFile.name;
+                            paramsChanged |= event->wd == paramsFile.watch && name == paramsFile.name;
+                        }
+                        at += sizeof(inotify_event) + event->len;
+                    }
+                }
+                fds[0].revents = 0;
+            } while (::poll(fds, 1, kSettleMs) > 0);
+
+            reload(matrixChanged, paramsChanged);
+        }
+    }
+#else
+    void ConfigWatcher::run() {
+        using TimePoint = std::filesystem::file_time_type;
+        auto modified = [](const WatchedFile& file) {
+            std::error_code ec;
+            const TimePoint time = file.path.empty() ? TimePoint {} : std::filesystem::last_write_time(file.path, ec);
+            return ec ? TimePoint {} : time;
+        };
+        TimePoint matrixTime = modified(matrixFile);
+        TimePoint paramsTime = modified(paramsFile);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, std::chrono::milliseconds(250), [&] { return stopping; })) {
+            lock.unlock();
+            const TimePoint matrixNow = modified(matrixFile);
+            const TimePoint paramsNow = modified(paramsFile);
+            const bool matrixChanged = matrixNow != matrixTime;
+            const bool paramsChanged = paramsNow != paramsTime;
+            if (matrixChanged || paramsChanged) {
+                // Let the writer finish before reading
+                std::this_thread::sleep_for(std::chrono::milliseconds(kSettleMs));
+                matrixTime = modified(matrixFile);
+                paramsTime = modified(paramsFile);
+                reload(matrixChanged && matrixTime != TimePoint {}, paramsChanged && paramsTime != TimePoint {});
+            }
+            lock.lock();
+        }
+    }
+#endif
+}
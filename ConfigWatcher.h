@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Color.h"
+#include "SimulationParams.h"
+
+namespace Particles {
+
+    // Files reparsed since the last ConfigWatcher::poll(); only the ones
+    // that changed and parsed cleanly are set
+    struct ConfigUpdate {
+        bool hasMatrix = false;
+        Color::AttractionMatrix matrix;
+        bool hasParams = false;
+        SimulationParams params; // integrator is not part of the file
+    };
+
+    // Watches the attraction matrix and simulation parameter files and
+    // reparses them on a background thread whenever they are saved. On
+    // Linux this uses inotify on the files' directories, so editors that
+    // save by writing a new file and renaming it over the old one are seen
+    // too; elsewhere the modification times are checked four times a second.
+    // A file that does not parse is reported on stdout and the previous
+    // values stay in effect.
+    class ConfigWatcher {
+    public:
+        ConfigWatcher() = default;
+        ~ConfigWatcher();
+        ConfigWatcher(const ConfigWatcher&) = delete;
+        ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+        // Either path may be empty to leave that file alone. The files do
+        // not have to exist yet; creating one counts as a change.
+        bool start(const std::string& matrixPath, const std::string& paramsPath, std::string& error);
+        void stop();
+        bool isWatching() const { return worker.joinable(); }
+
+        // Moves the pending update into update; false (one atomic load) if
+        // nothing changed since the last call. The integrator of
+        // update.params is copied from the params passed in.
+        bool poll(ConfigUpdate& update, const SimulationParams& current);
+
+    private:
+        struct WatchedFile {
+            std::string path;
+            std::string directory;
+            std::string name;
+            int watch { -1 };
+        };
+
+        WatchedFile matrixFile;
+        WatchedFile paramsFile;
+
+        std::thread worker;
+        std::mutex mutex;
+        ConfigUpdate pending;
+        std::atomic<bool> ready { false };
+
+#ifdef __linux__
+        int inotifyFd { -1 };
+        int stopFd { -1 };
+#else
+        std::condition_variable wake;
+        bool stopping { false };
+#endif
+
+        void run();
+        void reload(bool matrixChanged, bool paramsChanged);
+    };
+}
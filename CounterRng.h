@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace Particles {
+
+    // Philox4x32-10, the counter-based generator of Salmon et al., "Parallel
+    // random numbers: as easy as 1, 2, 3" (SC '11). The output is a pure
+    // function of a 128-bit counter and a 64-bit key, so any element of a
+    // stream can be drawn directly, in any order and on any thread, and a
+    // GPU kernel doing the same integer arithmetic (Renderer's spawn pass)
+    // gets the same bits.
+    using PhiloxCounter = std::array<uint32_t, 4>;
+    using PhiloxKey = std::array<uint32_t, 2>;
+
+    inline PhiloxCounter philox4x32(PhiloxCounter counter, PhiloxKey key) {
+        constexpr uint32_t M0 = 0xD2511F53u;
+        constexpr uint32_t M1 = 0xCD9E8D57u;
+        constexpr uint32_t W0 = 0x9E3779B9u;
+        constexpr uint32_t W1 = 0xBB67AE85u;
+
+        for (int round = 0; round < 10; ++round) {
+            if (round > 0) {
+                key[0] += W0;
+                key[1] += W1;
+            }
+            const uint64_t product0 = (uint64_t)M0 * counter[0];
+            const uint64_t product1 = (uint64_t)M1 * counter[2];
+            counter = {
+                (uint32_t)(product1 >> 32) ^ counter[1] ^ key[0],
+                (uint32_t)product1,
+                (uint32_t)(product0 >> 32) ^ counter[3] ^ key[1],
+                (uint32_t)product0,
+            };
+        }
+        return counter;
+    }
+
+    // [0, 1) from the top 24 bits, so every value is exactly representable
+    inline float unitFloat(uint32_t bits) {
+        return (float)(bits >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // [0, bound) by multiply-shift: no division, and a bias of at most
+    // bound / 2^32
+    inline uint32_t boundedUint(uint32_t bits, uint32_t bound) {
+        return (uint32_t)(((uint64_t)bits * bound) >> 32);
+    }
+}
@@ -0,0 +1,98 @@
+#include "CpuForceKernel.h"
+
+#include <initializer_list>
+
+#if defined(PARTICLESIM_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Particles {
+
+    namespace {
+
+#if defined(PARTICLESIM_SIMD_X86)
+#if defined(_MSC_VER)
+        // CPUID feature bits, and XGETBV to check the OS saves the wider
+        // registers on context switches
+        bool cpuSupports(ForceKernelIsa isa) {
+            int regs[4];
+            __cpuid(regs, 0);
+            if (regs[0] < 7) return false;
+            __cpuid(regs, 1);
+            const bool osxsave = (regs[2] & (1 << 27)) != 0;
+            if (!osxsave) return false;
+            const unsigned long long xcr0 = _xgetbv(0);
+            __cpuidex(regs, 7, 0);
+            if (isa == ForceKernelIsa::Avx2) {
+                return (xcr0 & 0x6) == 0x6 && (regs[1] & (1 << 5)) != 0;
+            }
+            return (xcr0 & 0xe6) == 0xe6 && (regs[1] & (1 << 16)) != 0;
+        }
+#else
+        bool cpuSupports(ForceKernelIsa isa) {
+            __builtin_cpu_init();
+            return isa == ForceKernelIsa::Avx2 ? __builtin_cpu_supports("avx2") != 0
+                                               : __builtin_cpu_supports("avx512f") != 0;
+        }
+#endif
+#endif
+    }
+
+    const char* forceKernelName(ForceKernelIsa isa) {
+        switch (isa) {
+            case ForceKernelIsa::Scalar: return "scalar";
+            case ForceKernelIsa::Avx2: return "avx2";
+            case ForceKernelIsa::Avx512: return "avx512";
+            case ForceKernelIsa::Neon: return "neon";
+        }
+        return "scalar";
+    }
+
+    bool forceKernelAvailable(ForceKernelIsa isa) {
+        return isa == ForceKernelIsa::Scalar || forceSpanKernel(isa) != nullptr;
+    }
+
+    ForceKernelIsa bestForceKernel() {
+        for (ForceKernelIsa isa : { ForceKernelIsa::Avx512, ForceKernelIsa::Avx2, ForceKernelIsa::Neon }) {
+            if (forceSpanKernel(isa) != nullptr) return isa;
+        }
+        return ForceKernelIsa::Scalar;
+    }
+
+    ForceSpanKernel forceSpanKernel(ForceKernelIsa isa) {
+        switch (isa) {
+#if defined(PARTICLESIM_SIMD_X86)
+            case ForceKernelIsa::Avx2: {
+                static const bool supported = cpuSupports(ForceKernelIsa::Avx2);
+                return supported ? &forceSpanAvx2 : nullptr;
+            }
+            case ForceKernelIsa::Avx512: {
+                static const bool supported = cpuSupports(ForceKernelIsa::Avx512);
+                return supported ? &forceSpanAvx512 : nullptr;
+            }
+#endif
+#if defined(PARTICLESIM_SIMD_NEON)
+            // Advanced SIMD is part of the AArch64 baseline
+            case ForceKernelIsa::Neon:
+                return &forceSpanNeon;
+#endif
+            default:
+                return nullptr;
+        }
+    }
+
+    RadiusSpanKernel radiusSpanKernel(ForceKernelIsa isa) {
+        // Available exactly where the force kernel of the same set is
+        if (forceSpanKernel(isa) == nullptr) return nullptr;
+        switch (isa) {
+#if defined(PARTICLESIM_SIMD_X86)
+            case ForceKernelIsa::Avx2: return &radiusSpanAvx2;
+            case ForceKernelIsa::Avx512: return &radiusSpanAvx512;
+#endif
+#if defined(PARTICLESIM_SIMD_NEON)
+            case ForceKernelIsa::Neon: return &radiusSpanNeon;
+#endif
+            default: return nullptr;
+        }
+    }
+}
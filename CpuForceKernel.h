@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Particles {
+
+    // Explicitly vectorized versions of CpuSimulator's pairwise force loop.
+    // Each kernel adds up the force of a contiguous run of candidate slots
+    // (one row of grid cells) on one particle, 8 (AVX2), 16 (AVX-512) or 4
+    // (NEON) candidates at a time; the contact branch becomes a masked
+    // select and the attraction of each candidate's species is gathered
+    // from the particle's matrix column.
+    //
+    // Every lane computes each term with the same operations, in the same
+    // order and without FMA contraction, as the scalar loop; what differs is
+    // the order in which the terms are summed (per lane, then across lanes).
+    // Results stay independent of the thread count but are not bit-identical
+    // between instruction sets.
+    //
+    // The kernels are only built on targets that have them (see
+    // CMakeLists.txt) and only used when the running CPU supports them.
+    enum class ForceKernelIsa {
+        Scalar, // CpuSimulator's templated loop, the reference
+        Avx2,
+        Avx512,
+        Neon,
+    };
+
+    // Sorted-slot streams of the particles, as CpuSimulator keeps them
+    struct ForceStreams {
+        const float* x;
+        const float* y;
+        const float* radius;
+        const float* mass;
+        const int* species;
+    };
+
+    struct ForceLaw {
+        float maxDist;
+        float repelDist;
+        float forceScale;
+    };
+
+    // The particle the force acts on; column[s] is the attraction it feels
+    // towards species s
+    struct ForceSubject {
+        float x;
+        float y;
+        float radius;
+        float mass;
+        const float* column;
+    };
+
+    // Adds the force of slots [begin, end) on subject to dVx, dVy. The
+    // subject's own slot may be in the range: a zero distance contributes
+    // nothing, as in the scalar loop.
+    using ForceSpanKernel = void (*)(const ForceStreams& streams, const ForceLaw& law, const ForceSubject& subject,
+                                     uint32_t begin, uint32_t end, float& dVx, float& dVy);
+
+    const char* forceKernelName(ForceKernelIsa isa);
+    // Compiled in and supported by this CPU; Scalar always is
+    bool forceKernelAvailable(ForceKernelIsa isa);
+    // The widest available kernel
+    ForceKernelIsa bestForceKernel();
+    // nullptr for Scalar and for kernels that are not available
+    ForceSpanKernel forceSpanKernel(ForceKernelIsa isa);
+
+    // Radius filter of the metrics neighbour pass (see Metrics.h): the slots
+    // j of [begin, end) with dx^2 + dy^2 <= radiusSquared, where dx =
+    // (x[j] - query.x) - query.offsetX and likewise dy, are written to hits
+    // in order and counted. The same operations as the scalar filter in
+    // CpuSimulator::computeMetrics(), so the same slots pass. hits must have
+    // room for end - begin + 16 entries: the kernels store whole blocks.
+    struct RadiusQuery {
+        float x;
+        float y;
+        float offsetX;
+        float offsetY;
+        float radiusSquared;
+    };
+
+    using RadiusSpanKernel = uint32_t (*)(const float* x, const float* y, const RadiusQuery& query,
+                                          uint32_t begin, uint32_t end, uint32_t* hits);
+
+    // nullptr for Scalar and for kernels that are not available
+    RadiusSpanKernel radiusSpanKernel(ForceKernelIsa isa);
+
+    // Per-instruction-set entry points, each in its own translation unit
+    // compiled for that instruction set
+    void forceSpanAvx2(const ForceStreams& streams, const ForceLaw& law, const ForceSubject& subject,
+                       uint32_t begin, uint32_t end, float& dVx, float& dVy);
+    void forceSpanAvx512(const ForceStreams& streams, const ForceLaw& law, const ForceSubject& subject,
+                         uint32_t begin, uint32_t end, float& dVx, float& dVy);
+    void forceSpanNeon(const ForceStreams& streams, const ForceLaw& law, const ForceSubject& subject,
+                       uint32_t begin, uint32_t end, float& dVx, float& dVy);
+    uint32_t radiusSpanAvx2(const float* x, const float* y, const RadiusQuery& query,
+                            uint32_t begin, uint32_t end, uint32_t* hits);
+    uint32_t radiusSpanAvx512(const float* x, const float* y, const RadiusQuery& query,
+                              uint32_t begin, uint32_t end, uint32_t* hits);
+    uint32_t radiusSpanNeon(const float* x, const float* y, const RadiusQuery& query,
+                            uint32_t begin, uint32_t end, uint32_t* hits);
+}
@@ -0,0 +1,148 @@
+// Compiled with AVX2 enabled (see CMakeLists.txt). Only intrinsics are
+// used here: an inline library function instantiated in this file could
+// otherwise be picked by the linker for the scalar code as well.
+#include "CpuForceKernel.h"
+
+#include <immintrin.h>
+
+namespace Particles {
+
+    namespace {
+
+        struct Lanes {
+            __m256 xi, yi, ri, mi;
+            __m256 maxDist, repelDist, forceScale;
+            __m256 signBit;
+        };
+
+        // One block of 8 candidates; inactive lanes must have been loaded as 0
+        inline void accumulate8(const Lanes& l, const float* column, __m256 active,
+                                __m256 xj, __m256 yj, __m256 rj, __m256 mj, __m256i sj,
+                                __m256& accX, __m256& accY) {
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 dx = _mm256_sub_ps(xj, l.xi);
+            const __m256 dy = _mm256_sub_ps(yj, l.yi);
+            const __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            const __m256 dist = _mm256_sqrt_ps(d2);
+            __m256 valid = _mm256_and_ps(active, _mm256_cmp_ps(d2, zero, _CMP_NEQ_OQ));
+            valid = _mm256_and_ps(valid, _mm256_cmp_ps(dist, l.maxDist, _CMP_LE_OQ));
+
+            const __m256 invd2 = _mm256_div_ps(_mm256_set1_ps(1.0f), d2);
+            const __m256 kij = _mm256_i32gather_ps(column, sj, 4);
+            const __m256 massProd = _mm256_mul_ps(l.mi, mj);
+
+            // Attraction beyond contact + repelDist, repulsion inside it
+            const __m256 contact = _mm256_add_ps(l.ri, rj);
+            const __m256 outside = _mm256_cmp_ps(dist, _mm256_add_ps(contact, l.repelDist), _CMP_GT_OQ);
+            const __m256 attract = _mm256_mul_ps(_mm256_mul_ps(kij, massProd), invd2);
+            const __m256 kAbs = _mm256_andnot_ps(l.signBit, kij);
+            const __m256 repelMag = _mm256_blendv_ps(massProd, _mm256_mul_ps(kAbs, massProd),
+                                                     _mm256_cmp_ps(kij, zero, _CMP_NEQ_OQ));
+            const __m256 repel = _mm256_mul_ps(_mm256_xor_ps(repelMag, l.signBit), invd2);
+            __m256 f = _mm256_blendv_ps(repel, attract, outside);
+            f = _mm256_and_ps(f, valid);
+
+            const __m256 scaled = _mm256_mul_ps(l.forceScale, f);
+            accX = _mm256_add_ps(accX, _mm256_mul_ps(scaled, dx));
+            accY = _mm256_add_ps(accY, _mm256_mul_ps(scaled, dy));
+        }
+
+        // Lane indices of the set bits of an 8-bit mask, packed one per byte
+        // from the lowest, and their count
+        struct CompressTable {
+            unsigned long long lanes[256];
+            unsigned char counts[256];
+        };
+
+        constexpr CompressTable makeCompressTable() {
+            CompressTable table {};
+            for (int mask = 0; mask < 256; ++mask) {
+                int count = 0;
+                for (int lane = 0; lane < 8; ++lane) {
+                    if (mask & (1 << lane)) {
+                        table.lanes[mask] |= (unsigned long long)lane << (8 * count);
+                        ++count;
+                    }
+                }
+                table.counts[mask] = (unsigned char)count;
+            }
+            return table;
+        }
+
+        constexpr CompressTable kCompress = makeCompressTable();
+
+        inline float horizontalSum(__m256 v) {
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            return _mm_cvtss_f32(sum);
+        }
+    }
+
+    void forceSpanAvx2(const ForceStreams& streams, const ForceLaw& law, const ForceSubject& subject,
+                       uint32_t begin, uint32_t end, float& dVx, float& dVy) {
+        Lanes l;
+        l.xi = _mm256_set1_ps(subject.x);
+        l.yi = _mm256_set1_ps(subject.y);
+        l.ri = _mm256_set1_ps(subject.radius);
+        l.mi = _mm256_set1_ps(subject.mass);
+        l.maxDist = _mm256_set1_ps(law.maxDist);
+        l.repelDist = _mm256_set1_ps(law.repelDist);
+        l.forceScale = _mm256_set1_ps(law.forceScale);
+        l.signBit = _mm256_set1_ps(-0.0f);
+
+        __m256 accX = _mm256_setzero_ps();
+        __m256 accY = _mm256_setzero_ps();
+        const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        uint32_t k = begin;
+        for (; k + 8 <= end; k += 8) {
+            accumulate8(l, subject.column, all,
+                        _mm256_loadu_ps(streams.x + k), _mm256_loadu_ps(streams.y + k),
+                        _mm256_loadu_ps(streams.radius + k), _mm256_loadu_ps(streams.mass + k),
+                        _mm256_loadu_si256((const __m256i*)(streams.species + k)), accX, accY);
+        }
+        if (k < end) {
+            // Masked loads read nothing past end and give 0 (species 0) there
+            const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(end - k)), lane);
+            accumulate8(l, subject.column, _mm256_castsi256_ps(mask),
+                        _mm256_maskload_ps(streams.x + k, mask), _mm256_maskload_ps(streams.y + k, mask),
+                        _mm256_maskload_ps(streams.radius + k, mask), _mm256_maskload_ps(streams.mass + k, mask),
+                        _mm256_maskload_epi32(streams.species + k, mask), accX, accY);
+        }
+
+        dVx += horizontalSum(accX);
+        dVy += horizontalSum(accY);
+    }
+
+    uint32_t radiusSpanAvx2(const float* x, const float* y, const RadiusQuery& query,
+                            uint32_t begin, uint32_t end, uint32_t* hits) {
+        const __m256 xi = _mm256_set1_ps(query.x);
+        const __m256 yi = _mm256_set1_ps(query.y);
+        const __m256 offsetX = _mm256_set1_ps(query.offsetX);
+        const __m256 offsetY = _mm256_set1_ps(query.offsetY);
+        const __m256 radiusSquared = _mm256_set1_ps(query.radiusSquared);
+        const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        uint32_t count = 0;
+        for (uint32_t k = begin; k < end; k += 8) {
+            // Masked loads read nothing past end; their lanes are masked off below
+            const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(end - k)), lane);
+            const __m256 dx = _mm256_sub_ps(_mm256_sub_ps(_mm256_maskload_ps(x + k, mask), xi), offsetX);
+            const __m256 dy = _mm256_sub_ps(_mm256_sub_ps(_mm256_maskload_ps(y + k, mask), yi), offsetY);
+            const __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            const __m256 inside = _mm256_and_ps(_mm256_cmp_ps(d2, radiusSquared, _CMP_LE_OQ),
+                                                _mm256_castsi256_ps(mask));
+            const int bits = _mm256_movemask_ps(inside);
+
+            // Left-pack the passing slots: the whole block is stored, the
+            // count only covers the passing ones
+            const __m256i picked = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long)kCompress.lanes[bits]));
+            _mm256_storeu_si256((__m256i*)(hits + count),
+                                _mm256_add_epi32(_mm256_set1_epi32((int)k), picked));
+            count += kCompress.counts[bits];
+        }
+        return count;
+    }
+}
@@ -0,0 +1,123 @@
+// Compiled with AVX-512F enabled (see CMakeLists.txt); intrinsics only, as
+// in CpuForceKernelAvx2.cpp
+#include "CpuForceKernel.h"
+
+#include <immintrin.h>
+
+namespace Particles {
+
+    namespace {
+
+        struct Lanes {
+            __m512 xi, yi, ri, mi;
+            __m512 maxDist, repelDist, forceScale;
+        };
+
+        // One block of 16 candidates; lanes outside active must have been loaded as 0
+        inline void accumulate16(const Lanes& l, const float* column, __mmask16 active,
+                                 __m512 xj, __m512 yj, __m512 rj, __m512 mj, __m512i sj,
+                                 __m512& accX, __m512& accY) {
+            const __m512 zero = _mm512_setzero_ps();
+            const __m512 dx = _mm512_sub_ps(xj, l.xi);
+            const __m512 dy = _mm512_sub_ps(yj, l.yi);
+            const __m512 d2 = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+            // The maskz forms avoid GCC 12's spurious -Wuninitialized on
+            // the unmasked intrinsics
+            const __m512 dist = _mm512_maskz_sqrt_ps((__mmask16)0xffff, d2);
+            __mmask16 valid = _mm512_mask_cmp_ps_mask(active, d2, zero, _CMP_NEQ_OQ);
+            valid = _mm512_mask_cmp_ps_mask(valid, dist, l.maxDist, _CMP_LE_OQ);
+
+            const __m512 invd2 = _mm512_div_ps(_mm512_set1_ps(1.0f), d2);
+            const __m512 kij = _mm512_mask_i32gather_ps(zero, active, sj, column, 4);
+            const __m512 massProd = _mm512_mul_ps(l.mi, mj);
+
+            // Attraction beyond contact + repelDist, repulsion inside it
+            const __m512 contact = _mm512_add_ps(l.ri, rj);
+            const __mmask16 outside = _mm512_cmp_ps_mask(dist, _mm512_add_ps(contact, l.repelDist), _CMP_GT_OQ);
+            const __m512 attract = _mm512_mul_ps(_mm512_mul_ps(kij, massProd), invd2);
+            const __m512 repelMag = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(kij, zero, _CMP_NEQ_OQ), massProd,
+                                                         _mm512_mul_ps(_mm512_abs_ps(kij), massProd));
+            const __m512 negated = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(repelMag),
+                                                                        _mm512_set1_epi32((int)0x80000000u)));
+            const __m512 repel = _mm512_mul_ps(negated, invd2);
+            const __m512 f = _mm512_maskz_mov_ps(valid, _mm512_mask_blend_ps(outside, repel, attract));
+
+            const __m512 scaled = _mm512_mul_ps(l.forceScale, f);
+            accX = _mm512_add_ps(accX, _mm512_mul_ps(scaled, dx));
+            accY = _mm512_add_ps(accY, _mm512_mul_ps(scaled, dy));
+        }
+
+        inline float horizontalSum(__m512 v) {
+            const __m512d wide = _mm512_castps_pd(v);
+            const __m256 low = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd((__mmask8)0xff, wide, 0));
+            const __m256 high = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd((__mmask8)0xff, wide, 1));
+            const __m256 half = _mm256_add_ps(low, high);
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(half), _mm256_extractf128_ps(half, 1));
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            return _mm_cvtss_f32(sum);
+        }
+    }
+
+    uint32_t radiusSpanAvx512(const float* x, const float* y, const RadiusQuery& query,
+                              uint32_t begin, uint32_t end, uint32_t* hits) {
+        const __m512 xi = _mm512_set1_ps(query.x);
+        const __m512 yi = _mm512_set1_ps(query.y);
+        const __m512 offsetX = _mm512_set1_ps(query.offsetX);
+        const __m512 offsetY = _mm512_set1_ps(query.offsetY);
+        const __m512 radiusSquared = _mm512_set1_ps(query.radiusSquared);
+        const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+        uint32_t count = 0;
+        for (uint32_t k = begin; k < end; k += 16) {
+            const __mmask16 active = end - k >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (end - k)) - 1u);
+            const __m512 dx = _mm512_sub_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(active, x + k), xi), offsetX);
+            const __m512 dy = _mm512_sub_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(active, y + k), yi), offsetY);
+            const __m512 d2 = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+            const __mmask16 inside = _mm512_mask_cmp_ps_mask(active, d2, radiusSquared, _CMP_LE_OQ);
+            const __m512i slots = _mm512_add_epi32(_mm512_set1_epi32((int)k), lane);
+            // Compressed in a register: the memory form is microcoded on some CPUs
+            _mm512_storeu_si512(hits + count, _mm512_maskz_compress_epi32(inside, slots));
+            // Population count of the 16-bit mask
+            unsigned bits = inside;
+            bits = bits - ((bits >> 1) & 0x5555u);
+            bits = (bits & 0x3333u) + ((bits >> 2) & 0x3333u);
+            bits = (bits + (bits >> 4)) & 0x0F0Fu;
+            count += (bits & 0xFFu) + (bits >> 8);
+        }
+        return count;
+    }
+
+    void forceSpanAvx512(const ForceStreams& streams, const ForceLaw& law, const ForceSubject& subject,
+                         uint32_t begin, uint32_t end, float& dVx, float& dVy) {
+        Lanes l;
+        l.xi = _mm512_set1_ps(subject.x);
+        l.yi = _mm512_set1_ps(subject.y);
+        l.ri = _mm512_set1_ps(subject.radius);
+        l.mi = _mm512_set1_ps(subject.mass);
+        l.maxDist = _mm512_set1_ps(law.maxDist);
+        l.repelDist = _mm512_set1_ps(law.repelDist);
+        l.forceScale = _mm512_set1_ps(law.forceScale);
+
+        __m512 accX = _mm512_setzero_ps();
+        __m512 accY = _mm512_setzero_ps();
+
+        uint32_t k = begin;
+        for (; k + 16 <= end; k += 16) {
+            accumulate16(l, subject.column, (__mmask16)0xffff,
+                         _mm512_loadu_ps(streams.x + k), _mm512_loadu_ps(streams.y + k),
+                         _mm512_loadu_ps(streams.radius + k), _mm512_loadu_ps(streams.mass + k),
+                         _mm512_loadu_si512(streams.species + k), accX, accY);
+        }
+        if (k < end) {
+            const __mmask16 mask = (__mmask16)((1u << (end - k)) - 1u);
+            accumulate16(l, subject.column, mask,
+                         _mm512_maskz_loadu_ps(mask, streams.x + k), _mm512_maskz_loadu_ps(mask, streams.y + k),
+                         _mm512_maskz_loadu_ps(mask, streams.radius + k), _mm512_maskz_loadu_ps(mask, streams.mass + k),
+                         _mm512_maskz_loadu_epi32(mask, streams.species + k), accX, accY);
+        }
+
+        dVx += horizontalSum(accX);
+        dVy += horizontalSum(accY);
+    }
+}
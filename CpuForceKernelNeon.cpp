@@ -0,0 +1,120 @@
+// AArch64 Advanced SIMD kernel (see CMakeLists.txt). NEON has no gather,
+// so the four attraction weights of a block are looked up one by one.
+#include "CpuForceKernel.h"
+
+#include <arm_neon.h>
+
+namespace Particles {
+
+    namespace {
+
+        struct Lanes {
+            float32x4_t xi, yi, ri, mi;
+            float32x4_t maxDist, repelDist, forceScale;
+        };
+
+        inline void accumulate4(const Lanes& l, const float* column, float32x4_t xj, float32x4_t yj,
+                                float32x4_t rj, float32x4_t mj, const int* sj,
+                                float32x4_t& accX, float32x4_t& accY) {
+            const float32x4_t zero = vdupq_n_f32(0.0f);
+            const float32x4_t dx = vsubq_f32(xj, l.xi);
+            const float32x4_t dy = vsubq_f32(yj, l.yi);
+            const float32x4_t d2 = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+            const float32x4_t dist = vsqrtq_f32(d2);
+            const uint32x4_t valid = vandq_u32(vmvnq_u32(vceqq_f32(d2, zero)), vcleq_f32(dist, l.maxDist));
+
+            const float32x4_t invd2 = vdivq_f32(vdupq_n_f32(1.0f), d2);
+            const float weights[4] = { column[sj[0]], column[sj[1]], column[sj[2]], column[sj[3]] };
+            const float32x4_t kij = vld1q_f32(weights);
+            const float32x4_t massProd = vmulq_f32(l.mi, mj);
+
+            // Attraction beyond contact + repelDist, repulsion inside it
+            const float32x4_t contact = vaddq_f32(l.ri, rj);
+            const uint32x4_t outside = vcgtq_f32(dist, vaddq_f32(contact, l.repelDist));
+            const float32x4_t attract = vmulq_f32(vmulq_f32(kij, massProd), invd2);
+            const float32x4_t repelMag = vbslq_f32(vceqq_f32(kij, zero), massProd,
+                                                   vmulq_f32(vabsq_f32(kij), massProd));
+            const float32x4_t repel = vmulq_f32(vnegq_f32(repelMag), invd2);
+            const float32x4_t f = vreinterpretq_f32_u32(
+                vandq_u32(vreinterpretq_u32_f32(vbslq_f32(outside, attract, repel)), valid));
+
+            const float32x4_t scaled = vmulq_f32(l.forceScale, f);
+            accX = vaddq_f32(accX, vmulq_f32(scaled, dx));
+            accY = vaddq_f32(accY, vmulq_f32(scaled, dy));
+        }
+    }
+
+    uint32_t radiusSpanNeon(const float* x, const float* y, const RadiusQuery& query,
+                            uint32_t begin, uint32_t end, uint32_t* hits) {
+        const float32x4_t xi = vdupq_n_f32(query.x);
+        const float32x4_t yi = vdupq_n_f32(query.y);
+        const float32x4_t offsetX = vdupq_n_f32(query.offsetX);
+        const float32x4_t offsetY = vdupq_n_f32(query.offsetY);
+        const float32x4_t radiusSquared = vdupq_n_f32(query.radiusSquared);
+
+        uint32_t count = 0;
+        uint32_t k = begin;
+        for (; k + 4 <= end; k += 4) {
+            const float32x4_t dx = vsubq_f32(vsubq_f32(vld1q_f32(x + k), xi), offsetX);
+            const float32x4_t dy = vsubq_f32(vsubq_f32(vld1q_f32(y + k), yi), offsetY);
+            const float32x4_t d2 = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+            // 1 per passing lane; appended without branches
+            const uint32x4_t inside = vshrq_n_u32(vcleq_f32(d2, radiusSquared), 31);
+            hits[count] = k;
+            count += vgetq_lane_u32(inside, 0);
+            hits[count] = k + 1;
+            count += vgetq_lane_u32(inside, 1);
+            hits[count] = k + 2;
+            count += vgetq_lane_u32(inside, 2);
+            hits[count] = k + 3;
+            count += vgetq_lane_u32(inside, 3);
+        }
+        for (; k < end; ++k) {
+            const float dx = (x[k] - query.x) - query.offsetX;
+            const float dy = (y[k] - query.y) - query.offsetY;
+            hits[count] = k;
+            count += dx * dx + dy * dy <= query.radiusSquared ? 1u : 0u;
+        }
+        return count;
+    }
+
+    void forceSpanNeon(const ForceStreams& streams, const ForceLaw& law, const ForceSubject& subject,
+                       uint32_t begin, uint32_t end, float& dVx, float& dVy) {
+        Lanes l;
+        l.xi = vdupq_n_f32(subject.x);
+        l.yi = vdupq_n_f32(subject.y);
+        l.ri = vdupq_n_f32(subject.radius);
+        l.mi = vdupq_n_f32(subject.mass);
+        l.maxDist = vdupq_n_f32(law.maxDist);
+        l.repelDist = vdupq_n_f32(law.repelDist);
+        l.forceScale = vdupq_n_f32(law.forceScale);
+
+        float32x4_t accX = vdupq_n_f32(0.0f);
+        float32x4_t accY = vdupq_n_f32(0.0f);
+
+        uint32_t k = begin;
+        for (; k + 4 <= end; k += 4) {
+            accumulate4(l, subject.column, vld1q_f32(streams.x + k), vld1q_f32(streams.y + k),
+                        vld1q_f32(streams.radius + k), vld1q_f32(streams.mass + k), streams.species + k,
+                        accX, accY);
+        }
+        if (k < end) {
+            // Pad the last block with copies of the subject itself, which
+            // contribute nothing (zero distance)
+            float x[4], y[4], r[4], m[4];
+            int s[4];
+            for (int lane = 0; lane < 4; ++lane) {
+                const bool inside = k + (uint32_t)lane < end;
+                x[lane] = inside ? streams.x[k + lane] : subject.x;
+                y[lane] = inside ? streams.y[k + lane] : subject.y;
+                r[lane] = inside ? streams.radius[k + lane] : 0.0f;
+                m[lane] = inside ? streams.mass[k + lane] : 0.0f;
+                s[lane] = inside ? streams.species[k + lane] : 0;
+            }
+            accumulate4(l, subject.column, vld1q_f32(x), vld1q_f32(y), vld1q_f32(r), vld1q_f32(m), s, accX, accY);
+        }
+
+        dVx += vaddvq_f32(accX);
+        dVy += vaddvq_f32(accY);
+    }
+}
@@ -0,0 +1,503 @@
+#include "CpuSimulator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Particles {
+
+    CpuSimulator::CpuSimulator(float worldWidth, float worldHeight, size_t threadCount,
+                               const SimulationParams& params)
+        : worldWidth(worldWidth), worldHeight(worldHeight), pool(threadCount) {
+        setParams(params);
+        setAttractionMatrix(Color::attractionMatrix);
+        setForceKernel(bestForceKernel());
+    }
+
+    bool CpuSimulator::setForceKernel(ForceKernelIsa isa) {
+        if (!forceKernelAvailable(isa)) return false;
+        forceKernel = isa;
+        spanKernel = forceSpanKernel(isa);
+        radiusKernel = radiusSpanKernel(isa);
+        return true;
+    }
+
+    void CpuSimulator::setParams(const SimulationParams& newParams) {
+        params = newParams;
+        gridFromLastStep = false;
+    }
+
+    void CpuSimulator::setParticles(const std::vector<GPUParticle>& initialParticles) {
+        front = initialParticles;
+        back.resize(front.size());
+        gridFromLastStep = false;
+    }
+
+    void CpuSimulator::setAttractionMatrix(const Color::AttractionMatrix& matrix) {
+        numSpecies = Color::speciesCount(matrix);
+        attraction.assign(matrix.data(), matrix.data() + matrix.size());
+    }
+
+    // Same mapping as cellCoord() in the GPU kernel: outside positions clamp to the border cells
+    uint32_t CpuSimulator::cellOf(float x, float y) const {
+        float cx = std::floor(x / cellWidth);
+        float cy = std::floor(y / cellHeight);
+        cx = std::min(std::max(cx, 0.0f), (float)(gridWidth - 1));
+        cy = std::min(std::max(cy, 0.0f), (float)(gridHeight - 1));
+        return (uint32_t)cy * (uint32_t)gridWidth + (uint32_t)cx;
+    }
+
+    void CpuSimulator::buildGrid() {
+        const GridLayout layout = gridLayout(worldWidth, worldHeight, params.maxDist, params.boundary);
+        gridWidth = layout.width;
+        gridHeight = layout.height;
+        cellWidth = layout.cellWidth;
+        cellHeight = layout.cellHeight;
+
+        const size_t count = front.size();
+        const size_t numCells = (size_t)gridWidth * (size_t)gridHeight;
+        const size_t slices = pool.size();
+        const size_t sliceLength = (count + slices - 1) / slices;
+
+        particleCell.resize(count);
+        sliceCursors.assign(slices * numCells, 0);
+        cellStart.resize(numCells + 1);
+
+        // Per-slice histograms, so no atomics are needed
+        pool.forEachSlice([&](size_t slice) {
+            const size_t begin = std::min(count, slice * sliceLength);
+            const size_t end = std::min(count, begin + sliceLength);
+            uint32_t* counts = &sliceCursors[slice * numCells];
+            for (size_t i = begin; i < end; ++i) {
+                const uint32_t cell = cellOf(front[i].px, front[i].py);
+                particleCell[i] = cell;
+                ++counts[cell];
+            }
+        });
+
+        // Exclusive scan, cell-major then slice-major, which turns every
+        // slice's counts into its write cursors and keeps the sort stable
+        uint32_t running = 0;
+        for (size_t cell = 0; cell < numCells; ++cell) {
+            cellStart[cell] = running;
+            for (size_t slice = 0; slice < slices; ++slice) {
+                uint32_t& cursor = sliceCursors[slice * numCells + cell];
+                const uint32_t cellCount = cursor;
+                cursor = running;
+                running += cellCount;
+            }
+        }
+        cellStart[numCells] = running;
+
+        sortedIndex.resize(count);
+        sortedX.resize(count);
+        sortedY.resize(count);
+        sortedRadius.resize(count);
+        sortedMass.resize(count);
+        sortedSpecies.resize(count);
+
+        pool.forEachSlice([&](size_t slice) {
+            const size_t begin = std::min(count, slice * sliceLength);
+            const size_t end = std::min(count, begin + sliceLength);
+            uint32_t* cursors = &sliceCursors[slice * numCells];
+            for (size_t i = begin; i < end; ++i) {
+                const uint32_t slot = cursors[particleCell[i]]++;
+                const GPUParticle& p = front[i];
+                sortedIndex[slot] = (uint32_t)i;
+                sortedX[slot] = p.px;
+                sortedY[slot] = p.py;
+                sortedRadius[slot] = p.radius;
+                sortedMass[slot] = p.mass;
+                sortedSpecies[slot] = p.colorSpecies;
+            }
+        });
+    }
+
+    namespace {
+
+        struct StepConstants {
+            float deltaTime;
+            float keep;
+            float h;
+            bool verlet;
+            Boundary boundary;
+            float worldWidth;
+            float worldHeight;
+        };
+
+        StepConstants stepConstants(const SimulationParams& params, float deltaTime, float worldWidth, float worldHeight) {
+            return { deltaTime, 1.0f - params.damping, deltaTime / kReferenceDt,
+                     params.integrator == Integrator::VelocityVerlet, params.boundary, worldWidth, worldHeight };
+        }
+
+        // Same operation order as integrate() in the compute shaders
+        inline void integrate(const GPUParticle& in, GPUParticle& out, float dVx, float dVy, const StepConstants& c) {
+            out = in;
+            const float ax = dVx / in.mass;
+            const float ay = dVy / in.mass;
+            if (c.verlet) {
+                out.vx = (in.vx + 0.5f * (in.ax + ax) * c.deltaTime) * c.keep;
+                out.vy = (in.vy + 0.5f * (in.ay + ay) * c.deltaTime) * c.keep;
+                out.px = in.px + out.vx * c.h + 0.5f * ax * c.deltaTime * c.h;
+                out.py = in.py + out.vy * c.h + 0.5f * ay * c.deltaTime * c.h;
+            } else {
+                out.vx = (in.vx + ax * c.deltaTime) * c.keep;
+                out.vy = (in.vy + ay * c.deltaTime) * c.keep;
+                out.px = in.px + out.vx * c.h;
+                out.py = in.py + out.vy * c.h;
+            }
+            applyBoundary(out.px, out.vx, c.worldWidth, c.boundary);
+            applyBoundary(out.py, out.vy, c.worldHeight, c.boundary);
+            out.ax = ax;
+            out.ay = ay;
+        }
+    }
+
+    void CpuSimulator::computeForces(float deltaTime) {
+        if (spanKernel != nullptr) {
+            computeForcesSimd(deltaTime);
+            return;
+        }
+        // One instance per species count up to MAX_UNROLLED_SPECIES, indexed
+        // by the count; [0] handles everything larger
+        static constexpr auto kernels = makeForceKernels(std::make_index_sequence<Color::MAX_UNROLLED_SPECIES + 1>());
+        const ForceKernel kernel = numSpecies < (int)kernels.size() ? kernels[numSpecies] : kernels[0];
+        (this->*kernel)(deltaTime);
+    }
+
+    template <int NumSpecies>
+    void CpuSimulator::computeForcesFor(float deltaTime) {
+        const int stride = NumSpecies > 0 ? NumSpecies : numSpecies;
+        const float maxDist = params.maxDist;
+        const float repelDist = params.repelDist;
+        const float forceScale = params.forceScale;
+        const StepConstants constants = stepConstants(params, deltaTime, worldWidth, worldHeight);
+
+        // Iterate in cell order so neighbouring particles share cache lines
+        pool.parallelFor(front.size(), [&](size_t begin, size_t end) {
+            for (size_t slot = begin; slot < end; ++slot) {
+                const uint32_t i = sortedIndex[slot];
+                const float xi = sortedX[slot];
+                const float yi = sortedY[slot];
+                const float ri = sortedRadius[slot];
+                const float mi = sortedMass[slot];
+                const float* row = &attraction[0] + sortedSpecies[slot];
+                // texelFetch(uAttractionMatrix, ivec2(si, sj)) reads row sj, column si
+                float column[NumSpecies > 0 ? NumSpecies : 1];
+                if constexpr (NumSpecies > 0) {
+                    for (int s = 0; s < NumSpecies; ++s) {
+                        column[s] = row[s * NumSpecies];
+                    }
+                }
+
+                const int cx = (int)(particleCell[i] % (uint32_t)gridWidth);
+                const int cy = (int)(particleCell[i] / (uint32_t)gridWidth);
+                CellRun columns[2];
+                CellRun rows[2];
+                const int columnRuns = neighbourRuns(cx, gridWidth, worldWidth, params.boundary, columns);
+                const int rowRuns = neighbourRuns(cy, gridHeight, worldHeight, params.boundary, rows);
+
+                float dVx = 0.0f;
+                float dVy = 0.0f;
+
+                // Ghost cells across a torus edge are visited from a copy of
+                // the particle moved by one period (see neighbourRuns())
+                for (int r = 0; r < rowRuns; ++r) {
+                    const float ys = yi + rows[r].offset;
+                    for (int gy = rows[r].first; gy <= rows[r].last; ++gy) {
+                        for (int c = 0; c < columnRuns; ++c) {
+                            const float xs = xi + columns[c].offset;
+                            for (int gx = columns[c].first; gx <= columns[c].last; ++gx) {
+                                const size_t cell = (size_t)gy * (size_t)gridWidth + (size_t)gx;
+                                for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+                                    if (k == slot) continue;
+
+                                    const float dx = sortedX[k] - xs;
+                                    const float dy = sortedY[k] - ys;
+                                    const float d2 = dx * dx + dy * dy;
+                                    if (d2 == 0.0f) continue;
+
+                                    const float dist = std::sqrt(d2);
+                                    if (dist > maxDist) continue;
+
+                                    const float invd2 = 1.0f / d2;
+                                    const float kij = NumSpecies > 0 ? column[sortedSpecies[k]]
+                                                                     : row[sortedSpecies[k] * stride];
+
+                                    const float massProd = mi * sortedMass[k];
+
+                                    const float contact = ri + sortedRadius[k];
+                                    float f;
+                                    if (dist > contact + repelDist) {
+                                        f = kij * massProd * invd2;
+                                    } else {
+                                        const float repelMag = (kij != 0.0f) ? std::fabs(kij) * massProd : massProd;
+                                        f = -repelMag * invd2;
+                                    }
+                                    dVx += forceScale * f * dx;
+                                    dVy += forceScale * f * dy;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                integrate(front[i], back[i], dVx, dVy, constants);
+            }
+        }, 64);
+    }
+
+    void CpuSimulator::computeForcesSimd(float deltaTime) {
+        const ForceStreams streams { sortedX.data(), sortedY.data(), sortedRadius.data(), sortedMass.data(),
+                                     sortedSpecies.data() };
+        const ForceLaw law { params.maxDist, params.repelDist, params.forceScale };
+        const StepConstants constants = stepConstants(params, deltaTime, worldWidth, worldHeight);
+        const ForceSpanKernel kernel = spanKernel;
+
+        pool.parallelFor(front.size(), [&](size_t begin, size_t end) {
+            for (size_t slot = begin; slot < end; ++slot) {
+                const uint32_t i = sortedIndex[slot];
+                // texelFetch(uAttractionMatrix, ivec2(si, sj)) reads row sj, column si
+                float column[Color::MAX_SPECIES];
+                const float* row = &attraction[0] + sortedSpecies[slot];
+                for (int s = 0; s < numSpecies; ++s) {
+                    column[s] = row[s * numSpecies];
+                }
+                ForceSubject subject { 0.0f, 0.0f, sortedRadius[slot], sortedMass[slot], column };
+
+                const int cx = (int)(particleCell[i] % (uint32_t)gridWidth);
+                const int cy = (int)(particleCell[i] / (uint32_t)gridWidth);
+                CellRun columns[2];
+                CellRun rows[2];
+                const int columnRuns = neighbourRuns(cx, gridWidth, worldWidth, params.boundary, columns);
+                const int rowRuns = neighbourRuns(cy, gridHeight, worldHeight, params.boundary, rows);
+
+                float dVx = 0.0f;
+                float dVy = 0.0f;
+                for (int r = 0; r < rowRuns; ++r) {
+                    subject.y = sortedY[slot] + rows[r].offset;
+                    for (int gy = rows[r].first; gy <= rows[r].last; ++gy) {
+                        const size_t rowStart = (size_t)gy * (size_t)gridWidth;
+                        for (int c = 0; c < columnRuns; ++c) {
+                            subject.x = sortedX[slot] + columns[c].offset;
+                            kernel(streams, law, subject, cellStart[rowStart + columns[c].first],
+                                   cellStart[rowStart + columns[c].last + 1], dVx, dVy);
+                        }
+                    }
+                }
+
+                integrate(front[i], back[i], dVx, dVy, constants);
+            }
+        }, 64);
+    }
+
+    // Lock-free union-find over sorted slots, as in the GPU metrics passes:
+    // the larger of two roots is hooked under the smaller, so parents only
+    // ever decrease and a failed compare-and-swap retries from the new parent.
+    // Finds split the path behind them (each slot skips to its grandparent,
+    // which is still one of its ancestors), so chains stay short even in
+    // one large component.
+    static uint32_t findRoot(std::vector<std::atomic<uint32_t>>& parent, uint32_t x) {
+        uint32_t p = parent[x].load(std::memory_order_relaxed);
+        while (p != x) {
+            const uint32_t grandparent = parent[p].load(std::memory_order_relaxed);
+            if (grandparent != p) parent[x].store(grandparent, std::memory_order_relaxed);
+            x = p;
+            p = grandparent;
+        }
+        return x;
+    }
+
+    static void unite(std::vector<std::atomic<uint32_t>>& parent, uint32_t a, uint32_t b) {
+        for (;;) {
+            a = findRoot(parent, a);
+            b = findRoot(parent, b);
+            if (a == b) return;
+            uint32_t high = std::max(a, b);
+            const uint32_t low = std::min(a, b);
+            if (parent[high].compare_exchange_strong(high, low, std::memory_order_relaxed)) return;
+            a = high; // the parent it was hooked under meanwhile
+            b = low;
+        }
+    }
+
+    // Lowers value to key unless it already holds a smaller one
+    static void lowerTo(std::atomic<uint32_t>& value, uint32_t key) {
+        uint32_t current = value.load(std::memory_order_relaxed);
+        while (key < current && !value.compare_exchange_weak(current, key, std::memory_order_relaxed)) {}
+    }
+
+    static_assert(Color::MAX_SPECIES <= (1 << kMetricsSpeciesBits), "species ids fit the neighbour key");
+
+    // Candidates the metrics neighbour pass filters at a time
+    static constexpr uint32_t kMetricsChunk = 256;
+
+    void CpuSimulator::computeMetrics(float radius, MetricsTotals& totals, MetricsSource source) {
+        totals.clear(numSpecies);
+        if (front.empty()) return;
+        // After a step, back holds the particles its grid was built from
+        const bool reuseGrid = source == MetricsSource::LastStep && gridFromLastStep;
+        if (!reuseGrid) {
+            buildGrid();
+            gridFromLastStep = false;
+        }
+        const std::vector<GPUParticle>& state = reuseGrid ? back : front;
+        const size_t count = state.size();
+
+        const size_t slices = pool.size();
+        const size_t sliceLength = (count + slices - 1) / slices;
+        sliceTotals.resize(slices);
+        if (clusterParent.size() != count) {
+            clusterParent = std::vector<std::atomic<uint32_t>>(count);
+            clusterSize = std::vector<std::atomic<uint32_t>>(count);
+            nearestKey = std::vector<std::atomic<uint32_t>>(count);
+        }
+        const float cappedRadius = metricsRadius(radius, params.maxDist);
+        const float radiusSquared = cappedRadius * cappedRadius;
+
+        // 1) energy and species sums over the particles; every slot starts
+        // as its own component, without a neighbour
+        pool.forEachSlice([&](size_t slice) {
+            const size_t begin = std::min(count, slice * sliceLength);
+            const size_t end = std::min(count, begin + sliceLength);
+            MetricsTotals& partial = sliceTotals[slice];
+            partial.clear(numSpecies);
+            for (size_t i = begin; i < end; ++i) {
+                const GPUParticle& p = state[i];
+                partial.header.kineticEnergy += metricsEnergy(p.mass, p.vx, p.vy);
+                const int64_t qx = metricsPosition(p.px);
+                const int64_t qy = metricsPosition(p.py);
+                SpeciesTotals& species = partial.species[p.colorSpecies];
+                ++species.count;
+                species.sumX += qx;
+                species.sumY += qy;
+                species.sumSquares += (uint64_t)(qx * qx) + (uint64_t)(qy * qy);
+                clusterParent[i].store((uint32_t)i, std::memory_order_relaxed);
+                clusterSize[i].store(0, std::memory_order_relaxed);
+                nearestKey[i].store(kNoNeighbourKey, std::memory_order_relaxed);
+            }
+        });
+
+        // 2) every pair within the radius, once, from its higher slot: the
+        // lower slots in the cells of the 3x3 block the radius reaches.
+        // Lowers the nearest-neighbour key of both ends and unites them.
+        const RadiusSpanKernel filter = radiusKernel;
+        pool.forEachSlice([&](size_t slice) {
+            const size_t begin = std::min(count, slice * sliceLength);
+            const size_t end = std::min(count, begin + sliceLength);
+            for (size_t slot = begin; slot < end; ++slot) {
+                const float xi = sortedX[slot];
+                const float yi = sortedY[slot];
+                const int si = sortedSpecies[slot];
+                const uint32_t cell = particleCell[sortedIndex[slot]];
+                const int cx = (int)(cell % (uint32_t)gridWidth);
+                const int cy = (int)(cell / (uint32_t)gridWidth);
+                CellRun columns[2];
+                CellRun rows[2];
+                const int columnRuns = reachedRuns(xi, cappedRadius, cellWidth, cx, gridWidth, worldWidth,
+                                                   params.boundary, columns);
+                const int rowRuns = reachedRuns(yi, cappedRadius, cellHeight, cy, gridHeight, worldHeight,
+                                                params.boundary, rows);
+
+                uint32_t ownKey = kNoNeighbourKey;
+                for (int r = 0; r < rowRuns; ++r) {
+                    const float offsetY = rows[r].offset;
+                    for (int gy = rows[r].first; gy <= rows[r].last; ++gy) {
+                        // cells of one row are contiguous in the sorted arrays
+                        const size_t rowBase = (size_t)gy * (size_t)gridWidth;
+                        for (int c = 0; c < columnRuns; ++c) {
+                            const float offsetX = columns[c].offset;
+                            const uint32_t end = std::min(cellStart[rowBase + columns[c].last + 1], (uint32_t)slot);
+                            for (uint32_t chunk = cellStart[rowBase + columns[c].first]; chunk < end;
+                                 chunk += kMetricsChunk) {
+                                // Only a few candidates are within the radius: pick
+                                // them out without branches first, then do the
+                                // atomics for those alone
+                                const uint32_t length = std::min(end - chunk, kMetricsChunk);
+                                uint32_t hits[kMetricsChunk + 16];
+                                uint32_t hitCount = 0;
+                                if (filter != nullptr) {
+                                    const RadiusQuery query { xi, yi, offsetX, offsetY, radiusSquared };
+                                    hitCount = filter(sortedX.data(), sortedY.data(), query, chunk, chunk + length,
+                                                      hits);
+                                } else {
+                                    for (uint32_t k = chunk; k < chunk + length; ++k) {
+                                        const float dx = (sortedX[k] - xi) - offsetX;
+                                        const float dy = (sortedY[k] - yi) - offsetY;
+                                        hits[hitCount] = k;
+                                        hitCount += dx * dx + dy * dy <= radiusSquared ? 1u : 0u;
+                                    }
+                                }
+
+                                for (uint32_t h = 0; h < hitCount; ++h) {
+                                    const uint32_t k = hits[h];
+                                    const float dx = (sortedX[k] - xi) - offsetX;
+                                    const float dy = (sortedY[k] - yi) - offsetY;
+                                    const float d2 = dx * dx + dy * dy;
+                                    ownKey = std::min(ownKey, metricsNeighbourKey(d2, sortedSpecies[k]));
+                                    lowerTo(nearestKey[k], metricsNeighbourKey(d2, si));
+                                    unite(clusterParent, (uint32_t)slot, k);
+                                }
+                            }
+                        }
+                    }
+                }
+                if (ownKey != kNoNeighbourKey) lowerTo(nearestKey[slot], ownKey);
+            }
+        });
+
+        // 3) component sizes, counted at the roots, and the particles with
+        // a neighbour, by its species
+        pool.forEachSlice([&](size_t slice) {
+            const size_t begin = std::min(count, slice * sliceLength);
+            const size_t end = std::min(count, begin + sliceLength);
+            MetricsHeader& partial = sliceTotals[slice].header;
+            for (size_t slot = begin; slot < end; ++slot) {
+                clusterSize[findRoot(clusterParent, (uint32_t)slot)].fetch_add(1, std::memory_order_relaxed);
+                const uint32_t key = nearestKey[slot].load(std::memory_order_relaxed);
+                if (key != kNoNeighbourKey) {
+                    ++partial.withNeighbour;
+                    if (metricsNeighbourSpecies(key) != sortedSpecies[slot]) ++partial.mixedNeighbour;
+                }
+            }
+        });
+
+        // 4) size histogram over the roots
+        pool.forEachSlice([&](size_t slice) {
+            const size_t begin = std::min(count, slice * sliceLength);
+            const size_t end = std::min(count, begin + sliceLength);
+            MetricsHeader& partial = sliceTotals[slice].header;
+            for (size_t slot = begin; slot < end; ++slot) {
+                if (clusterParent[slot].load(std::memory_order_relaxed) != slot) continue;
+                const uint32_t size = clusterSize[slot].load(std::memory_order_relaxed);
+                ++partial.clusterSizes[clusterSizeBucket(size)];
+                partial.largestCluster = std::max(partial.largestCluster, size);
+            }
+        });
+
+        for (const MetricsTotals& partial : sliceTotals) {
+            MetricsHeader& header = totals.header;
+            header.kineticEnergy += partial.header.kineticEnergy;
+            header.withNeighbour += partial.header.withNeighbour;
+            header.mixedNeighbour += partial.header.mixedNeighbour;
+            header.largestCluster = std::max(header.largestCluster, partial.header.largestCluster);
+            for (int b = 0; b < kClusterSizeBuckets; ++b) {
+                header.clusterSizes[b] += partial.header.clusterSizes[b];
+            }
+            for (int s = 0; s < numSpecies; ++s) {
+                SpeciesTotals& species = totals.species[s];
+                species.count += partial.species[s].count;
+                species.sumX += partial.species[s].sumX;
+                species.sumY += partial.species[s].sumY;
+                species.sumSquares += partial.species[s].sumSquares;
+            }
+        }
+    }
+
+    void CpuSimulator::step(float deltaTime) {
+        if (front.empty()) return;
+        buildGrid();
+        computeForces(deltaTime);
+        front.swap(back);
+        gridFromLastStep = true;
+    }
+}
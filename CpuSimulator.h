@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Color.h"
+#include "CpuForceKernel.h"
+#include "GPUParticle.h"
+#include "Metrics.h"
+#include "SimulationParams.h"
+#include "ThreadPool.h"
+
+namespace Particles {
+
+    // CPU implementation of the kCompute physics step. Uses the same force
+    // law, attraction-matrix lookup, integration and world boundary as the
+    // GPU kernel, with a uniform grid (cells at least maxDist wide, see
+    // gridLayout()) for the neighbour search and a thread pool for the
+    // binning and force passes. Each step reads the
+    // current particle array and writes a second one, so results do not
+    // depend on the thread count or scheduling. The force pass runs the
+    // widest explicit SIMD kernel the CPU supports (see CpuForceKernel.h)
+    // unless another one is chosen with setForceKernel().
+    class CpuSimulator {
+    public:
+        // threadCount == 0 uses every hardware thread
+        CpuSimulator(float worldWidth, float worldHeight, size_t threadCount = 0,
+                     const SimulationParams& params = SimulationParams{});
+
+        void setParticles(const std::vector<GPUParticle>& initialParticles);
+        void setAttractionMatrix(const Color::AttractionMatrix& matrix);
+        void setParams(const SimulationParams& newParams);
+        // False (and no change) if isa is not available on this CPU
+        bool setForceKernel(ForceKernelIsa isa);
+        ForceKernelIsa getForceKernel() const { return forceKernel; }
+
+        // Advance all particles by one step
+        void step(float deltaTime);
+
+        // Reduces particles into totals (see Metrics.h) with the same passes
+        // as the GPU metrics, on the thread pool. LastStep measures the
+        // particles the last step() started from over that step's grid;
+        // Current, or LastStep before any step, bins the current ones first.
+        void computeMetrics(float radius, MetricsTotals& totals, MetricsSource source);
+
+        std::vector<GPUParticle>& particles() { return front; }
+        const std::vector<GPUParticle>& particles() const { return front; }
+        const SimulationParams& getParams() const { return params; }
+        size_t threadCount() const { return pool.size(); }
+
+    private:
+        float worldWidth;
+        float worldHeight;
+        SimulationParams params;
+        ThreadPool pool;
+        ForceKernelIsa forceKernel { ForceKernelIsa::Scalar };
+        ForceSpanKernel spanKernel { nullptr }; // null for the scalar loop
+        RadiusSpanKernel radiusKernel { nullptr }; // metrics filter, likewise
+
+        int numSpecies { 0 };
+        std::vector<float> attraction; // [from * numSpecies + to]
+        std::vector<GPUParticle> front;
+        std::vector<GPUParticle> back;
+
+        // Uniform grid, rebuilt every step. gridFromLastStep is set while it
+        // and back still hold the particles the last step started from.
+        bool gridFromLastStep { false };
+        float cellWidth { 1.0f };
+        float cellHeight { 1.0f };
+        int gridWidth { 1 };
+        int gridHeight { 1 };
+        std::vector<uint32_t> particleCell;  // cell of each particle
+        std::vector<uint32_t> sliceCursors;  // [slice * numCells + cell]
+        std::vector<uint32_t> cellStart;     // numCells + 1 offsets into the sorted arrays
+
+        // Fields read by the force loop, stored in cell order
+        std::vector<uint32_t> sortedIndex;
+        std::vector<float> sortedX;
+        std::vector<float> sortedY;
+        std::vector<float> sortedRadius;
+        std::vector<float> sortedMass;
+        std::vector<int> sortedSpecies;
+
+        // Metrics scratch, indexed by sorted slot: union-find parents and
+        // component sizes, updated concurrently
+        std::vector<std::atomic<uint32_t>> clusterParent;
+        std::vector<std::atomic<uint32_t>> clusterSize;
+        std::vector<std::atomic<uint32_t>> nearestKey; // see metricsNeighbourKey()
+        std::vector<MetricsTotals> sliceTotals;
+
+        uint32_t cellOf(float x, float y) const;
+        void buildGrid();
+        void computeForces(float deltaTime);
+        // NumSpecies > 0: the particle's attraction column is copied into a
+        // fixed-size local array; 0: read from the matrix with a runtime stride
+        template <int NumSpecies>
+        void computeForcesFor(float deltaTime);
+        // Runs spanKernel over each run of adjacent cells in the rows of the
+        // 3x3 block, which are adjacent in the sorted arrays too
+        void computeForcesSimd(float deltaTime);
+
+        using ForceKernel = void (CpuSimulator::*)(float);
+        template <size_t... Counts>
+        static constexpr std::array<ForceKernel, sizeof...(Counts)> makeForceKernels(std::index_sequence<Counts...>) {
+            return { &CpuSimulator::computeForcesFor<(int)Counts>... };
+        }
+    };
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace Particles {
+
+    // How Renderer::drawPointsGPU() draws the particles
+    enum class DrawMode {
+        Quads,        // three instanced quads per particle: outer glow, inner glow, core
+        SinglePass,   // one instanced quad per particle into an HDR glow + core target, then a resolve pass
+        DensitySplat, // glow from a blurred low-resolution splat of the particles,
+                      // core quads only where the splat is sparse
+    };
+}
@@ -0,0 +1,38 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Particles {
+
+    FrameArena::FrameArena(size_t initialBytes)
+        : block(std::make_unique<std::byte[]>(std::max<size_t>(initialBytes, 1))),
+          blockSize(std::max<size_t>(initialBytes, 1)) {
+    }
+
+    void* FrameArena::allocate(size_t bytes, size_t alignment) {
+        const uintptr_t base = reinterpret_cast<uintptr_t>(block.get());
+        const uintptr_t aligned = (base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if (aligned + bytes <= base + blockSize) {
+            offset = aligned + bytes - base;
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        // Spill: a block of its own, folded into the main block on reset()
+        spills.push_back(std::make_unique<std::byte[]>(bytes + alignment));
+        spilledBytes += bytes + alignment;
+        const uintptr_t spill = reinterpret_cast<uintptr_t>(spills.back().get());
+        return reinterpret_cast<void*>((spill + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+
+    void FrameArena::reset() {
+        if (!spills.empty()) {
+            const size_t peak = offset + spilledBytes;
+            spills.clear();
+            spilledBytes = 0;
+            blockSize = std::max(peak, blockSize * 2);
+            block = std::make_unique<std::byte[]>(blockSize);
+        }
+        offset = 0;
+    }
+}
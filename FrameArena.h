@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace Particles {
+
+    // Bump allocator for data that only lives for one frame or step (the
+    // death/rebirth lists, for example). Allocating moves a cursor through
+    // one block; reset() moves it back, releasing everything at once in
+    // O(1). A frame that outgrows the block spills into extra blocks, and
+    // the next reset() replaces them all with a single block of the frame's
+    // peak size, so the heap is only touched until the largest frame has
+    // been seen. Not thread-safe: use one arena per thread.
+    class FrameArena {
+    public:
+        explicit FrameArena(size_t initialBytes = 64 * 1024);
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+        FrameArena(FrameArena&&) = default;
+        FrameArena& operator=(FrameArena&&) = default;
+
+        // Never returns nullptr; alignment must be a power of two
+        void* allocate(size_t bytes, size_t alignment);
+
+        template <typename T>
+        T* allocateArray(size_t count) {
+            return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        }
+
+        // Invalidates everything allocated since the last reset
+        void reset();
+
+        size_t capacity() const { return blockSize; }
+        size_t used() const { return offset + spilledBytes; }
+
+    private:
+        std::unique_ptr<std::byte[]> block;
+        size_t blockSize;
+        size_t offset { 0 };
+        std::vector<std::unique_ptr<std::byte[]>> spills;
+        size_t spilledBytes { 0 };
+    };
+
+    // Standard allocator over a FrameArena; deallocate() is a no-op, the
+    // memory comes back with the arena's next reset()
+    template <typename T>
+    class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        explicit ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+        T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+        void deallocate(T*, size_t) {}
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+        template <typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+    private:
+        template <typename U>
+        friend class ArenaAllocator;
+        FrameArena* arena;
+    };
+
+    // A vector of frame-scoped data: must not outlive the arena's next reset()
+    template <typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
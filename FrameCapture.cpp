@@ -0,0 +1,82 @@
+#include "FrameCapture.h"
+
+#include <cstring>
+#include <vector>
+
+namespace Particles {
+
+    FrameCapture::FrameCapture(FrameWriter& writer, Renderer& renderer)
+        : writer(writer), renderer(renderer),
+          width(writer.getInfo().width), height(writer.getInfo().height) {
+        if (!writer.isOpen()) return;
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    FrameCapture::~FrameCapture() {
+        if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+        if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+    }
+
+    void FrameCapture::capture(size_t particleCount) {
+        if (!writer.isOpen()) return;
+
+        // A full ring means the GPU or the copies are kSlots frames behind;
+        // wait for the oldest to make room
+        while (readback.full()) {
+            forwardOldest(true);
+        }
+
+        renderer.setDrawTarget(framebuffer, width, height);
+        glClear(GL_COLOR_BUFFER_BIT);
+        renderer.drawPointsGPU(particleCount);
+
+        // The copy into the pack buffer is queued like any other command;
+        // nothing waits for it until the slot comes round again
+        const size_t frameBytes = (size_t)width * height * 4;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer(frameBytes));
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        readback.submit(frameBytes, 0);
+
+        renderer.resetDrawTarget();
+        poll();
+    }
+
+    void FrameCapture::present(int windowWidth, int windowHeight) {
+        if (!framebuffer) return;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    void FrameCapture::poll() {
+        while (forwardOldest(false)) {
+        }
+    }
+
+    void FrameCapture::finish() {
+        while (readback.pending()) {
+            forwardOldest(true);
+        }
+    }
+
+    bool FrameCapture::forwardOldest(bool wait) {
+        return readback.poll(wait, [&](const void* data, size_t bytes, uint64_t) {
+            std::vector<uint8_t> rgba = writer.takeBuffer();
+            rgba.resize(bytes);
+            std::memcpy(rgba.data(), data, bytes);
+            writer.push(std::move(rgba));
+        });
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FrameExport.h"
+#include "ReadbackRing.h"
+#include "Renderer.h"
+
+namespace Particles {
+
+    // Feeds a FrameWriter with frames drawn offscreen at the export
+    // resolution, independent of the window or monitor. Each capture draws
+    // the particles into its own framebuffer and starts an asynchronous
+    // glReadPixels into a ReadbackRing; finished slots are copied out and
+    // handed to the writer. The
+    // render loop only waits when every slot or the writer's queue is full.
+    class FrameCapture {
+    public:
+        static constexpr int kSlots = 4;
+
+        FrameCapture(FrameWriter& writer, Renderer& renderer);
+        ~FrameCapture();
+        FrameCapture(const FrameCapture&) = delete;
+        FrameCapture& operator=(const FrameCapture&) = delete;
+
+        // Clears the export framebuffer, draws the particles into it and
+        // queues its readback. The renderer draws to the window again after.
+        void capture(size_t particleCount);
+        // Scales the last captured frame into the window framebuffer
+        void present(int windowWidth, int windowHeight);
+        // Hands finished readbacks to the writer without waiting
+        void poll();
+        // Waits for every readback in flight and hands it to the writer
+        void finish();
+
+    private:
+        FrameWriter& writer;
+        Renderer& renderer;
+        int width;
+        int height;
+        GLuint framebuffer { 0 };
+        GLuint colorBuffer { 0 };
+        ReadbackRing readback { kSlots };
+
+        bool forwardOldest(bool wait);
+    };
+}
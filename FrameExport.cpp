@@ -0,0 +1,473 @@
+#include "FrameExport.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+namespace Particles {
+
+    namespace {
+
+        // ---- PNG: zlib stream of one fixed-Huffman deflate block ----
+
+        // LSB-first bit packer, as deflate wants
+        struct BitWriter {
+            std::vector<uint8_t>& out;
+            uint64_t bits = 0;
+            int count = 0;
+
+            void put(uint32_t value, int length) {
+                bits |= (uint64_t)value << count;
+                count += length;
+                while (count >= 8) {
+                    out.push_back((uint8_t)bits);
+                    bits >>= 8;
+                    count -= 8;
+                }
+            }
+
+            void flush() {
+                if (count > 0) out.push_back((uint8_t)bits);
+                bits = 0;
+                count = 0;
+            }
+        };
+
+        uint32_t reverseBits(uint32_t value, int length) {
+            uint32_t reversed = 0;
+            for (int i = 0; i < length; ++i) {
+                reversed = (reversed << 1) | ((value >> i) & 1u);
+            }
+            return reversed;
+        }
+
+        struct Code {
+            uint16_t bits; // already reversed for BitWriter
+            uint8_t length;
+        };
+
+        // Fixed literal/length codes (RFC 1951, 3.2.6)
+        const std::array<Code, 288>& fixedLiteralCodes() {
+            static const std::array<Code, 288> codes = [] {
+                std::array<Code, 288> table {};
+                for (uint32_t v = 0; v < 288; ++v) {
+                    uint32_t code;
+                    int length;
+                    if (v < 144) { code = 0x30 + v; length = 8; }
+                    else if (v < 256) { code = 0x190 + (v - 144); length = 9; }
+                    else if (v < 280) { code = v - 256; length = 7; }
+                    else { code = 0xC0 + (v - 280); length = 8; }
+                    table[v] = Code { (uint16_t)reverseBits(code, length), (uint8_t)length };
+                }
+                return table;
+            }();
+            return codes;
+        }
+
+        constexpr uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                               35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        constexpr uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                               3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        constexpr uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                                 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                                 8193, 12289, 16385, 24577 };
+        constexpr uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        constexpr int kWindowSize = 32768;
+        constexpr int kHashBits = 15;
+        constexpr int kMaxChain = 8; // candidates tried per position: speed over ratio
+        constexpr int kMinMatch = 3;
+        constexpr int kMaxMatch = 258;
+
+        uint32_t hash3(const uint8_t* p) {
+            const uint32_t v = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+            return (v * 2654435761u) >> (32 - kHashBits);
+        }
+
+        void putLiteral(BitWriter& writer, uint32_t symbol) {
+            const Code& code = fixedLiteralCodes()[symbol];
+            writer.put(code.bits, code.length);
+        }
+
+        void putMatch(BitWriter& writer, int length, int distance) {
+            const int l = (int)(std::upper_bound(kLengthBase, kLengthBase + 29, length) - kLengthBase) - 1;
+            putLiteral(writer, 257 + (uint32_t)l);
+            writer.put((uint32_t)(length - kLengthBase[l]), kLengthExtra[l]);
+            const int d = (int)(std::upper_bound(kDistanceBase, kDistanceBase + 30, distance) - kDistanceBase) - 1;
+            writer.put(reverseBits((uint32_t)d, 5), 5);
+            writer.put((uint32_t)(distance - kDistanceBase[d]), kDistanceExtra[d]);
+        }
+
+        // Greedy LZ77 over a hash chain limited to the deflate window
+        void deflateFixed(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+            BitWriter writer { out };
+            writer.put(1, 1); // BFINAL
+            writer.put(1, 2); // BTYPE = fixed Huffman
+
+            std::vector<int32_t> head((size_t)1 << kHashBits, -1);
+            std::vector<int32_t> chain(kWindowSize, -1);
+            auto insert = [&](size_t pos) {
+                if (pos + kMinMatch > size) return;
+                const uint32_t h = hash3(data + pos);
+                chain[pos & (kWindowSize - 1)] = head[h];
+                head[h] = (int32_t)pos;
+            };
+
+            size_t pos = 0;
+            while (pos < size) {
+                int bestLength = 0;
+                int bestDistance = 0;
+                if (pos + kMinMatch <= size) {
+                    const int maxLength = (int)std::min<size_t>(kMaxMatch, size - pos);
+                    int32_t candidate = head[hash3(data + pos)];
+                    for (int tries = 0; candidate >= 0 && tries < kMaxChain; ++tries) {
+                        const int distance = (int)(pos - (size_t)candidate);
+                        if (distance > kWindowSize) break;
+                        int length = 0;
+                        while (length < maxLength && data[candidate + length] == data[pos + length]) ++length;
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestDistance = distance;
+                            if (length == maxLength) break;
+                        }
+                        const int32_t next = chain[candidate & (kWindowSize - 1)];
+                        if (next >= candidate) break; // overwritten by a newer position
+                        candidate = next;
+                    }
+                }
+
+                if (bestLength >= kMinMatch) {
+                    putMatch(writer, bestLength, bestDistance);
+                    for (int i = 0; i < bestLength; ++i) insert(pos + (size_t)i);
+                    pos += (size_t)bestLength;
+                } else {
+                    putLiteral(writer, data[pos]);
+                    insert(pos);
+                    ++pos;
+                }
+            }
+            putLiteral(writer, 256); // end of block
+            writer.flush();
+        }
+
+        uint32_t adler32(const uint8_t* data, size_t size) {
+            uint32_t a = 1, b = 0;
+            while (size > 0) {
+                // 5552 bytes keep b below 2^32 before the modulo
+                const size_t n = std::min<size_t>(size, 5552);
+                for (size_t i = 0; i < n; ++i) {
+                    a += data[i];
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+                data += n;
+                size -= n;
+            }
+            return (b << 16) | a;
+        }
+
+        uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+            static const std::array<uint32_t, 256> table = [] {
+                std::array<uint32_t, 256> t {};
+                for (uint32_t n = 0; n < 256; ++n) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    t[n] = c;
+                }
+                return t;
+            }();
+            crc = ~crc;
+            for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+            out.push_back((uint8_t)(value >> 24));
+            out.push_back((uint8_t)(value >> 16));
+            out.push_back((uint8_t)(value >> 8));
+            out.push_back((uint8_t)value);
+        }
+
+        void putChunk(std::vector<uint8_t>& png, const char type[4], const uint8_t* data, size_t size) {
+            putBigEndian(png, (uint32_t)size);
+            const size_t start = png.size();
+            png.insert(png.end(), type, type + 4);
+            png.insert(png.end(), data, data + size);
+            putBigEndian(png, crc32(png.data() + start, size + 4));
+        }
+
+        uint8_t paeth(int a, int b, int c) {
+            const int p = a + b - c;
+            const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            if (pa <= pb && pa <= pc) return (uint8_t)a;
+            return (uint8_t)(pb <= pc ? b : c);
+        }
+
+        // Position of the first "%d" / "%0Nd" in pattern, or npos; any other
+        // '%' is a literal part of the name
+        size_t findFrameConversion(const std::string& pattern) {
+            for (size_t percent = pattern.find('%'); percent != std::string::npos;
+                 percent = pattern.find('%', percent + 1)) {
+                size_t end = percent + 1;
+                while (end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9') ++end;
+                if (end < pattern.size() && pattern[end] == 'd') return percent;
+            }
+            return std::string::npos;
+        }
+
+        // PNG file name for frame index: the conversion findFrameConversion()
+        // found at percent is replaced by the number
+        std::string framePath(const std::string& pattern, size_t percent, uint64_t index) {
+            size_t end = percent + 1;
+            while (pattern[end] >= '0' && pattern[end] <= '9') ++end;
+            const int width = end > percent + 1 ? std::atoi(pattern.c_str() + percent + 1) : 0;
+            std::string number = std::to_string(index);
+            if ((int)number.size() < width) number.insert(0, (size_t)width - number.size(), '0');
+            return pattern.substr(0, percent) + number + pattern.substr(end + 1);
+        }
+    }
+
+    FrameFormat frameFormatFor(const std::string& path) {
+        if (!path.empty() && path[0] == '|') return FrameFormat::Y4m;
+        if (path.size() >= 4) {
+            std::string extension = path.substr(path.size() - 4);
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](unsigned char c) { return (char)std::tolower(c); });
+            if (extension == ".y4m") return FrameFormat::Y4m;
+        }
+        return FrameFormat::Png;
+    }
+
+    void encodePng(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& png) {
+        // Filtered scanlines, top row first: each row tries None, Sub, Up
+        // and Paeth and keeps the one with the smallest sum of |residual|
+        const size_t rowBytes = (size_t)width * 3;
+        std::vector<uint8_t> filtered((rowBytes + 1) * (size_t)height);
+        std::vector<uint8_t> row(rowBytes), above(rowBytes, 0), candidate(rowBytes);
+        for (int y = 0; y < height; ++y) {
+            const uint8_t* src = rgba + (size_t)(height - 1 - y) * width * 4;
+            for (int x = 0; x < width; ++x) {
+                row[x * 3 + 0] = src[x * 4 + 0];
+                row[x * 3 + 1] = src[x * 4 + 1];
+                row[x * 3 + 2] = src[x * 4 + 2];
+            }
+
+            uint8_t* out = filtered.data() + (size_t)y * (rowBytes + 1);
+            uint64_t bestCost = UINT64_MAX;
+            for (uint8_t filter = 0; filter <= 4; ++filter) {
+                if (filter == 3) continue; // Average rarely wins here
+                uint64_t cost = 0;
+                for (size_t i = 0; i < rowBytes; ++i) {
+                    const int left = i >= 3 ? row[i - 3] : 0;
+                    const int up = above[i];
+                    const int upLeft = i >= 3 ? above[i - 3] : 0;
+                    int predicted = 0;
+                    if (filter == 1) predicted = left;
+                    else if (filter == 2) predicted = up;
+                    else if (filter == 4) predicted = paeth(left, up, upLeft);
+                    const uint8_t residual = (uint8_t)(row[i] - predicted);
+                    candidate[i] = residual;
+                    cost += (uint64_t)std::abs((int)(int8_t)residual);
+                }
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    out[0] = filter;
+                    std::memcpy(out + 1, candidate.data(), rowBytes);
+                }
+            }
+            std::swap(row, above);
+        }
+
+        std::vector<uint8_t> zlib = { 0x78, 0x01 };
+        zlib.reserve(filtered.size() / 4);
+        deflateFixed(filtered.data(), filtered.size(), zlib);
+        putBigEndian(zlib, adler32(filtered.data(), filtered.size()));
+
+        static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        png.assign(kSignature, kSignature + 8);
+        std::vector<uint8_t> header;
+        putBigEndian(header, (uint32_t)width);
+        putBigEndian(header, (uint32_t)height);
+        header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8-bit RGB, deflate, no interlace
+        putChunk(png, "IHDR", header.data(), header.size());
+        putChunk(png, "IDAT", zlib.data(), zlib.size());
+        putChunk(png, "IEND", nullptr, 0);
+    }
+
+    void rgbaToI420(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& yuv) {
+        const size_t lumaBytes = (size_t)width * height;
+        const size_t chromaWidth = (size_t)width / 2;
+        yuv.resize(lumaBytes + 2 * chromaWidth * (size_t)(height / 2));
+        uint8_t* lumaPlane = yuv.data();
+        uint8_t* uPlane = lumaPlane + lumaBytes;
+        uint8_t* vPlane = uPlane + chromaWidth * (size_t)(height / 2);
+
+        // BT.601, limited range
+        for (int y = 0; y < height; ++y) {
+            const uint8_t* src = rgba + (size_t)(height - 1 - y) * width * 4;
+            uint8_t* dst = lumaPlane + (size_t)y * width;
+            for (int x = 0; x < width; ++x) {
+                const int r = src[x * 4], g = src[x * 4 + 1], b = src[x * 4 + 2];
+                dst[x] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            }
+        }
+        for (int y = 0; y < height / 2; ++y) {
+            const uint8_t* top = rgba + (size_t)(height - 1 - 2 * y) * width * 4;
+            const uint8_t* bottom = top - (size_t)width * 4;
+            for (size_t x = 0; x < chromaWidth; ++x) {
+                int sum[3];
+                for (int c = 0; c < 3; ++c) {
+                    sum[c] = top[x * 8 + c] + top[x * 8 + 4 + c] + bottom[x * 8 + c] + bottom[x * 8 + 4 + c];
+                }
+                const int r = (sum[0] + 2) >> 2, g = (sum[1] + 2) >> 2, b = (sum[2] + 2) >> 2;
+                uPlane[(size_t)y * chromaWidth + x] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                vPlane[(size_t)y * chromaWidth + x] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+    }
+
+    FrameWriter::FrameWriter(size_t threads, size_t queueDepth)
+        : threadCount(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency())),
+          queue(queueDepth > 0 ? queueDepth : 2 * threadCount) {
+    }
+
+    FrameWriter::~FrameWriter() {
+        close();
+    }
+
+    bool FrameWriter::open(const std::string& path, const FrameExportInfo& exportInfo, std::string& error) {
+        close();
+        if (exportInfo.width <= 0 || exportInfo.height <= 0) {
+            error = "nothing to export";
+            return false;
+        }
+
+        format = frameFormatFor(path);
+        if (format == FrameFormat::Y4m) {
+            if (exportInfo.width % 2 != 0 || exportInfo.height % 2 != 0) {
+                error = "Y4M frames need an even width and height";
+                return false;
+            }
+            piped = path[0] == '|';
+            if (piped) {
+#ifdef _WIN32
+                stream = _popen(path.c_str() + 1, "wb");
+#else
+                // A consumer that exits early must fail the export, not kill it
+                std::signal(SIGPIPE, SIG_IGN);
+                stream = popen(path.c_str() + 1, "w");
+#endif
+            } else {
+                stream = std::fopen(path.c_str(), "wb");
+            }
+            if (stream == nullptr) {
+                error = piped ? "could not start '" + path.substr(1) + "'" : "could not open '" + path + "' for writing";
+                return false;
+            }
+            const std::string header = "YUV4MPEG2 W" + std::to_string(exportInfo.width) + " H" +
+                std::to_string(exportInfo.height) + " F" + std::to_string(std::max<uint32_t>(1, exportInfo.frameRate)) +
+                ":1 Ip A1:1 C420jpeg XYSCSS=420JPEG\n";
+            byteCount = std::fwrite(header.data(), 1, header.size(), stream);
+            headerFailed = byteCount != header.size();
+        } else {
+            // The files are only created as frames arrive; catch a missing
+            // directory now rather than at the first frame
+            const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+            std::error_code status;
+            if (!directory.empty() && !std::filesystem::is_directory(directory, status)) {
+                error = "directory '" + directory.string() + "' does not exist";
+                return false;
+            }
+            pattern = path;
+            conversion = findFrameConversion(pattern);
+            if (conversion == std::string::npos) {
+                const size_t slash = pattern.find_last_of("/\\");
+                const size_t dot = pattern.find_last_of('.');
+                if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+                    conversion = pattern.size() + 1;
+                    pattern += "_%06d.png";
+                } else {
+                    conversion = dot + 1;
+                    pattern.insert(dot, "_%06d");
+                }
+            }
+            byteCount = 0;
+            headerFailed = false;
+        }
+
+        info = exportInfo;
+        opened = true;
+        nextToWrite = 0;
+        queue.start(threadCount, [this](Frame& frame) {
+            thread_local std::vector<uint8_t> encoded;
+            return write(frame, encoded);
+        });
+        return true;
+    }
+
+    void FrameWriter::push(std::vector<uint8_t> rgba) {
+        if (!opened || rgba.size() != (size_t)info.width * info.height * 4) return;
+        queue.push(0, std::move(rgba));
+    }
+
+    bool FrameWriter::close() {
+        if (!opened) return true;
+        bool ok = queue.stop() && !headerFailed;
+        if (stream != nullptr) {
+#ifdef _WIN32
+            const int closed = piped ? _pclose(stream) : std::fclose(stream);
+#else
+            const int closed = piped ? pclose(stream) : std::fclose(stream);
+#endif
+            ok = ok && closed == 0;
+            stream = nullptr;
+        }
+        piped = false;
+        opened = false;
+        return ok;
+    }
+
+    uint64_t FrameWriter::bytesWritten() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return byteCount;
+    }
+
+    bool FrameWriter::write(const Frame& frame, std::vector<uint8_t>& encoded) {
+        if (format == FrameFormat::Png) {
+            encodePng(frame.data.data(), info.width, info.height, encoded);
+            std::FILE* file = std::fopen(framePath(pattern, conversion, frame.sequence).c_str(), "wb");
+            if (file == nullptr) return false;
+            const bool written = std::fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+            const bool ok = std::fclose(file) == 0 && written;
+            std::lock_guard<std::mutex> lock(mutex);
+            byteCount += encoded.size();
+            return ok;
+        }
+
+        // Convert in parallel, then wait for this frame's turn in the stream
+        rgbaToI420(frame.data.data(), info.width, info.height, encoded);
+        std::unique_lock<std::mutex> lock(mutex);
+        turn.wait(lock, [&] { return nextToWrite == frame.sequence; });
+        lock.unlock();
+
+        static const char kFrameHeader[] = "FRAME\n";
+        const bool ok = std::fwrite(kFrameHeader, 1, 6, stream) == 6
+            && std::fwrite(encoded.data(), 1, encoded.size(), stream) == encoded.size();
+
+        lock.lock();
+        byteCount += 6 + encoded.size();
+        ++nextToWrite;
+        lock.unlock();
+        turn.notify_all();
+        return ok;
+    }
+}
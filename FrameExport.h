@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "WorkQueue.h"
+
+namespace Particles {
+
+    // Offscreen frame export. Frames arrive as RGBA8 pixels, bottom row
+    // first (as glReadPixels returns them), and are written either as a
+    // numbered PNG sequence or as a single YUV4MPEG2 stream:
+    //
+    //   - "*.y4m" writes one Y4M file (4:2:0, BT.601 limited range), which
+    //     may also be a named pipe
+    //   - "|command" starts command and writes the Y4M stream to its
+    //     standard input, e.g. "|ffmpeg -i - -c:v libx264 run.mp4"
+    //   - anything else is a PNG sequence: a path containing a printf-style
+    //     frame-number conversion ("frames/%05d.png") is used as it is,
+    //     otherwise "_%06d" goes in front of the extension; any other '%'
+    //     is part of the file name
+    enum class FrameFormat {
+        Png,
+        Y4m,
+    };
+
+    FrameFormat frameFormatFor(const std::string& path);
+
+    struct FrameExportInfo {
+        int width = 0;           // both even for Y4M (4:2:0 chroma)
+        int height = 0;
+        uint32_t frameRate = 60; // Y4M header only
+    };
+
+    // Standalone encoders, used by the writer's workers. rgba is
+    // width * height * 4 bytes, bottom row first; alpha is dropped.
+    // encodePng() produces a complete 8-bit RGB PNG file (deflate with
+    // fixed Huffman codes and per-row filters).
+    void encodePng(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& png);
+    // Planar Y, U, V, chroma averaged over 2x2 blocks; width and height even
+    void rgbaToI420(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& yuv);
+
+    // Encodes frames on worker threads fed through a WorkQueue. PNG frames
+    // are encoded and written by whichever worker takes them; Y4M frames
+    // are converted in parallel and written in order.
+    class FrameWriter {
+    public:
+        // threads == 0 uses every hardware thread; queueDepth == 0 allows
+        // two frames per worker
+        explicit FrameWriter(size_t threads = 0, size_t queueDepth = 0);
+        ~FrameWriter();
+        FrameWriter(const FrameWriter&) = delete;
+        FrameWriter& operator=(const FrameWriter&) = delete;
+
+        bool open(const std::string& path, const FrameExportInfo& info, std::string& error);
+        bool isOpen() const { return opened; }
+        const FrameExportInfo& getInfo() const { return info; }
+        FrameFormat getFormat() const { return format; }
+
+        std::vector<uint8_t> takeBuffer() { return queue.takeBuffer(); }
+        // rgba must hold info.width * info.height * 4 bytes
+        void push(std::vector<uint8_t> rgba);
+        // Writes every queued frame and closes the output; false if any write failed
+        bool close();
+
+        uint64_t framesWritten() const { return queue.itemsProcessed(); }
+        uint64_t bytesWritten() const;
+
+    private:
+        using Frame = WorkQueue<uint8_t>::Item;
+
+        FrameExportInfo info;
+        FrameFormat format { FrameFormat::Png };
+        std::string pattern;         // PNG file name pattern
+        size_t conversion { 0 };     // where its frame-number conversion starts
+        std::FILE* stream { nullptr }; // Y4M output
+        bool piped { false };        // stream came from popen()
+        bool opened { false };
+        bool headerFailed { false };
+        size_t threadCount;
+        WorkQueue<uint8_t> queue;
+
+        mutable std::mutex mutex;
+        std::condition_variable turn;  // Y4M: the next frame in order may be written
+        uint64_t nextToWrite { 0 };
+        uint64_t byteCount { 0 };
+
+        bool write(const Frame& frame, std::vector<uint8_t>& encoded);
+    };
+}
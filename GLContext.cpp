@@ -0,0 +1,31 @@
+#include "GLContext.h"
+
+#include <iostream>
+
+GLFWwindow* createHiddenGLContext(int width, int height, const char* title) {
+    if (!glfwInit()) {
+        std::cout << "Failed to initialize GLFW: the GL context needs a display server "
+                     "(run under xvfb-run where there is none)" << std::endl;
+        return nullptr;
+    }
+
+    // The context needs a window, but it is never shown or swapped
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(width, height, title, NULL, NULL);
+    if (window == NULL) {
+        std::cout << "Failed to create hidden GLFW window" << std::endl;
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        glfwTerminate();
+        return nullptr;
+    }
+    return window;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// Initialises GLFW, creates an invisible width x height window with a 4.3
+// core context, makes it current and loads the GL entry points. Returns null
+// (after printing why and terminating GLFW) on failure. The caller owns the
+// window and calls glfwTerminate() when done with it.
+//
+// Even an invisible window needs a display server (X11, Wayland or a
+// virtual one such as Xvfb): without one glfwInit() fails, and so does
+// every headless GPU run or frame export.
+GLFWwindow* createHiddenGLContext(int width, int height, const char* title);
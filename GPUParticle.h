@@ -10,7 +10,7 @@ struct GPUParticle {
     float vx, vy;         //  8
     float radius;         // 16
     float mass;          // 20
-    float _gap_to_32[2];  // 24..31  (make color start at 32)
+    float ax, ay;         // 24  acceleration of the last step (velocity Verlet)
     float r, g, b, a;     // 32..47
     int   colorSpecies;        // 48..51
     float _pad1;          // 52..55
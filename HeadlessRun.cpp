@@ -0,0 +1,372 @@
+#include "HeadlessRun.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "CpuSimulator.h"
+#include "FrameArena.h"
+#include "FrameCapture.h"
+#include "FrameExport.h"
+#include "GLContext.h"
+#include "Metrics.h"
+#include "MetricsRecorder.h"
+#include "ParticleSpawner.h"
+#include "Renderer.h"
+#include "Snapshot.h"
+#include "Trajectory.h"
+#include "TrajectoryRecorder.h"
+#include "UniverseBatch.h"
+
+namespace {
+
+    bool writeParticleState(const std::string& path, const std::vector<GPUParticle>& particles) {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cout << "Failed to open '" << path << "' for writing" << std::endl;
+            return false;
+        }
+        out << "px,py,vx,vy,radius,mass,species\n";
+        for (const GPUParticle& p : particles) {
+            out << p.px << ',' << p.py << ',' << p.vx << ',' << p.vy << ','
+                << p.radius << ',' << p.mass << ',' << p.colorSpecies << '\n';
+        }
+        return static_cast<bool>(out);
+    }
+
+    // Fresh particles from options.seed, or everything a snapshot holds. A
+    // snapshot overrides the world size, time step and simulation parameters
+    // given on the command line so that the run continues exactly.
+    bool prepareRun(const LaunchOptions& options, Particles::SnapshotState& state, std::mt19937& rng,
+                    std::vector<GPUParticle>& particles) {
+        if (options.loadPath.empty()) {
+            state.worldWidth = options.worldWidth;
+            state.worldHeight = options.worldHeight;
+            state.deltaTime = options.deltaTime;
+            state.params = options.params;
+            rng.seed(options.seed + 1);
+            Particles::resetSimulation(particles, options.particleCount, state.worldWidth, state.worldHeight,
+                                       options.seed);
+            return true;
+        }
+
+        Particles::SnapshotFile snapshot;
+        std::string error;
+        if (!snapshot.open(options.loadPath, error)) {
+            std::cout << "Failed to load snapshot: " << error << std::endl;
+            return false;
+        }
+        state = snapshot.state();
+        Color::attractionMatrix = state.attraction;
+        std::istringstream(state.rngState) >> rng;
+        particles.assign(snapshot.particles(), snapshot.particles() + snapshot.particleCount());
+        std::cout << "Loaded " << particles.size() << " particles at step " << state.stepCount
+                  << " from '" << options.loadPath << "'" << std::endl;
+        return true;
+    }
+
+    // Drawing state for frame export: the particles are drawn as in the
+    // window, so the renderer needs its geometry and the window's clear
+    // colour even when the physics does not run on the GPU
+    void prepareExportDrawing(const LaunchOptions& options, Particles::Renderer& renderer) {
+        renderer.setDrawMode(options.drawMode);
+        renderer.createGeometryGPU();
+        glClearColor(Particles::kBackgroundColor[0], Particles::kBackgroundColor[1], Particles::kBackgroundColor[2],
+                     Particles::kBackgroundColor[3]);
+    }
+
+    bool runCpu(const LaunchOptions& options, const Particles::SnapshotState& state, std::mt19937& rng,
+                std::vector<GPUParticle>& particles, Particles::TrajectoryWriter& trajectory,
+                Particles::MetricsWriter& metrics, Particles::FrameWriter& frames) {
+        Particles::CpuSimulator sim(state.worldWidth, state.worldHeight, options.threads, state.params);
+        sim.setParticles(particles);
+        if (options.forceKernelGiven) sim.setForceKernel(options.forceKernel);
+        std::cout << "Headless CPU run with " << sim.threadCount() << " threads, "
+                  << Particles::forceKernelName(sim.getForceKernel()) << " force kernel." << std::endl;
+
+        // Exporting draws through a hidden GL context; the GPU buffer only
+        // mirrors the simulator on the captured steps
+        GLFWwindow* window = nullptr;
+        std::unique_ptr<Particles::Renderer> renderer;
+        std::unique_ptr<Particles::FrameCapture> capture;
+        if (frames.isOpen()) {
+            window = createHiddenGLContext((int)state.worldWidth, (int)state.worldHeight, "Particle Sim (headless)");
+            if (window == nullptr) {
+                return false;
+            }
+            renderer = std::make_unique<Particles::Renderer>(window, state.worldWidth, state.worldHeight);
+            renderer->setSimulationParams(state.params);
+            renderer->initializeGPUBuffer(particles);
+            prepareExportDrawing(options, *renderer);
+            capture = std::make_unique<Particles::FrameCapture>(frames, *renderer);
+            capture->capture(particles.size());
+        }
+
+        Particles::FrameArena stepArena;
+        Particles::TrajectoryRecorder recorder(trajectory, nullptr);
+        recorder.afterStep(state.stepCount, &sim.particles());
+        Particles::MetricsRecorder metricsRecorder(metrics, nullptr, &sim);
+
+        for (long long step = 0; step < options.steps; ++step) {
+            sim.step(state.deltaTime);
+            metricsRecorder.afterStep(state.stepCount + (uint64_t)step + 1, particles.size());
+            stepArena.reset();
+            const Particles::DeathRoll deaths = Particles::rollDeaths(rng, particles.size(), state.worldWidth,
+                                                                      state.worldHeight, stepArena);
+            for (size_t i = 0; i < deaths.count; ++i) {
+                sim.particles()[deaths.indices[i]] = deaths.births[i];
+            }
+            recorder.afterStep(state.stepCount + (uint64_t)step + 1, &sim.particles());
+            if (capture && (step + 1) % options.exportInterval == 0) {
+                renderer->uploadParticles(sim.particles());
+                capture->capture(particles.size());
+            }
+        }
+
+        metricsRecorder.measureCurrent(state.stepCount + (uint64_t)options.steps, particles.size());
+
+        particles = sim.particles();
+        if (window != nullptr) {
+            capture->finish();
+            capture.reset();
+            renderer.reset();
+            glfwTerminate();
+        }
+        return true;
+    }
+
+    bool runGpu(const LaunchOptions& options, const Particles::SnapshotState& state, std::mt19937& rng,
+                std::vector<GPUParticle>& particles, Particles::TrajectoryWriter& trajectory,
+                Particles::MetricsWriter& metrics, Particles::FrameWriter& frames) {
+        GLFWwindow* window = createHiddenGLContext((int)state.worldWidth, (int)state.worldHeight,
+                                                   "Particle Sim (headless)");
+        if (window == nullptr) {
+            return false;
+        }
+
+        {
+            Particles::Renderer renderer(window, state.worldWidth, state.worldHeight);
+            renderer.setSimulationParams(state.params);
+            renderer.initializeGPUBuffer(particles);
+
+            Particles::FrameArena stepArena;
+            Particles::TrajectoryRecorder recorder(trajectory, &renderer);
+            recorder.afterStep(state.stepCount);
+            Particles::MetricsRecorder metricsRecorder(metrics, &renderer, nullptr);
+            std::unique_ptr<Particles::FrameCapture> capture;
+            if (frames.isOpen()) {
+                prepareExportDrawing(options, renderer);
+                capture = std::make_unique<Particles::FrameCapture>(frames, renderer);
+                capture->capture(particles.size());
+            }
+
+            for (long long step = 0; step < options.steps; ++step) {
+                renderer.dispatchComputeShader(particles.size(), state.deltaTime);
+                metricsRecorder.afterStep(state.stepCount + (uint64_t)step + 1, particles.size());
+                stepArena.reset();
+                const Particles::DeathRoll deaths = Particles::rollDeaths(rng, particles.size(), state.worldWidth,
+                                                                          state.worldHeight, stepArena);
+                renderer.writeParticles(deaths.indices, deaths.births, deaths.count);
+                recorder.afterStep(state.stepCount + (uint64_t)step + 1);
+                if (capture && (step + 1) % options.exportInterval == 0) {
+                    capture->capture(particles.size());
+                }
+            }
+            recorder.finish();
+            metricsRecorder.measureCurrent(state.stepCount + (uint64_t)options.steps, particles.size());
+            metricsRecorder.finish();
+            if (capture) capture->finish();
+
+            renderer.downloadParticles(particles);
+        }
+
+        glfwTerminate();
+        return true;
+    }
+    // Summary row per universe; the matrix column lists the weights in
+    // [from * numSpecies + to] order, separated by spaces
+    bool writeBatchSummary(const std::string& path, const Particles::UniverseBatch& batch,
+                           const LaunchOptions& options) {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cout << "Failed to open '" << path << "' for writing" << std::endl;
+            return false;
+        }
+        out << "universe,seed,particles,steps,mean_kinetic_energy,matrix\n";
+        for (size_t u = 0; u < batch.size(); ++u) {
+            out << u << ',' << options.seed + (uint32_t)u << ',' << batch.particles(u).size() << ','
+                << options.steps << ',' << batch.meanKineticEnergy(u) << ',';
+            const Color::AttractionMatrix& matrix = batch.attraction(u);
+            for (size_t i = 0; i < matrix.size(); ++i) {
+                out << (i > 0 ? " " : "") << matrix.data()[i];
+            }
+            out << '\n';
+        }
+        return static_cast<bool>(out);
+    }
+
+    int runBatch(const LaunchOptions& options) {
+        const int numSpecies = Color::speciesCount(Color::attractionMatrix);
+        Particles::UniverseBatch batch(options.worldWidth, options.worldHeight, options.threads, options.params);
+        if (options.forceKernelGiven) batch.setForceKernel(options.forceKernel);
+        std::vector<GPUParticle> particles;
+        for (int u = 0; u < options.universes; ++u) {
+            // Same seeding as a single run started with --seed=seed
+            const uint32_t seed = options.seed + (uint32_t)u;
+            Particles::resetSimulation(particles, options.particleCount, options.worldWidth, options.worldHeight,
+                                       seed);
+            batch.add(particles, Color::randomAttractionMatrix(numSpecies, seed), seed + 1);
+        }
+        std::cout << "Headless batch of " << batch.size() << " universes on " << batch.threadCount()
+                  << " threads." << std::endl;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (long long step = 0; step < options.steps; ++step) {
+            batch.step(options.deltaTime);
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const double universeSteps = (double)options.steps * (double)batch.size();
+        const double particleSteps = universeSteps * (double)options.particleCount;
+        std::cout << "Simulated " << options.steps << " steps of " << batch.size() << " universes x "
+                  << options.particleCount << " particles in " << seconds << " s ("
+                  << (universeSteps / seconds) << " universe-steps/s, "
+                  << (particleSteps > 0.0 ? seconds * 1e9 / particleSteps : 0.0) << " ns per particle-step)"
+                  << std::endl;
+
+        if (!writeBatchSummary(options.outputPath, batch, options)) {
+            return -1;
+        }
+        std::cout << "Batch summary written to '" << options.outputPath << "'" << std::endl;
+        return 0;
+    }
+}
+
+int runHeadless(const LaunchOptions& options) {
+    if (options.universes > 0) {
+        return runBatch(options);
+    }
+
+    Particles::SnapshotState state;
+    std::mt19937 rng;
+    std::vector<GPUParticle> particles;
+    if (!prepareRun(options, state, rng, particles)) {
+        return -1;
+    }
+
+    Particles::TrajectoryWriter trajectory;
+    if (!options.recordPath.empty()) {
+        Particles::TrajectoryInfo recording;
+        recording.particleCount = particles.size();
+        recording.stepInterval = options.recordInterval;
+        recording.worldWidth = state.worldWidth;
+        recording.worldHeight = state.worldHeight;
+        recording.deltaTime = state.deltaTime;
+        std::string error;
+        if (!trajectory.open(options.recordPath, recording, error)) {
+            std::cout << "Failed to start recording: " << error << std::endl;
+            return -1;
+        }
+    }
+
+    Particles::MetricsWriter metrics;
+    if (!options.metricsPath.empty()) {
+        Particles::MetricsInfo info;
+        info.numSpecies = Color::speciesCount(Color::attractionMatrix);
+        info.stepInterval = options.metricsInterval;
+        info.radius = options.metricsRadius;
+        std::string error;
+        if (!metrics.open(options.metricsPath, info, error)) {
+            std::cout << "Failed to start metrics: " << error << std::endl;
+            return -1;
+        }
+    }
+
+    // Frames are drawn at the world size unless --export-size says otherwise
+    Particles::FrameWriter frames(options.exportThreads);
+    if (!options.exportPath.empty()) {
+        Particles::FrameExportInfo info;
+        info.width = options.exportWidth > 0 ? options.exportWidth : (int)state.worldWidth & ~1;
+        info.height = options.exportHeight > 0 ? options.exportHeight : (int)state.worldHeight & ~1;
+        info.frameRate = options.exportFrameRate;
+        std::string error;
+        if (!frames.open(options.exportPath, info, error)) {
+            std::cout << "Failed to start export: " << error << std::endl;
+            return -1;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool ran = options.backend == PhysicsBackend::Cpu
+                         ? runCpu(options, state, rng, particles, trajectory, metrics, frames)
+                         : runGpu(options, state, rng, particles, trajectory, metrics, frames);
+    if (!ran) {
+        return -1;
+    }
+    // The recording and the export are part of the run: wait until they are on disk
+    const bool recorded = trajectory.close();
+    const bool exported = frames.close();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double particleSteps = (double)options.steps * (double)particles.size();
+    std::cout << "Simulated " << options.steps << " steps of " << particles.size() << " particles in "
+              << seconds << " s (" << (options.steps / seconds) << " steps/s, "
+              << (particleSteps > 0.0 ? seconds * 1e9 / particleSteps : 0.0) << " ns per particle-step)"
+              << std::endl;
+
+    if (!options.recordPath.empty()) {
+        if (!recorded) {
+            std::cout << "Failed to write trajectory '" << options.recordPath << "'" << std::endl;
+            return -1;
+        }
+        const double particleFrames = (double)trajectory.framesWritten() * (double)particles.size();
+        std::cout << "Recorded " << trajectory.framesWritten() << " frames to '" << options.recordPath << "' ("
+                  << trajectory.bytesWritten() << " bytes, "
+                  << (particleFrames > 0.0 ? trajectory.bytesWritten() / particleFrames : 0.0)
+                  << " bytes per particle-frame)" << std::endl;
+    }
+
+    if (!options.exportPath.empty()) {
+        if (!exported) {
+            std::cout << "Failed to write frames to '" << options.exportPath << "'" << std::endl;
+            return -1;
+        }
+        std::cout << "Exported " << frames.framesWritten() << " " << frames.getInfo().width << "x"
+                  << frames.getInfo().height << " frames to '" << options.exportPath << "' ("
+                  << frames.bytesWritten() << " bytes)" << std::endl;
+    }
+
+    if (!options.metricsPath.empty()) {
+        const uint64_t rows = metrics.rowsWritten();
+        if (!metrics.close()) {
+            std::cout << "Failed to write metrics '" << options.metricsPath << "'" << std::endl;
+            return -1;
+        }
+        std::cout << "Wrote " << rows << " metrics rows to '" << options.metricsPath << "'" << std::endl;
+    }
+
+    if (!writeParticleState(options.outputPath, particles)) {
+        return -1;
+    }
+    std::cout << "Final state written to '" << options.outputPath << "'" << std::endl;
+
+    if (!options.savePath.empty()) {
+        state.stepCount += (uint64_t)options.steps;
+        state.attraction = Color::attractionMatrix;
+        std::ostringstream rngState;
+        rngState << rng;
+        state.rngState = rngState.str();
+
+        std::string error;
+        if (!Particles::writeSnapshot(options.savePath, state, particles.data(), particles.size(), error)) {
+            std::cout << "Failed to save snapshot: " << error << std::endl;
+            return -1;
+        }
+        std::cout << "Snapshot at step " << state.stepCount << " written to '" << options.savePath << "'" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "LaunchOptions.h"
+
+// Runs options.steps fixed-size steps without presenting anything and writes
+// the final particle state to options.outputPath. Returns the process exit code.
+int runHeadless(const LaunchOptions& options);
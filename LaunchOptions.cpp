@@ -0,0 +1,209 @@
+#include "LaunchOptions.h"
+
+#include <cstdlib>
+#include <iostream>
+
+static void printUsage() {
+    std::cout << "Usage: ParticleSim [--backend=gpu|cpu] [--threads=N] [--profile] [--trace=FILE]\n"
+              << "                   [--dt=SECONDS] [--substeps=N] [--max-substeps=N] [--integrator=euler|verlet]\n"
+              << "                   [--snapshot=FILE] [--load=FILE] [--record=FILE] [--record-every=N]\n"
+              << "                   [--matrix=FILE] [--params=FILE] [--no-watch] [--draw=quads|hdr|splat]\n"
+              << "                   [--metrics=FILE] [--metrics-every=N] [--metrics-radius=PX]\n"
+              << "                   [--export=PATH] [--export-size=WxH] [--export-every=N] [--export-fps=N]\n"
+              << "                   [--export-threads=N] [--cpu-kernel=KERNEL] [--boundary=BOUNDARY]\n"
+              << "                   [--width=PX] [--height=PX]\n"
+              << "       ParticleSim --headless [--particles=N] [--steps=N] [--dt=SECONDS] [--seed=N]\n"
+              << "                   [--width=PX] [--height=PX] [--out=FILE] [--backend=gpu|cpu] [--threads=N]\n"
+              << "                   [--cpu-kernel=KERNEL] [--integrator=euler|verlet] [--load=FILE] [--save=FILE]\n"
+              << "                   [--record=FILE] [--record-every=N] [--matrix=FILE] [--params=FILE]\n"
+              << "                   [--metrics=FILE] [--metrics-every=N] [--metrics-radius=PX]\n"
+              << "                   [--export=PATH] [--export-size=WxH] [--export-every=N] [--export-fps=N]\n"
+              << "                   [--export-threads=N] [--boundary=BOUNDARY]\n"
+              << "       ParticleSim --headless --universes=M [--particles=N] [--steps=N] [--dt=SECONDS] [--seed=N]\n"
+              << "                   [--width=PX] [--height=PX] [--out=FILE] [--threads=N] [--integrator=euler|verlet]\n"
+              << "                   [--cpu-kernel=KERNEL] [--boundary=BOUNDARY]\n"
+              << "KERNEL is auto (default), scalar, avx2, avx512 or neon\n"
+              << "BOUNDARY is open (default), torus or reflect"
+              << std::endl;
+}
+
+// Matches "--name=value" and points value at the text after '='
+static bool matchValue(const std::string& arg, const char* name, const char*& value) {
+    const std::string prefix = std::string(name) + "=";
+    if (arg.rfind(prefix, 0) != 0) return false;
+    value = arg.c_str() + prefix.size();
+    return true;
+}
+
+bool parseLaunchOptions(int argc, char** argv, LaunchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const char* value = nullptr;
+        char* end = nullptr;
+        bool valid = true;
+
+        if (arg == "--backend=gpu") {
+            options.backend = PhysicsBackend::Gpu;
+            options.backendGiven = true;
+        } else if (arg == "--backend=cpu") {
+            options.backend = PhysicsBackend::Cpu;
+            options.backendGiven = true;
+        } else if (arg == "--cpu-kernel=auto") {
+            options.forceKernelGiven = false;
+        } else if (arg == "--cpu-kernel=scalar") {
+            options.forceKernel = Particles::ForceKernelIsa::Scalar;
+            options.forceKernelGiven = true;
+        } else if (arg == "--cpu-kernel=avx2") {
+            options.forceKernel = Particles::ForceKernelIsa::Avx2;
+            options.forceKernelGiven = true;
+        } else if (arg == "--cpu-kernel=avx512") {
+            options.forceKernel = Particles::ForceKernelIsa::Avx512;
+            options.forceKernelGiven = true;
+        } else if (arg == "--cpu-kernel=neon") {
+            options.forceKernel = Particles::ForceKernelIsa::Neon;
+            options.forceKernelGiven = true;
+        } else if (arg == "--integrator=euler") {
+            options.params.integrator = Particles::Integrator::SemiImplicitEuler;
+        } else if (arg == "--integrator=verlet") {
+            options.params.integrator = Particles::Integrator::VelocityVerlet;
+        } else if (arg == "--boundary=open") {
+            options.params.boundary = Particles::Boundary::Open;
+        } else if (arg == "--boundary=torus") {
+            options.params.boundary = Particles::Boundary::Torus;
+        } else if (arg == "--boundary=reflect") {
+            options.params.boundary = Particles::Boundary::Reflect;
+        } else if (arg == "--draw=quads") {
+            options.drawMode = Particles::DrawMode::Quads;
+        } else if (arg == "--draw=hdr") {
+            options.drawMode = Particles::DrawMode::SinglePass;
+        } else if (arg == "--draw=splat") {
+            options.drawMode = Particles::DrawMode::DensitySplat;
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--no-watch") {
+            options.watch = false;
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (matchValue(arg, "--trace", value)) {
+            options.tracePath = value;
+            valid = !options.tracePath.empty();
+        } else if (matchValue(arg, "--matrix", value)) {
+            options.matrixPath = value;
+            valid = !options.matrixPath.empty();
+        } else if (matchValue(arg, "--params", value)) {
+            options.paramsPath = value;
+            valid = !options.paramsPath.empty();
+        } else if (matchValue(arg, "--snapshot", value)) {
+            options.snapshotPath = value;
+            valid = !options.snapshotPath.empty();
+        } else if (matchValue(arg, "--load", value)) {
+            options.loadPath = value;
+            valid = !options.loadPath.empty();
+        } else if (matchValue(arg, "--save", value)) {
+            options.savePath = value;
+            valid = !options.savePath.empty();
+        } else if (matchValue(arg, "--record", value)) {
+            options.recordPath = value;
+            valid = !options.recordPath.empty();
+        } else if (matchValue(arg, "--record-every", value)) {
+            options.recordInterval = (uint32_t)std::strtoul(value, &end, 10);
+            valid = options.recordInterval > 0;
+        } else if (matchValue(arg, "--metrics", value)) {
+            options.metricsPath = value;
+            valid = !options.metricsPath.empty();
+        } else if (matchValue(arg, "--metrics-every", value)) {
+            options.metricsInterval = (uint32_t)std::strtoul(value, &end, 10);
+            valid = options.metricsInterval > 0;
+        } else if (matchValue(arg, "--metrics-radius", value)) {
+            options.metricsRadius = std::strtof(value, &end);
+            valid = options.metricsRadius > 0.0f;
+        } else if (matchValue(arg, "--export", value)) {
+            options.exportPath = value;
+            valid = !options.exportPath.empty();
+        } else if (matchValue(arg, "--export-size", value)) {
+            options.exportWidth = (int)std::strtol(value, &end, 10);
+            valid = options.exportWidth > 0 && *end == 'x';
+            if (valid) {
+                options.exportHeight = (int)std::strtol(end + 1, &end, 10);
+                valid = options.exportHeight > 0;
+            }
+        } else if (matchValue(arg, "--export-every", value)) {
+            options.exportInterval = (uint32_t)std::strtoul(value, &end, 10);
+            valid = options.exportInterval > 0;
+        } else if (matchValue(arg, "--export-fps", value)) {
+            options.exportFrameRate = (uint32_t)std::strtoul(value, &end, 10);
+            valid = options.exportFrameRate > 0;
+        } else if (matchValue(arg, "--export-threads", value)) {
+            options.exportThreads = std::strtoul(value, &end, 10);
+        } else if (matchValue(arg, "--threads", value)) {
+            options.threads = std::strtoul(value, &end, 10);
+        } else if (matchValue(arg, "--particles", value)) {
+            options.particleCount = (int)std::strtol(value, &end, 10);
+            valid = options.particleCount > 0;
+        } else if (matchValue(arg, "--universes", value)) {
+            options.universes = (int)std::strtol(value, &end, 10);
+            valid = options.universes > 0;
+        } else if (matchValue(arg, "--steps", value)) {
+            options.steps = std::strtoll(value, &end, 10);
+            valid = options.steps >= 0;
+        } else if (matchValue(arg, "--dt", value)) {
+            options.deltaTime = std::strtof(value, &end);
+            valid = options.deltaTime > 0.0f;
+        } else if (matchValue(arg, "--substeps", value)) {
+            options.substeps = (int)std::strtol(value, &end, 10);
+            valid = options.substeps >= 0;
+        } else if (matchValue(arg, "--max-substeps", value)) {
+            options.maxSubsteps = (int)std::strtol(value, &end, 10);
+            valid = options.maxSubsteps > 0;
+        } else if (matchValue(arg, "--seed", value)) {
+            options.seed = (uint32_t)std::strtoul(value, &end, 10);
+        } else if (matchValue(arg, "--width", value)) {
+            options.worldWidth = std::strtof(value, &end);
+            valid = options.worldWidth > 0.0f;
+            options.worldSizeGiven = true;
+        } else if (matchValue(arg, "--height", value)) {
+            options.worldHeight = std::strtof(value, &end);
+            valid = options.worldHeight > 0.0f;
+            options.worldSizeGiven = true;
+        } else if (matchValue(arg, "--out", value)) {
+            options.outputPath = value;
+            valid = !options.outputPath.empty();
+        } else {
+            std::cout << "Unknown option '" << arg << "'" << std::endl;
+            printUsage();
+            return false;
+        }
+
+        if (!valid || (end != nullptr && (end == value || *end != '\0'))) {
+            std::cout << "Invalid value in '" << arg << "'" << std::endl;
+            printUsage();
+            return false;
+        }
+    }
+
+    if (options.forceKernelGiven && !Particles::forceKernelAvailable(options.forceKernel)) {
+        std::cout << "The " << Particles::forceKernelName(options.forceKernel)
+                  << " force kernel is not available on this CPU or build" << std::endl;
+        return false;
+    }
+    if (options.headless && !options.backendGiven) {
+        options.backend = PhysicsBackend::Cpu;
+    }
+    if (options.universes > 0) {
+        const char* problem = nullptr;
+        if (!options.headless) {
+            problem = "--universes needs --headless";
+        } else if (options.backend != PhysicsBackend::Cpu) {
+            problem = "--universes runs on the CPU backend only";
+        } else if (!options.loadPath.empty() || !options.savePath.empty() || !options.recordPath.empty() ||
+                   !options.metricsPath.empty() || !options.exportPath.empty()) {
+            problem = "--universes cannot be combined with --load, --save, --record, --metrics or --export";
+        }
+        if (problem != nullptr) {
+            std::cout << problem << std::endl;
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "CpuForceKernel.h"
+#include "DrawMode.h"
+#include "SimulationParams.h"
+
+// Which implementation advances the particles
+enum class PhysicsBackend {
+    Gpu, // compute shaders (requires OpenGL 4.3)
+    Cpu, // CpuSimulator on a thread pool
+};
+
+// Options chosen on the command line at startup
+struct LaunchOptions {
+    PhysicsBackend backend = PhysicsBackend::Gpu;
+    bool backendGiven = false;
+    size_t threads = 0; // CPU backend worker count, 0 = all cores
+    // CPU force kernel; without --cpu-kernel the widest one this CPU runs
+    Particles::ForceKernelIsa forceKernel = Particles::ForceKernelIsa::Scalar;
+    bool forceKernelGiven = false;
+
+    // Frame profiler: --profile turns it (and its overlay) on at startup;
+    // captured Chrome traces are written to tracePath
+    bool profile = false;
+    std::string tracePath = "trace.json";
+
+    // Window drawing (see DrawMode.h); D cycles through the modes
+    Particles::DrawMode drawMode = Particles::DrawMode::Quads;
+
+    // Fixed-timestep scheduling: every simulation step is deltaTime long.
+    // With substeps == 0 the window runs as many steps as real time calls
+    // for (at most maxSubsteps per frame); substeps > 0 runs exactly that
+    // many per presented frame, regardless of frame rate.
+    float deltaTime = 0.016f;
+    int substeps = 0;
+    int maxSubsteps = 8;
+
+    // Simulation constants: main() fills them from paramsPath when that file
+    // exists, --integrator sets params.integrator and --boundary
+    // params.boundary. The window reloads paramsPath and matrixPath
+    // whenever they change unless watch is off.
+    Particles::SimulationParams params;
+    std::string matrixPath = "attraction_matrix.txt";
+    std::string paramsPath = "simulation_params.txt";
+    bool watch = true;
+
+    // Snapshots: S saves to (and L reloads from) snapshotPath in the window;
+    // loadPath starts either mode from a snapshot instead of fresh particles,
+    // and a headless run also writes its final state to savePath
+    std::string snapshotPath = "snapshot.psnap";
+    std::string loadPath;
+    std::string savePath;
+
+    // Trajectory recording: positions every recordInterval steps are
+    // streamed to recordPath (see Trajectory.h); empty disables it
+    std::string recordPath;
+    uint32_t recordInterval = 1;
+
+    // Structure metrics (see Metrics.h): every metricsInterval steps the
+    // current state is reduced and one row is streamed to metricsPath;
+    // empty disables it. metricsRadius is the neighbour and cluster radius
+    // in pixels, capped at params.maxDist.
+    std::string metricsPath;
+    uint32_t metricsInterval = 10;
+    float metricsRadius = 40.0f;
+
+    // Frame export (see FrameExport.h): frames are rendered offscreen at
+    // exportWidth x exportHeight (0 = the world size headless, the window
+    // size otherwise) and written to exportPath as a PNG sequence or a Y4M
+    // stream; empty disables it. The window exports every exportInterval-th
+    // presented frame, a headless run every exportInterval-th step.
+    std::string exportPath;
+    int exportWidth = 0;
+    int exportHeight = 0;
+    uint32_t exportInterval = 1;
+    uint32_t exportFrameRate = 60;
+    size_t exportThreads = 0; // encoder threads, 0 = all cores
+
+    // Headless batch run: fixed step count, no window, state dumped at the end.
+    // Defaults to the CPU backend unless --backend=gpu is passed explicitly.
+    bool headless = false;
+    int particleCount = 30000;
+    long long steps = 1000;
+    uint32_t seed = 1;
+    float worldWidth = 1920.0f;
+    float worldHeight = 1080.0f;
+    // The window's world is the monitor resolution unless --width or
+    // --height is given; it is then worldWidth x worldHeight, scaled to fit
+    bool worldSizeGiven = false;
+    std::string outputPath = "particles.csv";
+
+    // Batch search (headless, CPU): universes > 0 runs that many independent
+    // worlds of particleCount particles side by side, universe u seeded with
+    // seed + u and given a random attraction matrix drawn from the same
+    // seed, and writes one summary row per universe to outputPath
+    int universes = 0;
+};
+
+// Returns false (after printing usage) on an unknown or malformed option
+bool parseLaunchOptions(int argc, char** argv, LaunchOptions& options);
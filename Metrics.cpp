@@ -0,0 +1,87 @@
+#include "Metrics.h"
+
+namespace Particles {
+
+    SimulationMetrics summarizeMetrics(const MetricsTotals& totals) {
+        const MetricsHeader& header = totals.header;
+        SimulationMetrics metrics;
+        metrics.kineticEnergy = (double)header.kineticEnergy / kMetricsEnergyScale;
+        if (header.withNeighbour > 0) {
+            metrics.mixingIndex = (double)header.mixedNeighbour / (double)header.withNeighbour;
+        }
+
+        metrics.largestCluster = header.largestCluster;
+        metrics.isolated = header.clusterSizes[0];
+        int usedBuckets = 0;
+        for (int b = 0; b < kClusterSizeBuckets; ++b) {
+            if (b > 0) metrics.clusterCount += header.clusterSizes[b];
+            if (header.clusterSizes[b] != 0) usedBuckets = b + 1;
+        }
+        metrics.clusterSizes.assign(header.clusterSizes, header.clusterSizes + usedBuckets);
+
+        const double scale = kMetricsPositionScale;
+        metrics.species.resize(totals.species.size());
+        for (size_t s = 0; s < totals.species.size(); ++s) {
+            const SpeciesTotals& in = totals.species[s];
+            SpeciesMetrics& out = metrics.species[s];
+            out.count = in.count;
+            metrics.particleCount += in.count;
+            if (in.count == 0) continue;
+
+            const double n = (double)in.count;
+            const double meanX = (double)in.sumX / n;
+            const double meanY = (double)in.sumY / n;
+            const double variance = (double)in.sumSquares / n - (meanX * meanX + meanY * meanY);
+            out.centroidX = meanX / scale;
+            out.centroidY = meanY / scale;
+            out.spread = std::sqrt(std::max(variance, 0.0)) / scale;
+        }
+        return metrics;
+    }
+
+    bool MetricsWriter::open(const std::string& path, const MetricsInfo& metricsInfo, std::string& error) {
+        close();
+        out.open(path);
+        if (!out.is_open()) {
+            error = "could not open '" + path + "' for writing";
+            return false;
+        }
+        info = metricsInfo;
+        rowCount = 0;
+
+        out << "step,particles,kinetic_energy,mixing_index,clusters,largest_cluster,isolated,cluster_sizes";
+        for (int s = 0; s < info.numSpecies; ++s) {
+            out << ",s" << s << "_count,s" << s << "_x,s" << s << "_y,s" << s << "_spread";
+        }
+        out << '\n';
+        return true;
+    }
+
+    void MetricsWriter::write(uint64_t step, const MetricsTotals& totals) {
+        if (!out.is_open()) return;
+        const SimulationMetrics metrics = summarizeMetrics(totals);
+        out << step << ',' << metrics.particleCount << ',' << metrics.kineticEnergy << ','
+            << metrics.mixingIndex << ',' << metrics.clusterCount << ',' << metrics.largestCluster << ','
+            << metrics.isolated << ',';
+        const char* separator = "";
+        for (uint32_t count : metrics.clusterSizes) {
+            out << separator << count;
+            separator = " ";
+        }
+        for (int s = 0; s < info.numSpecies; ++s) {
+            const SpeciesMetrics species = s < (int)metrics.species.size() ? metrics.species[s] : SpeciesMetrics {};
+            out << ',' << species.count << ',' << species.centroidX << ',' << species.centroidY << ','
+                << species.spread;
+        }
+        out << '\n';
+        ++rowCount;
+    }
+
+    bool MetricsWriter::close() {
+        if (!out.is_open()) return true;
+        out.flush();
+        const bool ok = static_cast<bool>(out);
+        out.close();
+        return ok;
+    }
+}
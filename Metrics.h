@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Particles {
+
+    // Structure metrics of the current particle state, reduced on whichever
+    // backend runs the physics without reading the particles back:
+    //   - total kinetic energy
+    //   - per species: count, centroid and spread (RMS distance from the centroid)
+    //   - mixing index: of the particles with another one within the radius,
+    //     the fraction whose nearest such neighbour is of a different species
+    //   - clusters: connected components of the "closer than the radius"
+    //     graph, as a size histogram
+    // Both backends search the neighbour grid of the physics step (cells at
+    // least maxDist wide, see gridLayout()), visiting the cells of the 3x3
+    // block around each particle that the radius reaches (reachedRuns()),
+    // so a measurement taken right after a step bins nothing again. The
+    // radius is capped at SimulationParams::maxDist. Each pair is visited
+    // once, from its higher sorted slot, which settles the nearest
+    // neighbour of both ends (see metricsNeighbourKey()) and unites them.
+    //
+    // The sums are taken in fixed point, as 64-bit integers, so they do not
+    // depend on summation order: the CPU and GPU reductions produce
+    // identical totals for identical particles.
+    constexpr float kMetricsPositionScale = 16.0f;  // positions in 1/16 px
+    constexpr float kMetricsPositionLimit = 16777216.0f; // 2^24, larger |x| are clamped
+    constexpr float kMetricsEnergyScale = 65536.0f; // energies in 2^-16 units
+    constexpr float kMetricsEnergyLimit = 281474976710656.0f; // 2^48 after scaling
+    constexpr int kClusterSizeBuckets = 32;
+
+    // Totals of one reduction, laid out as the GPU metrics buffer (std430,
+    // little-endian): the header followed by one SpeciesTotals per species
+    struct MetricsHeader {
+        uint64_t kineticEnergy;  // sum of m |v|^2 / 2, scaled by kMetricsEnergyScale
+        uint32_t withNeighbour;  // particles with another one within the radius
+        uint32_t mixedNeighbour; // ... whose nearest one is of another species
+        uint32_t largestCluster;
+        uint32_t _pad;
+        uint32_t clusterSizes[kClusterSizeBuckets]; // [b]: components of 2^b .. 2^(b+1)-1 particles
+    };
+    static_assert(sizeof(MetricsHeader) == 152, "metrics header layout");
+
+    struct SpeciesTotals {
+        uint32_t count;
+        uint32_t _pad;
+        int64_t sumX;        // fixed-point positions
+        int64_t sumY;
+        uint64_t sumSquares; // x^2 + y^2 of the fixed-point positions
+    };
+    static_assert(sizeof(SpeciesTotals) == 32, "species totals layout");
+
+    struct MetricsTotals {
+        MetricsHeader header {};
+        std::vector<SpeciesTotals> species;
+
+        void clear(int numSpecies) {
+            header = MetricsHeader {};
+            species.assign(numSpecies, SpeciesTotals {});
+        }
+    };
+
+    // Which particles a reduction covers: the ones the last step started
+    // from, over that step's grid, or the current ones, binned into the
+    // same grid first (for a state no step has started from yet)
+    enum class MetricsSource {
+        LastStep,
+        Current,
+    };
+
+    // Nearest-neighbour key of one end of a pair: the bits of the squared
+    // distance (never negative, so they order like the distance) with the
+    // low six replaced by the species at the other end. A particle's
+    // smallest key names its nearest neighbour's species, distances within
+    // 2^-17 of each other counting as a tie that the smaller species id
+    // wins, and an atomic minimum finds it in any visiting order. The
+    // distance is taken as (xj - xi) - offset, which is exactly the negated
+    // difference seen from the other end, so both ends get the same one.
+    constexpr int kMetricsSpeciesBits = 6; // Color::MAX_SPECIES ids
+    constexpr uint32_t kNoNeighbourKey = 0xFFFFFFFFu;
+
+    inline uint32_t metricsNeighbourKey(float d2, int species) {
+        uint32_t bits;
+        std::memcpy(&bits, &d2, sizeof(bits));
+        const uint32_t speciesMask = (1u << kMetricsSpeciesBits) - 1u;
+        return (bits & ~speciesMask) | (uint32_t)species;
+    }
+
+    inline int metricsNeighbourSpecies(uint32_t key) {
+        return (int)(key & ((1u << kMetricsSpeciesBits) - 1u));
+    }
+
+    inline float metricsRadius(float radius, float maxDist) {
+        return std::min(radius, maxDist);
+    }
+
+    // Fixed-point conversions, mirrored operation for operation by the GPU
+    // metrics passes
+    inline int32_t metricsPosition(float x) {
+        const float q = std::floor(x * kMetricsPositionScale + 0.5f);
+        return (int32_t)std::min(std::max(q, -kMetricsPositionLimit), kMetricsPositionLimit);
+    }
+
+    inline uint64_t metricsEnergy(float mass, float vx, float vy) {
+        float e = 0.5f * mass * (vx * vx + vy * vy) * kMetricsEnergyScale;
+        e = std::min(std::max(e, 0.0f), kMetricsEnergyLimit);
+        const uint32_t hi = (uint32_t)(e / 4294967296.0f);
+        const uint32_t lo = (uint32_t)(e - (float)hi * 4294967296.0f);
+        return ((uint64_t)hi << 32) | lo;
+    }
+
+    // Bucket of a component of `size` particles: floor(log2(size))
+    inline int clusterSizeBucket(uint32_t size) {
+        int bucket = 0;
+        while (size >>= 1) ++bucket;
+        return bucket;
+    }
+
+    struct SpeciesMetrics {
+        uint32_t count = 0;
+        double centroidX = 0.0;
+        double centroidY = 0.0;
+        double spread = 0.0;
+    };
+
+    // MetricsTotals in physical units
+    struct SimulationMetrics {
+        uint64_t particleCount = 0;
+        double kineticEnergy = 0.0;
+        double mixingIndex = 0.0;     // 0 when no particle has a neighbour
+        uint32_t clusterCount = 0;    // components of two or more particles
+        uint32_t largestCluster = 0;
+        uint32_t isolated = 0;        // particles without a neighbour
+        std::vector<uint32_t> clusterSizes; // as MetricsHeader, trailing empty buckets dropped
+        std::vector<SpeciesMetrics> species;
+    };
+
+    SimulationMetrics summarizeMetrics(const MetricsTotals& totals);
+
+    // What a metrics file covers; the species columns are fixed when it opens
+    struct MetricsInfo {
+        int numSpecies = 0;
+        uint32_t stepInterval = 1;
+        float radius = 0.0f;
+    };
+
+    // Writes one CSV row per measured step:
+    //   step,particles,kinetic_energy,mixing_index,clusters,largest_cluster,
+    //   isolated,cluster_sizes,s<k>_count,s<k>_x,s<k>_y,s<k>_spread...
+    // cluster_sizes lists the histogram buckets separated by spaces.
+    class MetricsWriter {
+    public:
+        bool open(const std::string& path, const MetricsInfo& info, std::string& error);
+        bool isOpen() const { return out.is_open(); }
+        const MetricsInfo& getInfo() const { return info; }
+
+        // totals must have info.numSpecies species
+        void write(uint64_t step, const MetricsTotals& totals);
+        // Flushes and closes the file; false if any write failed
+        bool close();
+
+        uint64_t rowsWritten() const { return rowCount; }
+
+    private:
+        MetricsInfo info;
+        std::ofstream out;
+        uint64_t rowCount { 0 };
+    };
+}
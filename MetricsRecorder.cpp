@@ -0,0 +1,47 @@
+#include "MetricsRecorder.h"
+
+namespace Particles {
+
+    MetricsRecorder::MetricsRecorder(MetricsWriter& writer, Renderer* renderer, CpuSimulator* cpuSim)
+        : writer(writer), renderer(renderer), cpuSim(cpuSim) {
+    }
+
+    void MetricsRecorder::afterStep(uint64_t step, size_t particleCount) {
+        if (step > 0) measure(step - 1, particleCount, MetricsSource::LastStep);
+    }
+
+    void MetricsRecorder::measureCurrent(uint64_t step, size_t particleCount) {
+        measure(step, particleCount, MetricsSource::Current);
+    }
+
+    void MetricsRecorder::measure(uint64_t step, size_t particleCount, MetricsSource source) {
+        const MetricsInfo& info = writer.getInfo();
+        if (!writer.isOpen() || step % info.stepInterval != 0) return;
+
+        if (cpuSim != nullptr) {
+            cpuSim->computeMetrics(info.radius, totals, source);
+            writer.write(step, totals);
+            return;
+        }
+        if (renderer == nullptr) return;
+
+        // One measurement is in flight at a time
+        if (renderer->metricsPending()) forward(true);
+        renderer->requestMetrics(particleCount, step, info.radius, source);
+    }
+
+    void MetricsRecorder::poll() {
+        if (renderer != nullptr && cpuSim == nullptr) forward(false);
+    }
+
+    void MetricsRecorder::finish() {
+        if (renderer != nullptr && cpuSim == nullptr && renderer->metricsPending()) forward(true);
+    }
+
+    bool MetricsRecorder::forward(bool wait) {
+        uint64_t step = 0;
+        if (!renderer->pollMetrics(totals, step, wait)) return false;
+        writer.write(step, totals);
+        return true;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CpuSimulator.h"
+#include "Metrics.h"
+#include "Renderer.h"
+
+namespace Particles {
+
+    // Feeds a MetricsWriter from either physics backend. A state is measured
+    // right after the step that starts from it, over that step's neighbour
+    // grid, so measuring adds only the reductions. With a simulator they run
+    // on its thread pool right away; otherwise the renderer's metrics passes
+    // run on the GPU and their totals come back through a fence, so the loop
+    // only waits when the next measurement is due before the previous one
+    // has arrived.
+    class MetricsRecorder {
+    public:
+        // cpuSim == nullptr measures on the renderer
+        MetricsRecorder(MetricsWriter& writer, Renderer* renderer, CpuSimulator* cpuSim);
+
+        // Call right after every step, before anything else changes the
+        // particles (deaths included); step numbers the state it produced.
+        // Measures the state the step started from, step - 1, if that one is
+        // due (every stepInterval-th).
+        void afterStep(uint64_t step, size_t particleCount);
+        // Measures the current state, numbered step, if it is due. For the
+        // state a run ends on, which no step starts from; bins it first.
+        void measureCurrent(uint64_t step, size_t particleCount);
+        // Hands a finished readback to the writer without waiting
+        void poll();
+        // Waits for the readback in flight and hands it to the writer
+        void finish();
+
+    private:
+        MetricsWriter& writer;
+        Renderer* renderer;
+        CpuSimulator* cpuSim;
+        MetricsTotals totals;
+
+        void measure(uint64_t step, size_t particleCount, MetricsSource source);
+        bool forward(bool wait);
+    };
+}
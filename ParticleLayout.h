@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "GPUParticle.h"
+
+// Record of the hot stream in the split (structure-of-arrays) GPU layout:
+// everything the force loop reads about a neighbour except its species,
+// which lives in a separate stream of packed bytes. Matches `vec4 hot[]`
+// in the compute shaders.
+struct HotParticle {
+    float px, py;
+    float radius;
+    float mass;
+};
+static_assert(sizeof(HotParticle) == 16, "matches a std430 vec4");
+
+inline HotParticle toHotParticle(const GPUParticle& p) {
+    return HotParticle{ p.px, p.py, p.radius, p.mass };
+}
+
+// Bytes fetched per neighbour visit by the inner force loop
+constexpr size_t kAosBytesPerInteraction = sizeof(GPUParticle);                  // whole 64-byte record
+constexpr size_t kSoaBytesPerInteraction = sizeof(HotParticle) + sizeof(uint8_t); // hot record + species byte
@@ -0,0 +1,989 @@
+// Benchmarks for the simulation code.
+//
+//   ParticleSimBench [--suite=scaling|layout|batch|metrics|kernel|alloc|spawn|search] [options]
+//
+// scaling (default): times the physics step of every available backend over
+// three one-factor-at-a-time sweeps from fixed seeds, and writes one CSV or
+// JSON row per run:
+//   - particle count (--counts, default 1000,10000,100000,1000000)
+//   - species count  (--species, default 2,4,8,16,32; each run gets a k x k
+//     matrix that extends the default one with fixed-seed random weights)
+//   - interaction radius, i.e. SimulationParams::maxDist (--radii, default 50,150,300)
+// The species and radius sweeps run at --base-particles (default 10000). Each
+// run is --warmup untimed steps and then --steps timed ones (default 3 and
+// 20); deaths are not rolled. GPU backends wait for every step to finish,
+// so the per-step latencies include the pipeline drain.
+//
+//   --backends=LIST   cpu, gpu-grid, gpu-tiled, gpu-brute (default: all built)
+//   --threads=N       CPU backend worker count, 0 = all cores
+//   --max-all-pairs=N skip the O(N^2) GPU kernels above N particles (default 65536)
+//   --seed=N          spawn seed (default 1234)
+//   --format=csv|json --out=PATH (default: CSV on stdout; progress goes to stderr)
+//
+// "Interactions" are ordered pairs closer than maxDist, i.e. the pairs that
+// contribute a force. The count per step is estimated from 1024 sampled
+// particles at the start and end of the timed steps, identically for every
+// backend.
+//
+// The gpu-* backends need OpenGL 4.3 and are only built when CMake finds
+// OpenGL, GLFW and glad (PARTICLESIM_HAS_GL). They run on software GL too,
+// e.g. Mesa llvmpipe with LIBGL_ALWAYS_SOFTWARE=1.
+//
+// layout (--particles=N, default 1<<20): all-pairs force loop over the 64-byte
+// GPUParticle records versus the split hot stream + packed species bytes used
+// by the GPU kernels. The neighbour set is far larger than the caches, so the
+// loop is bound by memory bandwidth and the bytes fetched per interaction
+// dominate.
+//
+// batch (--universes=LIST, default 1,2,4,8,16): UniverseBatch throughput in
+// universe-steps per second for each universe count, every universe holding
+// --base-particles particles and its own random matrix. Uses --steps,
+// --warmup, --threads and --seed as above. Throughput should grow with the
+// universe count until every thread is busy.
+//
+// metrics (--metrics-radius=PX, default 40; --metrics-every=N, default 10
+// as in ParticleSim): for every backend, the mean time of a physics step and
+// of one structure-metrics reduction (Metrics.h) on the same
+// --base-particles particles after --warmup steps, the cost of one reduction
+// as a share of a step, and what measuring every N steps adds to each step. Each reduction runs right
+// after a step over that step's grid, as the app does, so this is the whole
+// cost of measuring. Uses --steps, --threads and --seed as above.
+//
+// kernel: CPU steps with every force kernel this CPU runs (scalar, avx2,
+// avx512, neon; see CpuForceKernel.h), each step taken from the same
+// --base-particles particles so every kernel sees identical neighbour
+// lists. Reports ns per particle-step, the speedup over the scalar loop
+// and the largest acceleration difference from the scalar result,
+// relative to the RMS acceleration. Uses --steps, --warmup, --threads
+// (--threads=1 for per-core figures) and --seed as above.
+//
+// alloc: heap allocations per step of the headless loop (physics step,
+// then death/rebirth through a FrameArena) for every backend, and per
+// UniverseBatch step, counted through the replaced operator new in
+// AllocationCounter.cpp over --steps steps after --warmup. Fails (exit
+// code 1) if any steady-state step allocates. Uses --base-particles,
+// --universes (its largest count), --threads and --seed as above.
+//
+// spawn (--particles=N, default 1<<20): resetSimulation() on one thread and
+// on --threads, and Renderer::spawnParticles() when built with OpenGL, each
+// the fastest of --steps runs. Fails (exit code 1) unless every variant
+// produces the same bytes as the single-threaded one. Uses --seed as above.
+//
+// search (--tolerance=PX, default 0.01): steps the same --base-particles
+// particles through gpu-brute, gpu-tiled, gpu-grid and the CPU backend
+// (which bins into the same grid) for --steps steps, and reports each
+// one's largest position difference from gpu-brute after the first step
+// and over the run. Fails (exit code 1) if any difference exceeds the tolerance. Only
+// summation order may differ, but the system is chaotic, so the gap grows
+// with --steps; the default suits the default 20 steps. Needs OpenGL.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "Color.h"
+#include "CpuSimulator.h"
+#include "FrameArena.h"
+#include "Metrics.h"
+#include "ParticleLayout.h"
+#include "ParticleSpawner.h"
+#include "SimulationParams.h"
+#include "UniverseBatch.h"
+
+#ifdef PARTICLESIM_HAS_GL
+#include "GLContext.h"
+#include "Renderer.h"
+#endif
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // Same pairwise law as pairForce() in the compute shaders
+    inline void accumulate(float xi, float yi, float ri, float mi, int si,
+                           float xj, float yj, float rj, float mj, int sj,
+                           const std::vector<float>& attraction, int numSpecies,
+                           const Particles::SimulationParams& params,
+                           float& dVx, float& dVy) {
+        const float dx = xj - xi;
+        const float dy = yj - yi;
+        const float d2 = dx * dx + dy * dy;
+        if (d2 == 0.0f) return;
+        const float dist = std::sqrt(d2);
+        if (dist > params.maxDist) return;
+        const float invd2 = 1.0f / d2;
+        const float k = attraction[sj * numSpecies + si];
+        const float massProd = mi * mj;
+        float f;
+        if (dist > ri + rj + params.repelDist) {
+            f = k * massProd * invd2;
+        } else {
+            f = -((k != 0.0f) ? std::fabs(k) * massProd : massProd) * invd2;
+        }
+        dVx += params.forceScale * f * dx;
+        dVy += params.forceScale * f * dy;
+    }
+
+    struct LayoutResult {
+        double nsPerInteraction;
+        float checksum;
+    };
+
+    // Runs `sources` particles against every particle through fetch(j, ...)
+    template <typename Fetch>
+    LayoutResult runAllPairs(size_t count, size_t sources, const std::vector<GPUParticle>& particles,
+                             const std::vector<float>& attraction, int numSpecies,
+                             const Particles::SimulationParams& params, Fetch fetch) {
+        float checksum = 0.0f;
+        const auto start = Clock::now();
+        for (size_t s = 0; s < sources; ++s) {
+            const GPUParticle& pi = particles[(s * 7919) % count];
+            float dVx = 0.0f, dVy = 0.0f;
+            for (size_t j = 0; j < count; ++j) {
+                float xj, yj, rj, mj;
+                int sj;
+                fetch(j, xj, yj, rj, mj, sj);
+                accumulate(pi.px, pi.py, pi.radius, pi.mass, pi.colorSpecies, xj, yj, rj, mj, sj,
+                           attraction, numSpecies, params, dVx, dVy);
+            }
+            checksum += dVx + dVy;
+        }
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        return LayoutResult{ ns / (double)(count * sources), checksum };
+    }
+
+    void benchLayout(size_t count) {
+        const Particles::SimulationParams params;
+        std::vector<GPUParticle> particles;
+        Particles::resetSimulation(particles, (int)count, 1920.0f, 1080.0f, 1234u);
+
+        const int numSpecies = Color::speciesCount(Color::attractionMatrix);
+        const std::vector<float> attraction(Color::attractionMatrix.data(),
+                                            Color::attractionMatrix.data() + Color::attractionMatrix.size());
+
+        std::vector<HotParticle> hot(count);
+        std::vector<uint8_t> species(count);
+        for (size_t i = 0; i < count; ++i) {
+            hot[i] = toHotParticle(particles[i]);
+            species[i] = (uint8_t)particles[i].colorSpecies;
+        }
+
+        const size_t sources = 32;
+        const LayoutResult aos = runAllPairs(count, sources, particles, attraction, numSpecies, params,
+            [&](size_t j, float& x, float& y, float& r, float& m, int& s) {
+                const GPUParticle& p = particles[j];
+                x = p.px; y = p.py; r = p.radius; m = p.mass; s = p.colorSpecies;
+            });
+        const LayoutResult soa = runAllPairs(count, sources, particles, attraction, numSpecies, params,
+            [&](size_t j, float& x, float& y, float& r, float& m, int& s) {
+                const HotParticle& h = hot[j];
+                x = h.px; y = h.py; r = h.radius; m = h.mass; s = species[j];
+            });
+
+        auto report = [&](const char* name, size_t bytes, const LayoutResult& r) {
+            std::cout << "  " << name << ": " << bytes << " B/interaction, " << r.nsPerInteraction
+                      << " ns/interaction, " << (bytes / r.nsPerInteraction) << " GB/s effective"
+                      << " (checksum " << r.checksum << ")" << std::endl;
+        };
+        std::cout << "layout: " << count << " particles, " << sources << " all-pairs sources" << std::endl;
+        report("AoS GPUParticle       ", kAosBytesPerInteraction, aos);
+        report("SoA hot + species byte", kSoaBytesPerInteraction, soa);
+        std::cout << "  bytes per interaction reduced " << (double)kAosBytesPerInteraction / kSoaBytesPerInteraction
+                  << "x, time per interaction " << aos.nsPerInteraction / soa.nsPerInteraction << "x" << std::endl;
+    }
+
+    // ---- scaling suite ----
+
+    constexpr float kWorldWidth = 1920.0f;
+    constexpr float kWorldHeight = 1080.0f;
+    constexpr float kStepDt = 0.016f;
+
+    struct SweepPoint {
+        const char* sweep;
+        size_t particles;
+        int species;
+        float radius;
+    };
+
+    struct RunResult {
+        std::string backend;
+        size_t threads;
+        SweepPoint point;
+        int steps;
+        double nsPerParticleStep;
+        double interactionsPerStep;
+        double interactionsPerSecond;
+        double meanMs;
+        double p50Ms;
+        double p99Ms;
+    };
+
+    // One physics implementation under test
+    class Backend {
+    public:
+        virtual ~Backend() = default;
+        virtual const char* name() const = 0;
+        virtual size_t threads() const = 0;
+        virtual bool isAllPairs() const { return false; }
+        virtual void reset(const std::vector<GPUParticle>& particles, const Particles::SimulationParams& params,
+                           const Color::AttractionMatrix& matrix) = 0;
+        // Advances one step and returns once it has finished
+        virtual void step(float deltaTime) = 0;
+        virtual void read(std::vector<GPUParticle>& particles) = 0;
+        // Swaps in the replacements of particles that died
+        virtual void replace(const Particles::DeathRoll& deaths) = 0;
+        // Reduces the state the last step started from, over that step's
+        // grid, and returns once the totals are back
+        virtual void measure(float radius, Particles::MetricsTotals& totals) = 0;
+    };
+
+    class CpuBackend : public Backend {
+    public:
+        explicit CpuBackend(size_t threadCount)
+            : threadCount(threadCount),
+              sim(std::make_unique<Particles::CpuSimulator>(kWorldWidth, kWorldHeight, threadCount)) {}
+
+        const char* name() const override { return "cpu"; }
+        size_t threads() const override { return sim->threadCount(); }
+
+        void reset(const std::vector<GPUParticle>& particles, const Particles::SimulationParams& params,
+                   const Color::AttractionMatrix& matrix) override {
+            // The grid dimensions depend on maxDist, so start from a fresh simulator
+            sim = std::make_unique<Particles::CpuSimulator>(kWorldWidth, kWorldHeight, threadCount, params);
+            sim->setAttractionMatrix(matrix);
+            sim->setParticles(particles);
+        }
+        void step(float deltaTime) override { sim->step(deltaTime); }
+        void read(std::vector<GPUParticle>& particles) override { particles = sim->particles(); }
+        void replace(const Particles::DeathRoll& deaths) override {
+            for (size_t i = 0; i < deaths.count; ++i) sim->particles()[deaths.indices[i]] = deaths.births[i];
+        }
+        void measure(float radius, Particles::MetricsTotals& totals) override {
+            sim->computeMetrics(radius, totals, Particles::MetricsSource::LastStep);
+        }
+
+    private:
+        size_t threadCount;
+        std::unique_ptr<Particles::CpuSimulator> sim;
+    };
+
+#ifdef PARTICLESIM_HAS_GL
+    class GpuBackend : public Backend {
+    public:
+        GpuBackend(GLFWwindow* window, Particles::NeighborSearch mode, const char* label)
+            : renderer(window), mode(mode), label(label) {
+            renderer.setNeighborSearch(mode);
+        }
+
+        const char* name() const override { return label; }
+        size_t threads() const override { return 0; }
+        bool isAllPairs() const override { return mode != Particles::NeighborSearch::UniformGrid; }
+
+        void reset(const std::vector<GPUParticle>& particles, const Particles::SimulationParams& params,
+                   const Color::AttractionMatrix& matrix) override {
+            // Relinks the force kernels when the species count changes
+            renderer.setAttractionMatrix(matrix);
+            renderer.setSimulationParams(params);
+            renderer.initializeGPUBuffer(particles);
+            count = particles.size();
+        }
+        void step(float deltaTime) override {
+            renderer.dispatchComputeShader(count, deltaTime);
+            glFinish();
+        }
+        void read(std::vector<GPUParticle>& particles) override {
+            particles.resize(count);
+            renderer.downloadParticles(particles);
+        }
+        void replace(const Particles::DeathRoll& deaths) override {
+            renderer.writeParticles(deaths.indices, deaths.births, deaths.count);
+        }
+        void measure(float radius, Particles::MetricsTotals& totals) override {
+            uint64_t step = 0;
+            renderer.requestMetrics(count, 0, radius, Particles::MetricsSource::LastStep);
+            renderer.pollMetrics(totals, step, true);
+        }
+
+    private:
+        Particles::Renderer renderer;
+        Particles::NeighborSearch mode;
+        const char* label;
+        size_t count { 0 };
+    };
+#endif
+
+    // Pairs closer than maxDist, extrapolated from up to 1024 evenly spaced
+    // particles. Uses a maxDist grid, so only the 3x3 block around each
+    // sample is visited.
+    double estimateInteractions(const std::vector<GPUParticle>& particles, float maxDist) {
+        const size_t count = particles.size();
+        if (count == 0) return 0.0;
+        const int gridW = std::max(1, (int)std::ceil(kWorldWidth / maxDist));
+        const int gridH = std::max(1, (int)std::ceil(kWorldHeight / maxDist));
+        auto cellCoord = [&](float v, int dim) {
+            return std::min(std::max((int)std::floor(v / maxDist), 0), dim - 1);
+        };
+
+        std::vector<uint32_t> cellStart((size_t)gridW * gridH + 1, 0);
+        std::vector<uint32_t> cellOf(count);
+        for (size_t i = 0; i < count; ++i) {
+            cellOf[i] = (uint32_t)(cellCoord(particles[i].py, gridH) * gridW + cellCoord(particles[i].px, gridW));
+            ++cellStart[cellOf[i] + 1];
+        }
+        for (size_t c = 1; c < cellStart.size(); ++c) cellStart[c] += cellStart[c - 1];
+        std::vector<uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+        std::vector<uint32_t> order(count);
+        for (size_t i = 0; i < count; ++i) order[cursor[cellOf[i]]++] = (uint32_t)i;
+
+        const size_t samples = std::min<size_t>(count, 1024);
+        size_t pairs = 0;
+        for (size_t s = 0; s < samples; ++s) {
+            const GPUParticle& pi = particles[s * count / samples];
+            const int cx = cellCoord(pi.px, gridW);
+            const int cy = cellCoord(pi.py, gridH);
+            for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, gridH - 1); ++y) {
+                for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, gridW - 1); ++x) {
+                    const size_t cell = (size_t)y * gridW + x;
+                    for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+                        const GPUParticle& pj = particles[order[k]];
+                        const float dx = pj.px - pi.px;
+                        const float dy = pj.py - pi.py;
+                        const float d2 = dx * dx + dy * dy;
+                        if (d2 != 0.0f && std::sqrt(d2) <= maxDist) ++pairs;
+                    }
+                }
+            }
+        }
+        return (double)pairs * (double)count / (double)samples;
+    }
+
+    // Nearest-rank percentile of an unsorted sample
+    double percentile(std::vector<double> values, double p) {
+        std::sort(values.begin(), values.end());
+        const size_t rank = (size_t)std::ceil(p * values.size());
+        return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    // species x species matrix: the default weights where both species are
+    // among the first eight, fixed-seed multiples of 0.5 in [-5, 5] elsewhere
+    Color::AttractionMatrix benchMatrix(int species) {
+        Color::AttractionMatrix matrix(species);
+        std::mt19937 rng { 42u };
+        std::uniform_int_distribution<int> step(-10, 10);
+        for (int from = 0; from < species; ++from) {
+            for (int to = 0; to < species; ++to) matrix(from, to) = 0.5f * (float)step(rng);
+        }
+        const Color::AttractionMatrix defaults = Color::getDefaultAttractionMatrix();
+        for (int from = 0; from < std::min(species, defaults.species()); ++from) {
+            for (int to = 0; to < std::min(species, defaults.species()); ++to) matrix(from, to) = defaults(from, to);
+        }
+        return matrix;
+    }
+
+    // Fixed-seed initial state drawn from the species of Color::attractionMatrix
+    std::vector<GPUParticle> spawnParticles(size_t count, uint32_t seed) {
+        std::vector<GPUParticle> particles;
+        Particles::resetSimulation(particles, (int)count, kWorldWidth, kWorldHeight, seed);
+        return particles;
+    }
+
+    RunResult runScaling(Backend& backend, const SweepPoint& point, int warmupSteps, int steps, uint32_t seed) {
+        Particles::SimulationParams params;
+        params.maxDist = point.radius;
+
+        Color::attractionMatrix = benchMatrix(point.species);
+        std::vector<GPUParticle> particles = spawnParticles(point.particles, seed);
+        backend.reset(particles, params, Color::attractionMatrix);
+        for (int s = 0; s < warmupSteps; ++s) backend.step(kStepDt);
+
+        backend.read(particles);
+        double interactions = estimateInteractions(particles, params.maxDist);
+
+        std::vector<double> stepMs;
+        stepMs.reserve(steps);
+        for (int s = 0; s < steps; ++s) {
+            const auto start = Clock::now();
+            backend.step(kStepDt);
+            stepMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+
+        backend.read(particles);
+        interactions = 0.5 * (interactions + estimateInteractions(particles, params.maxDist));
+
+        double totalMs = 0.0;
+        for (double ms : stepMs) totalMs += ms;
+
+        RunResult result;
+        result.backend = backend.name();
+        result.threads = backend.threads();
+        result.point = point;
+        result.steps = steps;
+        result.nsPerParticleStep = totalMs * 1e6 / ((double)steps * (double)point.particles);
+        result.interactionsPerStep = interactions;
+        result.interactionsPerSecond = interactions * steps / (totalMs * 1e-3);
+        result.meanMs = totalMs / steps;
+        result.p50Ms = percentile(stepMs, 0.50);
+        result.p99Ms = percentile(stepMs, 0.99);
+        return result;
+    }
+
+    void writeCsv(std::ostream& out, const std::vector<RunResult>& results, uint32_t seed) {
+        out << "backend,threads,sweep,particles,species,radius,steps,seed,"
+               "ns_per_particle_step,interactions_per_step,interactions_per_s,mean_ms,p50_ms,p99_ms\n";
+        for (const RunResult& r : results) {
+            out << r.backend << ',' << r.threads << ',' << r.point.sweep << ',' << r.point.particles << ','
+                << r.point.species << ',' << r.point.radius << ',' << r.steps << ',' << seed << ','
+                << r.nsPerParticleStep << ',' << r.interactionsPerStep << ',' << r.interactionsPerSecond << ','
+                << r.meanMs << ',' << r.p50Ms << ',' << r.p99Ms << '\n';
+        }
+    }
+
+    void writeJson(std::ostream& out, const std::vector<RunResult>& results, uint32_t seed) {
+        out << "{\n  \"benchmark\": \"scaling\",\n  \"seed\": " << seed << ",\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const RunResult& r = results[i];
+            out << (i ? ",\n" : "\n") << "    {\"backend\": \"" << r.backend << "\", \"threads\": " << r.threads
+                << ", \"sweep\": \"" << r.point.sweep << "\", \"particles\": " << r.point.particles
+                << ", \"species\": " << r.point.species << ", \"radius\": " << r.point.radius
+                << ", \"steps\": " << r.steps << ", \"ns_per_particle_step\": " << r.nsPerParticleStep
+                << ", \"interactions_per_step\": " << r.interactionsPerStep
+                << ", \"interactions_per_s\": " << r.interactionsPerSecond << ", \"mean_ms\": " << r.meanMs
+                << ", \"p50_ms\": " << r.p50Ms << ", \"p99_ms\": " << r.p99Ms << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    struct ScalingOptions {
+        std::vector<std::string> backends;
+        std::vector<size_t> counts { 1000, 10000, 100000, 1000000 };
+        std::vector<int> species { 2, 4, 8, 16, 32 };
+        std::vector<float> radii { 50.0f, 150.0f, 300.0f };
+        size_t baseParticles = 10000;
+        int steps = 20;
+        int warmup = 3;
+        size_t threads = 0;
+        size_t maxAllPairs = 65536;
+        uint32_t seed = 1234;
+        bool json = false;
+        std::string outputPath;
+    };
+
+    // The backends named in ScalingOptions::backends; the GPU ones share
+    // one hidden context, torn down with them
+    struct BackendSet {
+        std::vector<std::unique_ptr<Backend>> backends;
+#ifdef PARTICLESIM_HAS_GL
+        GLFWwindow* window = nullptr;
+#endif
+
+        ~BackendSet() { release(); }
+
+        bool create(const ScalingOptions& options) {
+            for (const std::string& name : options.backends) {
+                if (name == "cpu") {
+                    backends.push_back(std::make_unique<CpuBackend>(options.threads));
+                    continue;
+                }
+#ifdef PARTICLESIM_HAS_GL
+                Particles::NeighborSearch mode;
+                const char* label;
+                if (name == "gpu-grid") { mode = Particles::NeighborSearch::UniformGrid; label = "gpu-grid"; }
+                else if (name == "gpu-tiled") { mode = Particles::NeighborSearch::Tiled; label = "gpu-tiled"; }
+                else if (name == "gpu-brute") { mode = Particles::NeighborSearch::BruteForce; label = "gpu-brute"; }
+                else {
+                    std::cerr << "Unknown backend '" << name << "'" << std::endl;
+                    return false;
+                }
+                if (window == nullptr) {
+                    window = createHiddenGLContext((int)kWorldWidth, (int)kWorldHeight, "ParticleSimBench");
+                    if (window == nullptr) return false;
+                }
+                backends.push_back(std::make_unique<GpuBackend>(window, mode, label));
+#else
+                std::cerr << "Unknown backend '" << name << "' (GPU backends need a build with OpenGL)" << std::endl;
+                return false;
+#endif
+            }
+            return true;
+        }
+
+        void release() {
+            backends.clear();
+#ifdef PARTICLESIM_HAS_GL
+            if (window != nullptr) glfwTerminate();
+            window = nullptr;
+#endif
+        }
+    };
+
+    int benchScaling(const ScalingOptions& options) {
+        std::vector<SweepPoint> points;
+        const Particles::SimulationParams defaults;
+        for (size_t n : options.counts) points.push_back({ "particles", n, Color::DEFAULT_SPECIES, defaults.maxDist });
+        for (int k : options.species) points.push_back({ "species", options.baseParticles, k, defaults.maxDist });
+        for (float r : options.radii) points.push_back({ "radius", options.baseParticles, Color::DEFAULT_SPECIES, r });
+
+        BackendSet set;
+        if (!set.create(options)) return -1;
+        std::vector<std::unique_ptr<Backend>>& backends = set.backends;
+
+        std::vector<RunResult> results;
+        for (const auto& backend : backends) {
+            for (const SweepPoint& point : points) {
+                if (backend->isAllPairs() && point.particles > options.maxAllPairs) {
+                    std::cerr << backend->name() << ": skipping " << point.particles
+                              << " particles (above --max-all-pairs)" << std::endl;
+                    continue;
+                }
+                std::cerr << backend->name() << ": " << point.sweep << " sweep, " << point.particles
+                          << " particles, " << point.species << " species, radius " << point.radius << std::endl;
+                results.push_back(runScaling(*backend, point, options.warmup, options.steps, options.seed));
+            }
+        }
+        set.release();
+
+        std::ofstream file;
+        if (!options.outputPath.empty()) {
+            file.open(options.outputPath);
+            if (!file.is_open()) {
+                std::cerr << "Failed to open '" << options.outputPath << "' for writing" << std::endl;
+                return -1;
+            }
+        }
+        std::ostream& out = options.outputPath.empty() ? std::cout : file;
+        if (options.json) {
+            writeJson(out, results, options.seed);
+        } else {
+            writeCsv(out, results, options.seed);
+        }
+        return out ? 0 : -1;
+    }
+
+    // ---- batch suite ----
+
+    void benchBatch(const ScalingOptions& options, const std::vector<size_t>& universeCounts) {
+        const int numSpecies = Color::speciesCount(Color::attractionMatrix);
+        for (size_t universes : universeCounts) {
+            Particles::UniverseBatch batch(kWorldWidth, kWorldHeight, options.threads);
+            std::vector<GPUParticle> particles;
+            for (size_t u = 0; u < universes; ++u) {
+                const uint32_t seed = options.seed + (uint32_t)u;
+                Particles::resetSimulation(particles, (int)options.baseParticles, kWorldWidth, kWorldHeight, seed);
+                batch.add(particles, Color::randomAttractionMatrix(numSpecies, seed), seed + 1);
+            }
+            for (int s = 0; s < options.warmup; ++s) batch.step(kStepDt);
+
+            const auto start = Clock::now();
+            for (int s = 0; s < options.steps; ++s) batch.step(kStepDt);
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            const double universeSteps = (double)options.steps * (double)universes;
+            std::cout << "batch: " << universes << " universes x " << options.baseParticles << " particles, "
+                      << batch.threadCount() << " threads: " << universeSteps / seconds << " universe-steps/s, "
+                      << seconds * 1e9 / (universeSteps * (double)options.baseParticles) << " ns/particle-step"
+                      << std::endl;
+        }
+    }
+
+    // ---- metrics suite ----
+
+    int benchMetrics(const ScalingOptions& options, float radius, uint32_t interval) {
+        BackendSet set;
+        if (!set.create(options)) return -1;
+
+        const std::vector<GPUParticle> initial = spawnParticles(options.baseParticles, options.seed);
+        Particles::MetricsTotals totals;
+        for (const auto& backend : set.backends) {
+            backend->reset(initial, Particles::SimulationParams {}, Color::attractionMatrix);
+            for (int s = 0; s < options.warmup; ++s) backend->step(kStepDt);
+
+            double stepMs = 0.0;
+            double metricsMs = 0.0;
+            for (int s = 0; s < options.steps; ++s) {
+                auto start = Clock::now();
+                backend->step(kStepDt);
+                stepMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                start = Clock::now();
+                backend->measure(radius, totals);
+                metricsMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            }
+            stepMs /= options.steps;
+            metricsMs /= options.steps;
+
+            const Particles::SimulationMetrics metrics = Particles::summarizeMetrics(totals);
+            std::cout << "metrics: " << backend->name() << ", " << options.baseParticles << " particles, radius "
+                      << radius << ": step " << stepMs << " ms, one reduction " << metricsMs << " ms ("
+                      << 100.0 * metricsMs / stepMs << "% of a step; every " << interval << " steps adds "
+                      << 100.0 * metricsMs / (stepMs * interval) << "% per step); " << metrics.clusterCount
+                      << " clusters, mixing index " << metrics.mixingIndex << std::endl;
+        }
+        return 0;
+    }
+
+    // ---- kernel suite ----
+
+    int benchKernels(const ScalingOptions& options) {
+        const std::vector<GPUParticle> initial = spawnParticles(options.baseParticles, options.seed);
+        std::vector<GPUParticle> reference;
+        double scalarNs = 0.0;
+        for (Particles::ForceKernelIsa isa : { Particles::ForceKernelIsa::Scalar, Particles::ForceKernelIsa::Avx2,
+                                               Particles::ForceKernelIsa::Avx512, Particles::ForceKernelIsa::Neon }) {
+            if (!Particles::forceKernelAvailable(isa)) {
+                std::cout << "kernel: " << Particles::forceKernelName(isa) << " not available" << std::endl;
+                continue;
+            }
+            Particles::CpuSimulator sim(kWorldWidth, kWorldHeight, options.threads);
+            sim.setForceKernel(isa);
+            double ns = 0.0;
+            for (int s = 0; s < options.warmup + options.steps; ++s) {
+                sim.setParticles(initial);
+                const auto start = Clock::now();
+                sim.step(kStepDt);
+                if (s >= options.warmup) ns += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            }
+            ns /= (double)options.steps * (double)initial.size();
+
+            const std::vector<GPUParticle>& result = sim.particles();
+            if (isa == Particles::ForceKernelIsa::Scalar) {
+                reference = result;
+                scalarNs = ns;
+            }
+            double sumSquares = 0.0;
+            double maxError = 0.0;
+            for (size_t i = 0; i < result.size(); ++i) {
+                sumSquares += (double)reference[i].ax * reference[i].ax + (double)reference[i].ay * reference[i].ay;
+                maxError = std::max(maxError, (double)std::hypot(result[i].ax - reference[i].ax,
+                                                                 result[i].ay - reference[i].ay));
+            }
+            const double rms = std::sqrt(sumSquares / std::max<size_t>(1, result.size()));
+
+            std::cout << "kernel: " << Particles::forceKernelName(isa) << ", " << initial.size() << " particles, "
+                      << sim.threadCount() << " threads: " << ns << " ns/particle-step, " << scalarNs / ns
+                      << "x scalar, max acceleration difference " << (rms > 0.0 ? maxError / rms : 0.0)
+                      << " of RMS" << std::endl;
+        }
+        return 0;
+    }
+
+    // ---- alloc suite ----
+
+    int benchAllocations(const ScalingOptions& options, size_t universes) {
+        BackendSet set;
+        if (!set.create(options)) return -1;
+
+        bool steady = true;
+        auto report = [&](const std::string& name, uint64_t allocations) {
+            const double perStep = (double)allocations / options.steps;
+            std::cout << "alloc: " << name << ": " << allocations << " heap allocations in " << options.steps
+                      << " steps (" << perStep << " per step)" << std::endl;
+            steady = steady && allocations == 0;
+        };
+
+        const std::vector<GPUParticle> initial = spawnParticles(options.baseParticles, options.seed);
+        for (const auto& backend : set.backends) {
+            backend->reset(initial, Particles::SimulationParams {}, Color::attractionMatrix);
+            std::mt19937 rng(options.seed + 1);
+            Particles::FrameArena arena;
+            auto step = [&]() {
+                backend->step(kStepDt);
+                arena.reset();
+                backend->replace(Particles::rollDeaths(rng, initial.size(), kWorldWidth, kWorldHeight, arena));
+            };
+            for (int s = 0; s < options.warmup; ++s) step();
+            const uint64_t before = Particles::heapAllocationCount();
+            for (int s = 0; s < options.steps; ++s) step();
+            report(backend->name(), Particles::heapAllocationCount() - before);
+        }
+
+        const int numSpecies = Color::speciesCount(Color::attractionMatrix);
+        Particles::UniverseBatch batch(kWorldWidth, kWorldHeight, options.threads);
+        std::vector<GPUParticle> particles;
+        for (size_t u = 0; u < universes; ++u) {
+            const uint32_t seed = options.seed + (uint32_t)u;
+            Particles::resetSimulation(particles, (int)options.baseParticles, kWorldWidth, kWorldHeight, seed);
+            batch.add(particles, Color::randomAttractionMatrix(numSpecies, seed), seed + 1);
+        }
+        for (int s = 0; s < options.warmup; ++s) batch.step(kStepDt);
+        const uint64_t before = Particles::heapAllocationCount();
+        for (int s = 0; s < options.steps; ++s) batch.step(kStepDt);
+        report("batch of " + std::to_string(universes) + " universes", Particles::heapAllocationCount() - before);
+
+        if (!steady) {
+            std::cout << "alloc: FAILED, steady-state steps allocate" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // ---- spawn suite ----
+
+    int benchSpawn(const ScalingOptions& options, size_t count) {
+        std::vector<GPUParticle> reference;
+        std::vector<GPUParticle> particles;
+        bool identical = true;
+        auto report = [&](const std::string& name, double ms, const std::vector<GPUParticle>& result) {
+            const bool same = result.size() == reference.size()
+                && std::memcmp(result.data(), reference.data(), reference.size() * sizeof(GPUParticle)) == 0;
+            std::cout << "spawn: " << name << ": " << count << " particles in " << ms << " ms ("
+                      << (same ? "identical" : "DIFFERENT") << ")" << std::endl;
+            identical = identical && same;
+        };
+        // Fastest of options.steps runs of fn, in milliseconds
+        auto time = [&](auto&& fn) {
+            double best = 0.0;
+            for (int run = 0; run < options.steps; ++run) {
+                const auto start = Clock::now();
+                fn();
+                const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                best = (run == 0) ? ms : std::min(best, ms);
+            }
+            return best;
+        };
+
+        {
+            Particles::ThreadPool single(1);
+            const double ms = time([&]() {
+                Particles::resetSimulation(reference, (int)count, kWorldWidth, kWorldHeight, options.seed, single);
+            });
+            report("cpu, 1 thread", ms, reference);
+        }
+        // Only when --threads gives more than the single-threaded run above
+        Particles::ThreadPool pool(options.threads);
+        if (pool.size() > 1) {
+            const double ms = time([&]() {
+                Particles::resetSimulation(particles, (int)count, kWorldWidth, kWorldHeight, options.seed, pool);
+            });
+            report("cpu, " + std::to_string(pool.size()) + " threads", ms, particles);
+        }
+
+#ifdef PARTICLESIM_HAS_GL
+        GLFWwindow* window = createHiddenGLContext((int)kWorldWidth, (int)kWorldHeight, "ParticleSimBench");
+        if (window == nullptr) return -1;
+        {
+            Particles::Renderer renderer(window);
+            renderer.setAttractionMatrix(Color::attractionMatrix);
+            const double ms = time([&]() {
+                renderer.spawnParticles(count, kWorldWidth, kWorldHeight, options.seed);
+                glFinish();
+            });
+            particles.assign(count, GPUParticle {});
+            renderer.downloadParticles(particles);
+            report("gpu", ms, particles);
+        }
+        glfwTerminate();
+#endif
+
+        if (!identical) {
+            std::cout << "spawn: FAILED, spawned particles differ" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // ---- search suite ----
+
+#ifdef PARTICLESIM_HAS_GL
+    // Largest distance between matching particles of a and b
+    double maxPositionDifference(const std::vector<GPUParticle>& a, const std::vector<GPUParticle>& b) {
+        double worst = 0.0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            worst = std::max(worst, (double)std::hypot(a[i].px - b[i].px, a[i].py - b[i].py));
+        }
+        return worst;
+    }
+#endif
+
+    int benchSearch(const ScalingOptions& options, float tolerance) {
+#ifdef PARTICLESIM_HAS_GL
+        // gpu-brute visits every pair and is the reference; the others must
+        // find the same neighbours, so they may only differ by summation order
+        ScalingOptions searchOptions = options;
+        searchOptions.backends = { "gpu-brute", "gpu-tiled", "gpu-grid", "cpu" };
+        BackendSet set;
+        if (!set.create(searchOptions)) return -1;
+
+        const std::vector<GPUParticle> initial = spawnParticles(options.baseParticles, options.seed);
+        std::vector<std::vector<GPUParticle>> reference(options.steps);
+        std::vector<GPUParticle> particles;
+        bool agree = true;
+        for (const auto& backend : set.backends) {
+            const bool isReference = backend.get() == set.backends.front().get();
+            backend->reset(initial, Particles::SimulationParams {}, Color::attractionMatrix);
+            double worst = 0.0;
+            double first = 0.0;
+            for (int s = 0; s < options.steps; ++s) {
+                backend->step(kStepDt);
+                backend->read(particles);
+                if (isReference) {
+                    reference[s] = particles;
+                    continue;
+                }
+                const double difference = maxPositionDifference(particles, reference[s]);
+                if (s == 0) first = difference;
+                worst = std::max(worst, difference);
+            }
+            if (isReference) {
+                std::cout << "search: " << backend->name() << ": reference, " << initial.size() << " particles, "
+                          << options.steps << " steps" << std::endl;
+                continue;
+            }
+            const bool within = worst <= tolerance;
+            std::cout << "search: " << backend->name() << ": max position difference " << first
+                      << " px after 1 step, " << worst << " px over " << options.steps << " steps ("
+                      << (within ? "within" : "ABOVE") << " " << tolerance << " px)" << std::endl;
+            agree = agree && within;
+        }
+
+        if (!agree) {
+            std::cout << "search: FAILED, neighbour searches disagree with brute force" << std::endl;
+            return 1;
+        }
+        return 0;
+#else
+        (void)options;
+        (void)tolerance;
+        std::cerr << "search: the neighbour search modes are GPU kernels; build with OpenGL" << std::endl;
+        return -1;
+#endif
+    }
+
+    // Comma-separated list; false if any element fails to parse. Unsigned
+    // types reject a sign, which the stream would otherwise wrap around
+    template <typename T>
+    bool parseList(const std::string& text, std::vector<T>& values) {
+        values.clear();
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            if (std::is_unsigned<T>::value && item.find('-') != std::string::npos) return false;
+            std::istringstream parser(item);
+            T value;
+            if (!(parser >> value) || !parser.eof()) return false;
+            values.push_back(value);
+        }
+        return !values.empty();
+    }
+}
+
+int main(int argc, char** argv) {
+    auto usage = []() {
+        std::cout << "Usage: ParticleSimBench [--suite=scaling|layout|batch|metrics|kernel|alloc|spawn|search]\n"
+                     "                        [--particles=N] [--universes=LIST] [--metrics-radius=PX]\n"
+                     "                        [--metrics-every=N] [--tolerance=PX]\n"
+                     "  scaling: [--backends=LIST] [--counts=LIST] [--species=LIST] [--radii=LIST]\n"
+                     "           [--base-particles=N] [--steps=N] [--warmup=N] [--threads=N]\n"
+                     "           [--max-all-pairs=N] [--seed=N] [--format=csv|json] [--out=PATH]" << std::endl;
+        return -1;
+    };
+
+    std::string suite = "scaling";
+    size_t particleCount = 1 << 20;
+    ScalingOptions scaling;
+    std::vector<size_t> universeCounts { 1, 2, 4, 8, 16 };
+    float metricsRadius = 40.0f;
+    uint32_t metricsInterval = 10;
+    float tolerance = 0.01f;
+    scaling.backends = { "cpu" };
+#ifdef PARTICLESIM_HAS_GL
+    scaling.backends.insert(scaling.backends.end(), { "gpu-grid", "gpu-tiled", "gpu-brute" });
+#endif
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const std::string value = (eq == std::string::npos) ? std::string() : arg.substr(eq + 1);
+        std::vector<size_t> number;
+        bool ok = true;
+        if (key == "--suite" && (value == "scaling" || value == "layout" || value == "batch" || value == "metrics" ||
+                                  value == "kernel" || value == "alloc" || value == "spawn" || value == "search")) {
+            suite = value;
+        } else if (key == "--particles") {
+            ok = parseList(value, number) && number.size() == 1;
+            if (ok) particleCount = number[0];
+        } else if (key == "--universes") {
+            ok = parseList(value, universeCounts);
+            for (size_t m : universeCounts) ok = ok && m > 0;
+        } else if (key == "--metrics-radius") {
+            std::vector<float> radius;
+            ok = parseList(value, radius) && radius.size() == 1 && radius[0] > 0.0f;
+            if (ok) metricsRadius = radius[0];
+        } else if (key == "--metrics-every") {
+            ok = parseList(value, number) && number.size() == 1 && number[0] > 0;
+            if (ok) metricsInterval = (uint32_t)number[0];
+        } else if (key == "--tolerance") {
+            std::vector<float> pixels;
+            ok = parseList(value, pixels) && pixels.size() == 1 && pixels[0] >= 0.0f;
+            if (ok) tolerance = pixels[0];
+        } else if (key == "--backends") {
+            ok = parseList(value, scaling.backends);
+        } else if (key == "--counts") {
+            ok = parseList(value, scaling.counts);
+            for (size_t n : scaling.counts) ok = ok && n > 0;
+        } else if (key == "--species") {
+            ok = parseList(value, scaling.species);
+            for (int k : scaling.species) ok = ok && k >= Color::MIN_SPECIES && k <= Color::MAX_SPECIES;
+        } else if (key == "--radii") {
+            ok = parseList(value, scaling.radii);
+            for (float r : scaling.radii) ok = ok && r > 0.0f;
+        } else if (key == "--base-particles" || key == "--steps" || key == "--warmup" || key == "--threads" ||
+                   key == "--max-all-pairs" || key == "--seed") {
+            ok = parseList(value, number) && number.size() == 1;
+            if (ok) {
+                if (key == "--base-particles") scaling.baseParticles = number[0];
+                else if (key == "--steps") { scaling.steps = (int)number[0]; ok = scaling.steps > 0; }
+                else if (key == "--warmup") scaling.warmup = (int)number[0];
+                else if (key == "--threads") scaling.threads = number[0];
+                else if (key == "--max-all-pairs") scaling.maxAllPairs = number[0];
+                else scaling.seed = (uint32_t)number[0];
+            }
+        } else if (key == "--format" && (value == "csv" || value == "json")) {
+            scaling.json = (value == "json");
+        } else if (key == "--out" && !value.empty()) {
+            scaling.outputPath = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cout << "Bad option '" << arg << "'" << std::endl;
+            return usage();
+        }
+    }
+
+    Color::attractionMatrix = Color::getDefaultAttractionMatrix();
+    if (suite == "layout") {
+        benchLayout(particleCount);
+        return 0;
+    }
+    if (suite == "batch") {
+        benchBatch(scaling, universeCounts);
+        return 0;
+    }
+    if (suite == "metrics") {
+        return benchMetrics(scaling, metricsRadius, metricsInterval);
+    }
+    if (suite == "kernel") {
+        return benchKernels(scaling);
+    }
+    if (suite == "alloc") {
+        return benchAllocations(scaling, *std::max_element(universeCounts.begin(), universeCounts.end()));
+    }
+    if (suite == "spawn") {
+        return benchSpawn(scaling, particleCount);
+    }
+    if (suite == "search") {
+        return benchSearch(scaling, tolerance);
+    }
+    return benchScaling(scaling);
+}
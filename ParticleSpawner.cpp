@@ -0,0 +1,132 @@
+#include "ParticleSpawner.h"
+
+#include <cmath>
+#include <new>
+
+namespace Particles {
+
+    namespace {
+
+        constexpr SpeciesTable makeSpeciesTable(int numSpecies) {
+            SpeciesTable table;
+            table.count = numSpecies;
+            for (int s = 0; s < numSpecies; ++s) {
+                table.traits[s] = SpeciesTraits{ Color::speciesColor(s, numSpecies), SPAWN_RADIUS,
+                                                 calculateMass(SPAWN_RADIUS) };
+            }
+            return table;
+        }
+
+        constexpr std::array<SpeciesTable, Color::MAX_SPECIES + 1> makeSpeciesTables() {
+            std::array<SpeciesTable, Color::MAX_SPECIES + 1> tables {};
+            for (int count = Color::MIN_SPECIES; count <= Color::MAX_SPECIES; ++count) {
+                tables[count] = makeSpeciesTable(count);
+            }
+            return tables;
+        }
+
+        constexpr std::array<SpeciesTable, Color::MAX_SPECIES + 1> speciesTables = makeSpeciesTables();
+        static_assert(speciesTables[Color::DEFAULT_SPECIES].traits[Color::PURPLE].color == Color::Color{ 0.5f, 0.0f, 1.0f },
+                      "small species counts use the classic palette");
+    }
+
+    const SpeciesTable& speciesTable(int numSpecies) {
+        return speciesTables[numSpecies];
+    }
+
+    float generateRandomRadius(std::mt19937& rng, float maxRadius) {
+        // Probability is inversely proportional to radius
+        
+        // Create a piecewise linear distribution
+        // Probability density: f(r) = k/r where k is normalization constant
+        // Over [1,3]: integral of k/r dr = k * ln(3) = 1, so k = 1/ln(3)
+        
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        float u = uniform(rng);
+        
+        // Inverse CDF: F^(-1)(u) = exp(u * ln(3))
+        // This gives us the desired inverse probability distribution
+        return std::exp(u * std::log(maxRadius));
+    }
+
+    void resetSimulation(
+        std::vector<GPUParticle>& particles,
+        int numPoints,
+        float worldWidth,
+        float worldHeight,
+        uint32_t seed,
+        ThreadPool& pool
+    ) {
+        const SpeciesTable& table = speciesTable(Color::speciesCount(Color::attractionMatrix));
+
+        particles.resize(numPoints);
+        GPUParticle* out = particles.data();
+        pool.parallelFor(particles.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                out[i] = spawnRandomParticle(seed, RESET_GENERATION, i, worldWidth, worldHeight, table);
+            }
+        }, 16 * 1024);
+    }
+
+    void resetSimulation(
+        std::vector<GPUParticle>& particles,
+        int numPoints,
+        float worldWidth,
+        float worldHeight,
+        uint32_t seed
+    ) {
+        // Below this a pool costs more to start than it saves
+        constexpr int PARALLEL_SPAWN_MIN = 256 * 1024;
+        ThreadPool pool(numPoints >= PARALLEL_SPAWN_MIN ? 0 : 1);
+        resetSimulation(particles, numPoints, worldWidth, worldHeight, seed, pool);
+    }
+
+    void assignSpecies(std::vector<GPUParticle>& particles, int numSpecies) {
+        const SpeciesTable& table = speciesTable(numSpecies);
+        for (GPUParticle& p : particles) {
+            p.colorSpecies %= numSpecies;
+            const Color::Color& color = table.traits[p.colorSpecies].color;
+            p.r = color.r;
+            p.g = color.g;
+            p.b = color.b;
+        }
+    }
+
+    DeathRoll rollDeaths(
+        std::mt19937& rng,
+        size_t particleCount,
+        float worldWidth,
+        float worldHeight,
+        FrameArena& arena
+    ) {
+        // Room for the expected count plus eight standard deviations, so the
+        // list practically never grows (and leaves a copy behind in the arena)
+        const double expected = (double)particleCount * DEATH_PROBABILITY;
+        ArenaVector<size_t> deadIndices{ ArenaAllocator<size_t>(arena) };
+        deadIndices.reserve((size_t)(expected + 8.0 * std::sqrt(expected)) + 16);
+
+        // Every particle dies independently with DEATH_PROBABILITY, so the gap
+        // to the next death is geometric; drawing the gaps directly costs one
+        // draw per death instead of one per particle.
+        std::geometric_distribution<size_t> gapDist(DEATH_PROBABILITY);
+        for (size_t i = gapDist(rng); i < particleCount; i += 1 + gapDist(rng)) {
+            deadIndices.push_back(i);
+        }
+
+        DeathRoll roll;
+        if (deadIndices.empty()) return roll;
+        // The births are keyed by the slot they fill, under a seed taken
+        // from rng so that snapshots, which store rng, still reproduce them
+        const uint32_t waveSeed = (uint32_t)rng();
+        const SpeciesTable& table = speciesTable(Color::speciesCount(Color::attractionMatrix));
+        GPUParticle* births = arena.allocateArray<GPUParticle>(deadIndices.size());
+        for (size_t i = 0; i < deadIndices.size(); ++i) {
+            new (&births[i]) GPUParticle(spawnRandomParticle(waveSeed, RESPAWN_GENERATION, deadIndices[i],
+                                                             worldWidth, worldHeight, table));
+        }
+        roll.indices = deadIndices.data();
+        roll.births = births;
+        roll.count = deadIndices.size();
+        return roll;
+    }
+}
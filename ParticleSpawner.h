@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "Color.h"
+#include "CounterRng.h"
+#include "FrameArena.h"
+#include "GPUParticle.h"
+#include "ThreadPool.h"
+
+namespace Particles {
+
+    constexpr float DEATH_PROBABILITY = 0.0001f;
+
+    float generateRandomRadius(std::mt19937& rng, float maxRadius);
+
+    constexpr float calculateMass(float radius) {
+        // For simplicity, we'll use just r³ as the mass (ignoring constants)
+        return radius * radius * radius;
+    }
+
+    // Radius every particle is spawned with
+    constexpr float SPAWN_RADIUS = 1.0f;
+
+    // What a newly spawned particle of one species looks like
+    struct SpeciesTraits {
+        Color::Color color;
+        float radius;
+        float mass;
+    };
+
+    // Traits of the first count species, indexed by species, so spawning
+    // is a table load rather than a colour computation per particle. The
+    // tables for every species count are built at compile time.
+    struct SpeciesTable {
+        int count { 0 };
+        std::array<SpeciesTraits, Color::MAX_SPECIES> traits {};
+    };
+
+    // Table for numSpecies (MIN_SPECIES..MAX_SPECIES) species
+    const SpeciesTable& speciesTable(int numSpecies);
+
+    // Particle of the given species at rest at (x, y)
+    constexpr GPUParticle spawnParticle(const SpeciesTable& table, int species, float x, float y) {
+        const SpeciesTraits& traits = table.traits[species];
+        return GPUParticle{
+            x, y,                                                    // px, py
+            0.0f, 0.0f,                                              // vx, vy
+            traits.radius, traits.mass,                              // radius, mass
+            0.0f, 0.0f,                                              // ax, ay
+            traits.color.r, traits.color.g, traits.color.b, 1.0f,    // r, g, b, a
+            species,                                                 // species
+            0.0f,                                                    // _pad1
+            {0.0f, 0.0f}                                             // _pad2
+        };
+    }
+
+    // Spawn waves drawn from one seed: a reset is generation 0 of its seed,
+    // the births of rollDeaths() are generation 1 of a seed drawn per step
+    constexpr uint32_t RESET_GENERATION = 0;
+    constexpr uint32_t RESPAWN_GENERATION = 1;
+
+    // Particle index of the spawn wave (seed, generation): at rest somewhere
+    // in [0, worldWidth) x [0, worldHeight), of one of the table's species.
+    // One Philox block per particle (species, x, y), so the result depends on
+    // nothing but the arguments. Renderer::spawnParticles() computes the same
+    // bits on the GPU.
+    inline GPUParticle spawnRandomParticle(uint32_t seed, uint32_t generation, uint64_t index,
+                                           float worldWidth, float worldHeight, const SpeciesTable& table) {
+        const PhiloxCounter bits = philox4x32({ (uint32_t)index, (uint32_t)(index >> 32), 0u, 0u },
+                                              { seed, generation });
+        const int species = (int)boundedUint(bits[0], (uint32_t)table.count);
+        return spawnParticle(table, species, unitFloat(bits[1]) * worldWidth, unitFloat(bits[2]) * worldHeight);
+    }
+
+    // Replaces the contents of particles with numPoints fresh ones, particle
+    // i being spawnRandomParticle(seed, RESET_GENERATION, i, ...). Here and in
+    // rollDeaths() the species are those of Color::attractionMatrix. Runs on
+    // pool; the result is the same for every thread count.
+    void resetSimulation(
+        std::vector<GPUParticle>& particles,
+        int numPoints,
+        float worldWidth,
+        float worldHeight,
+        uint32_t seed,
+        ThreadPool& pool
+    );
+
+    // As above on a pool of all cores for large counts, inline for small ones
+    void resetSimulation(
+        std::vector<GPUParticle>& particles,
+        int numPoints,
+        float worldWidth,
+        float worldHeight,
+        uint32_t seed
+    );
+
+    // Moves particles whose species is not below numSpecies onto one that
+    // is (species % numSpecies) and recolours every particle for that many
+    // species. Everything else about the particles is left as it is.
+    void assignSpecies(std::vector<GPUParticle>& particles, int numSpecies);
+
+    // The particles that die in one step and their replacements, in the
+    // same order. Both arrays live in the arena given to rollDeaths() and
+    // are valid until its next reset().
+    struct DeathRoll {
+        const size_t* indices { nullptr };
+        const GPUParticle* births { nullptr };
+        size_t count { 0 };
+
+        bool empty() const { return count == 0; }
+    };
+
+    // Decides which of particleCount particles die this step. Costs
+    // O(deaths), not O(particleCount), and takes its memory from arena.
+    DeathRoll rollDeaths(
+        std::mt19937& rng,
+        size_t particleCount,
+        float worldWidth,
+        float worldHeight,
+        FrameArena& arena
+    );
+}
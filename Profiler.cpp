@@ -0,0 +1,282 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace Particles {
+
+    namespace {
+
+        const char* kOverlayVertex = R"(
+            #version 430 core
+            layout(location = 0) in vec2 aPos;   // pixels, origin top-left
+            layout(location = 1) in vec4 aColor;
+            uniform vec2 uFramebufferSize;
+            out vec4 vColor;
+            void main() {
+                vec2 ndc = aPos / uFramebufferSize * 2.0 - 1.0;
+                gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+                vColor = aColor;
+            }
+        )";
+
+        const char* kOverlayFragment = R"(
+            #version 430 core
+            in vec4 vColor;
+            out vec4 FragColor;
+            void main() { FragColor = vColor; }
+        )";
+
+        constexpr double kSmoothing = 0.1;     // weight of the newest frame in the averages
+        constexpr float kOverlayFullMs = 20.0f;
+        constexpr float kOverlayWidth = 400.0f;
+        constexpr float kOverlayRow = 14.0f;
+        constexpr float kOverlayMargin = 10.0f;
+        constexpr float kOverlayIndent = 12.0f;
+
+        const float kPalette[][3] = {
+            { 0.95f, 0.35f, 0.30f }, { 0.30f, 0.80f, 0.40f }, { 0.30f, 0.55f, 0.95f },
+            { 0.95f, 0.80f, 0.25f }, { 0.30f, 0.85f, 0.85f }, { 0.85f, 0.40f, 0.90f },
+            { 0.95f, 0.60f, 0.25f }, { 0.70f, 0.70f, 0.70f },
+        };
+
+        GLuint compileOverlayShader(GLenum type, const char* source) {
+            GLuint shader = glCreateShader(type);
+            glShaderSource(shader, 1, &source, nullptr);
+            glCompileShader(shader);
+            GLint ok = GL_FALSE;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+            if (!ok) {
+                char log[1024];
+                glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+                std::fprintf(stderr, "Profiler overlay shader error: %s\n", log);
+            }
+            return shader;
+        }
+
+        void pushQuad(std::vector<float>& vertices, float x0, float y0, float x1, float y1,
+                      float r, float g, float b, float a) {
+            const float corners[6][2] = { { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y0 }, { x1, y1 }, { x0, y1 } };
+            for (const auto& c : corners) {
+                vertices.insert(vertices.end(), { c[0], c[1], r, g, b, a });
+            }
+        }
+    }
+
+    Profiler::~Profiler() {
+        if (queriesCreated) glDeleteQueries(kFramesInFlight * kMaxScopesPerFrame * 2, queries);
+        if (overlayProgram) glDeleteProgram(overlayProgram);
+        if (overlayVao) glDeleteVertexArrays(1, &overlayVao);
+        if (overlayVbo) glDeleteBuffers(1, &overlayVbo);
+    }
+
+    void Profiler::setEnabled(bool enable) {
+        if (enable == enabled) return;
+        enabled = enable;
+        inFrame = false;
+        depth = 0;
+        for (FrameRecord& frame : frames) frame.pending = false;
+        if (enabled) {
+            stats.clear();
+            calibrate();
+        } else {
+            tracing = false;
+        }
+    }
+
+    void Profiler::calibrate() {
+        glGetInteger64v(GL_TIMESTAMP, &gpuCalibration);
+        cpuCalibration = Clock::now();
+    }
+
+    GLuint Profiler::queryFor(int frameSlot, int scope, int end) const {
+        return queries[(frameSlot * kMaxScopesPerFrame + scope) * 2 + end];
+    }
+
+    void Profiler::beginFrame() {
+        if (!enabled) return;
+        if (!queriesCreated) {
+            glGenQueries(kFramesInFlight * kMaxScopesPerFrame * 2, queries);
+            queriesCreated = true;
+        }
+
+        const int slot = (int)(frameIndex % kFramesInFlight);
+        resolve(slot);
+        frames[slot].scopes.clear();
+        inFrame = true;
+        depth = 0;
+        beginScope("frame");
+    }
+
+    void Profiler::endFrame() {
+        if (!enabled || !inFrame) return;
+        endScope(0);
+        const int slot = (int)(frameIndex % kFramesInFlight);
+        frames[slot].pending = true;
+        inFrame = false;
+        ++frameIndex;
+    }
+
+    int Profiler::beginScope(const char* name) {
+        if (!inFrame) return -1;
+        FrameRecord& frame = frames[frameIndex % kFramesInFlight];
+        const int scope = (int)frame.scopes.size();
+        if (scope >= kMaxScopesPerFrame) return -1;
+
+        frame.scopes.push_back(ScopeRecord{ name, depth++, Clock::now(), Clock::time_point{} });
+        glQueryCounter(queryFor((int)(frameIndex % kFramesInFlight), scope, 0), GL_TIMESTAMP);
+        return scope;
+    }
+
+    void Profiler::endScope(int scope) {
+        if (!inFrame || scope < 0) return;
+        const int slot = (int)(frameIndex % kFramesInFlight);
+        glQueryCounter(queryFor(slot, scope, 1), GL_TIMESTAMP);
+        frames[slot].scopes[scope].cpuEnd = Clock::now();
+        --depth;
+    }
+
+    void Profiler::resolve(int frameSlot) {
+        FrameRecord& frame = frames[frameSlot];
+        if (!frame.pending) return;
+        frame.pending = false;
+
+        // The frame scope's end query is the last one issued for this frame
+        GLint available = 0;
+        glGetQueryObjectiv(queryFor(frameSlot, 0, 1), GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return;
+
+        for (size_t s = 0; s < frame.scopes.size(); ++s) {
+            const ScopeRecord& scope = frame.scopes[s];
+            GLuint64 gpuBegin = 0, gpuEnd = 0;
+            glGetQueryObjectui64v(queryFor(frameSlot, (int)s, 0), GL_QUERY_RESULT, &gpuBegin);
+            glGetQueryObjectui64v(queryFor(frameSlot, (int)s, 1), GL_QUERY_RESULT, &gpuEnd);
+
+            const double cpuMs = std::chrono::duration<double, std::milli>(scope.cpuEnd - scope.cpuBegin).count();
+            const double gpuMs = (double)(gpuEnd - gpuBegin) * 1e-6;
+            record(scope.name, scope.depth, cpuMs, gpuMs);
+
+            if (tracing) {
+                const double cpuBeginUs = std::chrono::duration<double, std::micro>(scope.cpuBegin - traceStart).count();
+                const double gpuBeginUs = std::chrono::duration<double, std::micro>(cpuCalibration - traceStart).count() +
+                                          (double)((GLint64)gpuBegin - gpuCalibration) * 1e-3;
+                traceEvents.push_back(TraceEvent{ scope.name, 0, cpuBeginUs, cpuMs * 1e3 });
+                traceEvents.push_back(TraceEvent{ scope.name, 1, gpuBeginUs, gpuMs * 1e3 });
+            }
+        }
+    }
+
+    void Profiler::record(const char* name, int scopeDepth, double cpuMs, double gpuMs) {
+        auto it = std::find_if(stats.begin(), stats.end(), [&](const StageStats& s) {
+            return s.depth == scopeDepth && std::strcmp(s.name, name) == 0;
+        });
+        if (it == stats.end()) {
+            stats.push_back(StageStats{ name, scopeDepth, cpuMs, gpuMs });
+            return;
+        }
+        it->cpuMs += kSmoothing * (cpuMs - it->cpuMs);
+        it->gpuMs += kSmoothing * (gpuMs - it->gpuMs);
+    }
+
+    std::string Profiler::summary() const {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2);
+        for (size_t i = 0; i < stats.size(); ++i) {
+            const StageStats& s = stats[i];
+            out << (i ? " | " : "") << std::string(s.depth * 2, ' ') << s.name << " cpu " << s.cpuMs
+                << " gpu " << s.gpuMs;
+        }
+        return out.str();
+    }
+
+    void Profiler::startTrace() {
+        if (!enabled) setEnabled(true);
+        traceEvents.clear();
+        traceStart = Clock::now();
+        calibrate();
+        tracing = true;
+    }
+
+    bool Profiler::writeTrace(const std::string& path) {
+        tracing = false;
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cout << "Failed to open '" << path << "' for writing" << std::endl;
+            return false;
+        }
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+            << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"CPU\"}},\n"
+            << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"GPU\"}}";
+        for (const TraceEvent& e : traceEvents) {
+            out << ",\n  {\"name\": \"" << e.name << "\", \"cat\": \"" << (e.thread ? "gpu" : "cpu")
+                << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread << ", \"ts\": " << e.beginUs
+                << ", \"dur\": " << e.durationUs << "}";
+        }
+        out << "\n]}\n";
+        traceEvents.clear();
+        return static_cast<bool>(out);
+    }
+
+    void Profiler::drawOverlay(int framebufferWidth, int framebufferHeight) {
+        if (!enabled || stats.empty()) return;
+
+        if (!overlayProgram) {
+            GLuint vs = compileOverlayShader(GL_VERTEX_SHADER, kOverlayVertex);
+            GLuint fs = compileOverlayShader(GL_FRAGMENT_SHADER, kOverlayFragment);
+            overlayProgram = glCreateProgram();
+            glAttachShader(overlayProgram, vs);
+            glAttachShader(overlayProgram, fs);
+            glLinkProgram(overlayProgram);
+            glDeleteShader(vs);
+            glDeleteShader(fs);
+            overlaySizeLocation = glGetUniformLocation(overlayProgram, "uFramebufferSize");
+
+            glGenVertexArrays(1, &overlayVao);
+            glGenBuffers(1, &overlayVbo);
+            glBindVertexArray(overlayVao);
+            glBindBuffer(GL_ARRAY_BUFFER, overlayVbo);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(2 * sizeof(float)));
+        }
+
+        std::vector<float>& vertices = overlayVertices;
+        vertices.clear();
+        const float panelHeight = kOverlayRow * stats.size();
+        pushQuad(vertices, kOverlayMargin - 4.0f, kOverlayMargin - 4.0f,
+                 kOverlayMargin + kOverlayWidth + 4.0f, kOverlayMargin + panelHeight + 4.0f, 0.0f, 0.0f, 0.0f, 0.6f);
+        // 5 ms ticks
+        for (float ms = 5.0f; ms < kOverlayFullMs; ms += 5.0f) {
+            const float x = kOverlayMargin + kOverlayWidth * ms / kOverlayFullMs;
+            pushQuad(vertices, x, kOverlayMargin, x + 1.0f, kOverlayMargin + panelHeight, 1.0f, 1.0f, 1.0f, 0.2f);
+        }
+        for (size_t i = 0; i < stats.size(); ++i) {
+            const StageStats& s = stats[i];
+            const float* c = kPalette[i % (sizeof(kPalette) / sizeof(kPalette[0]))];
+            const float x0 = kOverlayMargin + kOverlayIndent * s.depth;
+            const float y0 = kOverlayMargin + kOverlayRow * i;
+            const float cpuW = kOverlayWidth * std::min(1.0f, (float)s.cpuMs / kOverlayFullMs);
+            const float gpuW = kOverlayWidth * std::min(1.0f, (float)s.gpuMs / kOverlayFullMs);
+            pushQuad(vertices, x0, y0 + 1.0f, x0 + std::max(cpuW, 1.0f), y0 + kOverlayRow * 0.5f,
+                     c[0], c[1], c[2], 0.9f);
+            pushQuad(vertices, x0, y0 + kOverlayRow * 0.5f, x0 + std::max(gpuW, 1.0f), y0 + kOverlayRow - 1.0f,
+                     c[0] * 0.6f, c[1] * 0.6f, c[2] * 0.6f, 0.9f);
+        }
+
+        glUseProgram(overlayProgram);
+        glUniform2f(overlaySizeLocation, (float)framebufferWidth, (float)framebufferHeight);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindVertexArray(overlayVao);
+        glBindBuffer(GL_ARRAY_BUFFER, overlayVbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STREAM_DRAW);
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(vertices.size() / 6));
+        glBindVertexArray(0);
+    }
+}
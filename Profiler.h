@@ -0,0 +1,140 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+namespace Particles {
+
+    // Per-stage frame profiler. Every scope records CPU begin/end times and a
+    // pair of GL timestamp queries. Queries live in a ring kFramesInFlight
+    // frames deep and are read back when their slot comes round again, so
+    // the profiler never waits on the GPU (a frame whose results are still
+    // not available by then is dropped).
+    //
+    // Scopes are opened with PROFILE_SCOPE(profiler, "name"), which compiles
+    // to nothing unless PARTICLESIM_PROFILER is defined. When compiled in but
+    // disabled, a scope costs one branch.
+    class Profiler {
+    public:
+        static constexpr int kFramesInFlight = 4;
+        static constexpr int kMaxScopesPerFrame = 64;
+
+        // Moving averages, in milliseconds, in first-seen order
+        struct StageStats {
+            const char* name;
+            int depth;
+            double cpuMs;
+            double gpuMs;
+        };
+
+        class Scope {
+        public:
+            Scope(Profiler* profiler, const char* name)
+                : profiler((profiler != nullptr && profiler->enabled) ? profiler : nullptr) {
+                if (this->profiler) slot = this->profiler->beginScope(name);
+            }
+            ~Scope() {
+                if (profiler) profiler->endScope(slot);
+            }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Profiler* profiler;
+            int slot { -1 };
+        };
+
+        Profiler() = default;
+        ~Profiler();
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        void setEnabled(bool enable);
+        bool isEnabled() const { return enabled; }
+
+        // Bracket every frame; beginFrame() also opens a "frame" scope and
+        // resolves the ring slot it is about to reuse
+        void beginFrame();
+        void endFrame();
+
+        const std::vector<StageStats>& getStats() const { return stats; }
+        // All stage averages on one line; the overlay bars carry no labels
+        std::string summary() const;
+
+        // Chrome trace (chrome://tracing, Perfetto) of every resolved scope
+        // between startTrace() and writeTrace(). CPU and GPU times appear as
+        // two threads on the CPU clock.
+        void startTrace();
+        bool isTracing() const { return tracing; }
+        bool writeTrace(const std::string& path);
+
+        // Horizontal bars, one row per stage: CPU time on top, GPU time below,
+        // full width = 20 ms. Draws over whatever is in the framebuffer.
+        void drawOverlay(int framebufferWidth, int framebufferHeight);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct ScopeRecord {
+            const char* name;
+            int depth;
+            Clock::time_point cpuBegin;
+            Clock::time_point cpuEnd;
+        };
+
+        struct FrameRecord {
+            std::vector<ScopeRecord> scopes;
+            bool pending { false };
+        };
+
+        struct TraceEvent {
+            const char* name;
+            int thread; // 0 = CPU, 1 = GPU
+            double beginUs;
+            double durationUs;
+        };
+
+        bool enabled { false };
+        bool inFrame { false };
+        uint64_t frameIndex { 0 };
+        int depth { 0 };
+        FrameRecord frames[kFramesInFlight];
+        GLuint queries[kFramesInFlight * kMaxScopesPerFrame * 2] {};
+        bool queriesCreated { false };
+
+        // GL timestamp (ns) and CPU time at the same instant, for mapping
+        // GPU times onto the CPU clock
+        GLint64 gpuCalibration { 0 };
+        Clock::time_point cpuCalibration;
+
+        std::vector<StageStats> stats;
+        bool tracing { false };
+        Clock::time_point traceStart;
+        std::vector<TraceEvent> traceEvents;
+
+        GLuint overlayProgram { 0 };
+        GLuint overlayVao { 0 };
+        GLuint overlayVbo { 0 };
+        GLint overlaySizeLocation { -1 }; // uFramebufferSize, looked up once after linking
+        std::vector<float> overlayVertices; // rebuilt every frame, keeps its capacity
+
+        int beginScope(const char* name);
+        void endScope(int slot);
+        GLuint queryFor(int frameSlot, int scope, int end) const;
+        void resolve(int frameSlot);
+        void calibrate();
+        void record(const char* name, int depth, double cpuMs, double gpuMs);
+    };
+}
+
+#ifdef PARTICLESIM_PROFILER
+#define PROFILE_SCOPE_CONCAT_(a, b) a##b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT_(a, b)
+#define PROFILE_SCOPE(profiler, name) \
+    ::Particles::Profiler::Scope PROFILE_SCOPE_CONCAT(profileScope_, __LINE__)(profiler, name)
+#else
+#define PROFILE_SCOPE(profiler, name) ((void)0)
+#endif
@@ -0,0 +1,60 @@
+#include "ReadbackRing.h"
+
+namespace Particles {
+
+    ReadbackRing::ReadbackRing(int slotCount)
+        : slots(slotCount > 0 ? slotCount : 1) {
+    }
+
+    ReadbackRing::~ReadbackRing() {
+        for (Slot& slot : slots) {
+            if (slot.fence) glDeleteSync(slot.fence);
+            if (slot.buffer) glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+
+    GLuint ReadbackRing::buffer(size_t bytes) {
+        Slot& slot = slots[(head + inFlight) % slots.size()];
+        if (bytes > slot.capacity) {
+            if (!slot.buffer) glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, slot.buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STREAM_READ);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            slot.capacity = bytes;
+        }
+        return slot.buffer;
+    }
+
+    void ReadbackRing::submit(size_t bytes, uint64_t tag) {
+        Slot& slot = slots[(head + inFlight) % slots.size()];
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // Make sure the fence reaches the GPU even if nothing else is submitted
+        glFlush();
+        slot.bytes = bytes;
+        slot.tag = tag;
+        ++inFlight;
+    }
+
+    bool ReadbackRing::poll(bool wait, ReadFn read) {
+        if (inFlight == 0) return false;
+        Slot& slot = slots[head];
+        const GLenum status = wait
+            ? glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED)
+            : glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) return false;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        head = (head + 1) % (int)slots.size();
+        --inFlight;
+        if (status == GL_WAIT_FAILED) return false;
+
+        glBindBuffer(GL_COPY_READ_BUFFER, slot.buffer);
+        const void* mapped = glMapBufferRange(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)slot.bytes, GL_MAP_READ_BIT);
+        if (mapped != nullptr) {
+            read(mapped, slot.bytes, slot.tag);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return mapped != nullptr;
+    }
+}
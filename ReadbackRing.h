@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+
+#include "ThreadPool.h"
+
+namespace Particles {
+
+    // Asynchronous GPU-to-CPU copies: a ring of buffers the GPU writes into
+    // behind fences, read back oldest first once their fence has passed.
+    // Used for snapshots, trajectory positions, metrics and exported frames.
+    //
+    // A request fills buffer() with GL commands, then calls submit(); poll()
+    // maps the oldest buffer in flight and hands its bytes to a callback.
+    // Needs a current GL context from construction to destruction.
+    class ReadbackRing {
+    public:
+        using ReadFn = FunctionRef<void(const void* data, size_t bytes, uint64_t tag)>;
+
+        explicit ReadbackRing(int slots = 1);
+        ~ReadbackRing();
+        ReadbackRing(const ReadbackRing&) = delete;
+        ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+        bool full() const { return inFlight == (int)slots.size(); }
+        bool pending() const { return inFlight > 0; }
+        int slotsInFlight() const { return inFlight; }
+
+        // The next free slot's buffer, grown to hold at least bytes; only
+        // valid while !full()
+        GLuint buffer(size_t bytes);
+        // Fences the commands queued so far and flushes them; tag is handed
+        // back by poll()
+        void submit(size_t bytes, uint64_t tag);
+        // Calls read with the oldest slot's bytes once its fence has passed,
+        // or waits for it if wait is set. False while nothing is ready, or
+        // if the wait or the map failed (the slot is dropped then).
+        bool poll(bool wait, ReadFn read);
+
+    private:
+        struct Slot {
+            GLuint buffer { 0 };
+            size_t capacity { 0 };
+            size_t bytes { 0 };
+            uint64_t tag { 0 };
+            GLsync fence { nullptr };
+        };
+
+        std::vector<Slot> slots;
+        int head { 0 }; // oldest slot in flight
+        int inFlight { 0 };
+    };
+}
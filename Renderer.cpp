@@ -1,7 +1,11 @@
  #include "Renderer.h"
+ #include "ParticleSpawner.h"
  
  #include <string>
  #include <cstdio>
+ #include <cmath>
+ #include <algorithm>
+ #include <cstring>
  
  namespace Particles {
  
@@ -18,15 +22,24 @@
 		out vec3 vColor;
 		out vec2 vCircleCoord;
 
-		uniform vec2 uFramebufferSize; // width, height in pixels
+		uniform vec2 uWorldSize; // width, height in pixels
 		uniform float uRadiusScale;
+		// Density-splat drawing: cores are dropped where the splat's disc
+		// coverage reaches uCullCoverage (0 draws every core)
+		uniform sampler2D uDensity;
+		uniform vec2 uPixelToSplat;
+		uniform float uCullCoverage;
 
 		void main(){
+			if (uCullCoverage > 0.0 && textureLod(uDensity, aPosPx * uPixelToSplat, 0.0).a >= uCullCoverage) {
+				gl_Position = vec4(2.0, 2.0, 2.0, 1.0); // outside the clip volume
+				return;
+			}
 			vec2 px = aPosPx + (aCircleVertex * (aRadiusPx * uRadiusScale));
 			// normalize to [-1, 1] (normalized device coordinates)
 			vec2 ndc = vec2(
-				(px.x / uFramebufferSize.x) * 2.0 - 1.0,
-				1.0 - (px.y / uFramebufferSize.y) * 2.0
+				(px.x / uWorldSize.x) * 2.0 - 1.0,
+				1.0 - (px.y / uWorldSize.y) * 2.0
 			);
 			gl_Position = vec4(ndc, 0.0, 1.0);
 			vColor = aColor;
@@ -57,6 +70,88 @@
 			}
 		}
 	)";
+
+	// Single-pass drawing: each quad spans the outer glow, and one fragment
+	// evaluates both glow falloffs and the core. The glow is written to an
+	// additive HDR target, the core to a premultiplied one blended "over",
+	// so the order-dependent compositing of the three passes is preserved.
+	static const char* kSinglePassFragment = R"(
+		#version 330 core
+		in vec3 vColor;
+		in vec2 vCircleCoord;
+		layout(location = 0) out vec4 Glow; // blend ONE, ONE
+		layout(location = 1) out vec4 Core; // blend ONE, ONE_MINUS_SRC_ALPHA
+
+		uniform vec3 uGlowPasses[2]; // radius / quad radius, sharpness, intensity
+		uniform float uCoreScale;    // core radius / quad radius
+
+		void main(){
+			float dist = length(vCircleCoord);
+			if(dist > 1.0) discard;
+
+			float glow = 0.0;
+			for (int i = 0; i < 2; ++i) {
+				float d = dist / uGlowPasses[i].x;
+				if (d <= 1.0) glow += exp(-pow(d * uGlowPasses[i].y, 2.0)) * uGlowPasses[i].z;
+			}
+			Glow = vec4(vColor * glow, glow);
+
+			float d = dist / uCoreScale;
+			float alpha = d <= 1.0 ? 1.0 - smoothstep(0.8, 1.0, d) : 0.0;
+			Core = vec4(vColor * alpha, alpha);
+		}
+	)";
+
+	// Resolves the single-pass targets into the window: the glow target
+	// starts at the clear colour and is clipped to [0, 1] as the 8-bit
+	// additive blending of the glow passes does, then the cores go over it
+	static const char* kHdrResolveFragment = R"(
+		#version 330 core
+		out vec4 FragColor;
+
+		uniform sampler2D uGlow;
+		uniform sampler2D uCore;
+
+		void main(){
+			ivec2 px = ivec2(gl_FragCoord.xy);
+			vec3 glow = clamp(texelFetch(uGlow, px, 0).rgb, 0.0, 1.0);
+			vec4 core = texelFetch(uCore, px, 0);
+			FragColor = vec4(core.rgb + (1.0 - core.a) * glow, 1.0);
+		}
+	)";
+
+	// Fullscreen triangle for the resolve and composite passes
+	static const char* kFullscreenVertex = R"(
+		#version 330 core
+		void main(){
+			vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+			gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+		}
+	)";
+
+	// Density-splat composite: one fullscreen triangle that adds the blurred
+	// glow and covers the cells too crowded for core quads with their mean
+	// colour. Output is premultiplied (blend ONE, ONE_MINUS_SRC_ALPHA).
+	static const char* kCompositeFragment = R"(
+		#version 330 core
+		out vec4 FragColor;
+
+		uniform sampler2D uDensity; // mean colour, disc coverage
+		uniform sampler2D uGlow;
+		uniform vec2 uWorldSize;  // in pixels
+		uniform vec2 uTargetSize; // of the framebuffer drawn to
+		uniform vec2 uPixelToSplat;
+		uniform float uCullCoverage;
+
+		void main(){
+			vec2 px = vec2(gl_FragCoord.x, uTargetSize.y - gl_FragCoord.y) * (uWorldSize / uTargetSize);
+			vec2 uv = px * uPixelToSplat;
+			vec4 density = texture(uDensity, uv);
+			float fill = smoothstep(0.5 * uCullCoverage, uCullCoverage, density.a);
+			// glow first, then the fill over it, as cores cover the glow quads
+			FragColor = vec4(mix(texture(uGlow, uv).rgb, density.rgb, fill), fill);
+		}
+	)";
  
  	static GLuint compile(GLenum type, const char* src) {
  		GLuint s = glCreateShader(type);
@@ -87,8 +182,53 @@
  		return p;
  	}
  
- 		Renderer::Renderer(GLFWwindow* window) {
+	// Density splat: cell size in pixels, fixed-point scale of the sums and
+	// the glow Gaussian in cells (all passed to the shaders as defines), and
+	// the disc coverage at which core quads give way to the cell fill
+	static constexpr int kSplatCellPx = 2;
+	static constexpr float kSplatScale = 256.0f;
+	static constexpr int kGlowTaps = 4;
+	static constexpr float kGlowSigma = 1.5f;
+	static constexpr float kCoreCullCoverage = 1.0f;
+	// Texture units the splat textures are sampled from while drawing
+	static constexpr GLuint kDensityUnit = 0;
+	static constexpr GLuint kGlowUnit = 1;
+	// ... and the single-pass HDR targets while resolving
+	static constexpr GLuint kHdrGlowUnit = 0;
+	static constexpr GLuint kHdrCoreUnit = 1;
+
+	// The additive glow passes of DrawMode::Quads. SinglePass evaluates all
+	// of them in one fragment; DensitySplat spreads the same light per
+	// particle through its blur instead.
+	struct GlowPass {
+		const char* name;
+		float radiusScale;
+		float sharpness;
+		float intensity;
+	};
+	static constexpr GlowPass kGlowPasses[] = {
+		{ "outer glow", 3.0f, 0.6f, 0.18f }, // very wide, soft, faint
+		{ "inner glow", 1.5f, 1.1f, 0.50f }, // medium radius, tighter, bright (make it HOT)
+	};
+
+	// Light the glow passes add for a particle of unit colour, per radius^2:
+	// the integral of intensity * exp(-(sharpness * d / R)^2) over the quad's
+	// disc of radius R = radiusScale * radius
+	static float glowEnergy() {
+		const float pi = 3.14159265f;
+		float energy = 0.0f;
+		for (const GlowPass& pass : kGlowPasses) {
+			const float k2 = pass.sharpness * pass.sharpness;
+			energy += pass.intensity * pi * pass.radiusScale * pass.radiusScale * (1.0f - std::exp(-k2)) / k2;
+		}
+		return energy;
+	}
+
+ 		Renderer::Renderer(GLFWwindow* window, float worldWidth, float worldHeight) {
 		updateFramebufferSize(window);
+		this->worldWidth = worldWidth > 0.0f ? worldWidth : (float)framebufferWidth;
+		this->worldHeight = worldHeight > 0.0f ? worldHeight : (float)framebufferHeight;
+		numSpecies = Color::speciesCount(Color::attractionMatrix);
 		createShaders();
 		createComputeShader();
 		createAttractionTexture();
@@ -100,246 +240,1908 @@
 		if(vao) glDeleteVertexArrays(1, &vao);
 		if(shaderProgram) glDeleteProgram(shaderProgram);
 		if(computeProgram) glDeleteProgram(computeProgram);
+		if(tiledComputeProgram) glDeleteProgram(tiledComputeProgram);
+		if(gridComputeProgram) glDeleteProgram(gridComputeProgram);
+		if(binCountProgram) glDeleteProgram(binCountProgram);
+		if(binScanProgram) glDeleteProgram(binScanProgram);
+		if(binScatterProgram) glDeleteProgram(binScatterProgram);
+		if(unpackProgram) glDeleteProgram(unpackProgram);
+		if(packProgram) glDeleteProgram(packProgram);
+		if(spawnProgram) glDeleteProgram(spawnProgram);
+		if(cellStartBuffer) glDeleteBuffers(1, &cellStartBuffer);
+		if(particleRankBuffer) glDeleteBuffers(1, &particleRankBuffer);
+		if(sortedHotBuffer) glDeleteBuffers(1, &sortedHotBuffer);
+		if(sortedSpeciesBuffer) glDeleteBuffers(1, &sortedSpeciesBuffer);
+		if(hotBuffers[0]) glDeleteBuffers(2, hotBuffers);
+		if(velBuffers[0]) glDeleteBuffers(2, velBuffers);
+		if(speciesBuffer) glDeleteBuffers(1, &speciesBuffer);
+		if(colorBuffer) glDeleteBuffers(1, &colorBuffer);
+		if(stagingBuffer) glDeleteBuffers(1, &stagingBuffer);
+		if(stagingIndexBuffer) glDeleteBuffers(1, &stagingIndexBuffer);
+		if(quantizeProgram) glDeleteProgram(quantizeProgram);
+		if(metricsSumsProgram) glDeleteProgram(metricsSumsProgram);
+		if(metricsNeighbourProgram) glDeleteProgram(metricsNeighbourProgram);
+		if(clusterRootProgram) glDeleteProgram(clusterRootProgram);
+		if(clusterStatsProgram) glDeleteProgram(clusterStatsProgram);
+		if(metricsBuffer) glDeleteBuffers(1, &metricsBuffer);
+		if(clusterParentBuffer) glDeleteBuffers(1, &clusterParentBuffer);
+		if(nearestKeyBuffer) glDeleteBuffers(1, &nearestKeyBuffer);
+		if(splatProgram) glDeleteProgram(splatProgram);
+		if(splatResolveProgram) glDeleteProgram(splatResolveProgram);
+		if(splatBlurProgram) glDeleteProgram(splatBlurProgram);
+		if(compositeProgram) glDeleteProgram(compositeProgram);
+		if(fullscreenVao) glDeleteVertexArrays(1, &fullscreenVao);
+		if(splatBuffer) glDeleteBuffers(1, &splatBuffer);
+		if(singlePassProgram) glDeleteProgram(singlePassProgram);
+		if(hdrResolveProgram) glDeleteProgram(hdrResolveProgram);
+		if(hdrFramebuffer) glDeleteFramebuffers(1, &hdrFramebuffer);
+		for (GLuint texture : { hdrGlowTexture, hdrCoreTexture }) {
+			if(texture) glDeleteTextures(1, &texture);
+		}
+		for (GLuint texture : { densityTexture, blurTexture, glowTexture }) {
+			if(texture) glDeleteTextures(1, &texture);
+		}
+		if(simulationBlockBuffer) glDeleteBuffers(1, &simulationBlockBuffer);
+		if(attractionTexture) glDeleteTextures(1, &attractionTexture);
 	}
  
  	void Renderer::updateFramebufferSize(GLFWwindow* window){
  		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		targetWidth = framebufferWidth;
+		targetHeight = framebufferHeight;
  	}
  
  		void Renderer::createShaders(){
 		GLuint vs = compile(GL_VERTEX_SHADER, kVertex);
 		GLuint fs = compile(GL_FRAGMENT_SHADER, kFragment);
 		shaderProgram = link(vs, fs);
+
+		drawUniforms.radiusScale = glGetUniformLocation(shaderProgram, "uRadiusScale");
+		drawUniforms.doGlow = glGetUniformLocation(shaderProgram, "uDoGlow");
+		drawUniforms.glowIntensity = glGetUniformLocation(shaderProgram, "uGlowIntensity");
+		drawUniforms.glowSharpness = glGetUniformLocation(shaderProgram, "uGlowSharpness");
+		drawUniforms.cullCoverage = glGetUniformLocation(shaderProgram, "uCullCoverage");
+
+		// The world size is fixed for the renderer's lifetime
+		glProgramUniform2f(shaderProgram, glGetUniformLocation(shaderProgram, "uWorldSize"), worldWidth, worldHeight);
+
+		singlePassProgram = link(compile(GL_VERTEX_SHADER, kVertex), compile(GL_FRAGMENT_SHADER, kSinglePassFragment));
+		glProgramUniform2f(singlePassProgram, glGetUniformLocation(singlePassProgram, "uWorldSize"), worldWidth, worldHeight);
+		// Every glow pass and the core, relative to the widest quad
+		static_assert(sizeof(kGlowPasses) / sizeof(kGlowPasses[0]) == 2, "uGlowPasses[2]");
+		float quadScale = 1.0f;
+		for (const GlowPass& pass : kGlowPasses) quadScale = std::max(quadScale, pass.radiusScale);
+		float glowPasses[2][3];
+		for (int i = 0; i < 2; ++i) {
+			glowPasses[i][0] = kGlowPasses[i].radiusScale / quadScale;
+			glowPasses[i][1] = kGlowPasses[i].sharpness;
+			glowPasses[i][2] = kGlowPasses[i].intensity;
+		}
+		glProgramUniform3fv(singlePassProgram, glGetUniformLocation(singlePassProgram, "uGlowPasses"), 2, &glowPasses[0][0]);
+		glProgramUniform1f(singlePassProgram, glGetUniformLocation(singlePassProgram, "uCoreScale"), 1.0f / quadScale);
+		glProgramUniform1f(singlePassProgram, glGetUniformLocation(singlePassProgram, "uRadiusScale"), quadScale);
+
+		hdrResolveProgram = link(compile(GL_VERTEX_SHADER, kFullscreenVertex),
+								 compile(GL_FRAGMENT_SHADER, kHdrResolveFragment));
+		glProgramUniform1i(hdrResolveProgram, glGetUniformLocation(hdrResolveProgram, "uGlow"), (GLint)kHdrGlowUnit);
+		glProgramUniform1i(hdrResolveProgram, glGetUniformLocation(hdrResolveProgram, "uCore"), (GLint)kHdrCoreUnit);
+
+		compositeProgram = link(compile(GL_VERTEX_SHADER, kFullscreenVertex),
+								compile(GL_FRAGMENT_SHADER, kCompositeFragment));
+		glProgramUniform2f(compositeProgram, glGetUniformLocation(compositeProgram, "uWorldSize"), worldWidth, worldHeight);
+		compositeTargetSize = glGetUniformLocation(compositeProgram, "uTargetSize");
+		glProgramUniform2f(compositeProgram, compositeTargetSize, (float)targetWidth, (float)targetHeight);
+		// Attribute-less draws still need a vertex array bound
+		glGenVertexArrays(1, &fullscreenVao);
+	}
+
+	// Vertex buffer binding points that source the per-instance particle data
+	static constexpr GLuint kHotBinding = 1;
+	static constexpr GLuint kColorBinding = 2;
+
+	// GPU particle storage is split into streams (structure of arrays):
+	//   hot     vec4(pos.xy, radius, mass)  16 B  ping-pong, read by every force loop
+	//   species 1 byte, four packed per uint      read by every force loop
+	//   vel     vec4(vel.xy, acc.xy)         16 B  ping-pong, read/written once per step
+	//   color   vec4                         16 B  drawing only
+	// GPUParticle remains the upload/download format; kUnpack and kPack
+	// convert between it and the streams on the GPU.
+	static constexpr size_t kHotStride = sizeof(HotParticle);
+	static constexpr size_t kVelStride = 4 * sizeof(float);
+	static constexpr size_t kColorStride = 4 * sizeof(float);
+
+	static size_t speciesWords(size_t particleCount) {
+		return (particleCount + 3) / 4;
 	}
 
-	static const char* kCompute = R"(
+	// SSBO binding points. Only eight are guaranteed, so passes that never
+	// meet share indices; dispatch code binds the right buffers per pass.
+	enum StorageBinding : GLuint {
+		kHotIn = 0,
+		kHotOut = 1,
+		kVelIn = 2,
+		kVelOut = 3,
+		kSpeciesIn = 4,
+		kCellStart = 5,
+		kSortedHot = 6,
+		kSortedSpecies = 7,
+		// bin count / scatter only
+		kParticleRank = 3,
+		// pack / unpack only
+		kStaging = 5,
+		kStagingIndex = 6,
+		kColor = 7,
+		// position quantization only
+		kQuantized = 5,
+		// metrics only
+		kMetrics = 1,
+		kNearestKey = 2,
+		kClusterParent = 3,
+		kClusterSize = 5,
+		// density splat only
+		kSplat = 5,
+		kSplatColor = 7,
+	};
+
+	// Explicit uniform locations of the compute programs (layout(location)),
+	// so dispatches never look uniforms up by name
+	enum UniformLocation : GLint {
+		kCountLocation = 0,    // uCount
+		kDtLocation = 1,       // uDt, physics kernels that integrate
+		kIndexedLocation = 1,  // uIndexed, pack / unpack
+		kNumCellsLocation = 0, // uNumCells, bin scan
+		kScaleLocation = 1,    // uScale, position quantization
+		kRadiusSquaredLocation = 2, // uRadiusSquared, metrics neighbour pass
+		kRadiusLocation = 3,        // uRadius, metrics neighbour pass
+		kSplatSizeLocation = 1,  // uSplatSize, density splat passes
+		kGlowScaleLocation = 2,  // uGlowScale, splat blur
+		kSpawnKeyLocation = 1,   // uKey, spawn
+		kWorldLocation = 2,      // uWorld, spawn
+		kSpeciesCountLocation = 3, // uSpeciesCount, spawn
+		kSpeciesColorLocation = 4, // uSpeciesColor[MAX_SPECIES], spawn
+		kSpeciesBodyLocation = 4 + Color::MAX_SPECIES, // uSpeciesBody[MAX_SPECIES], spawn
+	};
+
+	// Reserved for the renderer: the SimulationBlock uniform-buffer binding
+	// and the texture unit of the attraction matrix (both also written as
+	// literals in the shader sources)
+	static constexpr GLuint kSimulationBlockBinding = 0;
+	static constexpr GLuint kAttractionUnit = 7;
+
+	static const char* kComputeVersion = R"(
 		#version 430
 		layout(local_size_x = 256) in;
+	)";
 
-		struct Particle {
-			vec2 pos;      // offset  0
-			vec2 vel;      // offset  8
-			float radius;  // offset 16
-			float mass;   // offset 20
-			vec4  color;   // offset 32  (16-byte aligned)
-			int   species; // offset 48
-			float _pad1;   // offset 52
-			vec2  _pad2;   // offset 56 -> total stride 64 bytes
+	// Shared prologue of every physics kernel: stream layout, simulation
+	// uniforms and the pairwise force law. Each kernel appends its own main().
+	// Expects NUM_SPECIES and MAX_UNROLLED_SPECIES, and SHARED_ATTRACTION for
+	// kernels that stage the attraction matrix in shared memory, to be
+	// defined in front of it. The programs are relinked whenever the species
+	// count changes, so NUM_SPECIES is always a compile-time constant.
+	static const char* kComputeCommon = R"(
+		// Ping-pong pairs: every kernel reads the front buffers and only
+		// the integrator writes, into the back buffers
+		layout(std430, binding = 0) readonly buffer HotIn {
+			vec4 hot[];    // pos.xy, radius, mass
+		};
+
+		layout(std430, binding = 1) writeonly buffer HotOut {
+			vec4 hotOut[];
+		};
+
+		layout(std430, binding = 2) readonly buffer VelIn {
+			vec4 vel[];    // velocity, acceleration of the previous step
+		};
+
+		layout(std430, binding = 3) writeonly buffer VelOut {
+			vec4 velOut[];
 		};
 
+		layout(std430, binding = 4) readonly buffer SpeciesIn {
+			uint speciesWords[]; // four 8-bit species ids per word
+		};
+
+		layout(location = 0) uniform int   uCount;
+		layout(location = 1) uniform float uDt;
 
-		layout(std430, binding = 0) buffer Particles {
-			Particle p[];
+		// Changes only with the simulation parameters or grid size
+		layout(std140, binding = 0) uniform SimulationBlock {
+			float uMaxDist;
+			float uRepelDist;
+			float uDamping; // 0..1 per step
+			float uForceScale;
+			ivec2 uGridDim;
+			vec2  uCellSize;
+			vec2  uWorldSize;
+			float uReferenceDt; // positions advance by vel * uDt / uReferenceDt
+			int   uIntegrator;  // Integrator enum
+			int   uBoundary;    // Boundary enum
 		};
 
-		uniform int   uCount;
-		uniform float uMaxDist;
-		uniform float uRepelDist;
-		uniform float uDt;
-		uniform float uDamping; // 0..1 per step
-		uniform float uForceScale;
+		// Attraction matrix as a texture, on unit kAttractionUnit
+		layout(binding = 7) uniform sampler2D uAttractionMatrix;
+
+		int speciesOf(uint i) {
+			return int((speciesWords[i >> 2] >> ((i & 3u) * 8u)) & 0xFFu);
+		}
+
+		// Kernels call loadAttraction(si) once for the particle they update
+		// before the first attractionOf(si, ...)
+		#ifdef SHARED_ATTRACTION
+		// Copy of uAttractionMatrix; the kernel fills it before first use
+		shared float attractionTile[NUM_SPECIES * NUM_SPECIES];
+
+		void loadAttraction(int si) {}
+
+		float attractionOf(int si, int sj) {
+			return attractionTile[sj * NUM_SPECIES + si];
+		}
+		#elif NUM_SPECIES <= MAX_UNROLLED_SPECIES
+		// Small matrices: the particle's column lives in registers for the
+		// whole neighbour loop instead of one texture fetch per pair
+		float attractionColumn[NUM_SPECIES];
+
+		void loadAttraction(int si) {
+			for (int s = 0; s < NUM_SPECIES; ++s) {
+				attractionColumn[s] = texelFetch(uAttractionMatrix, ivec2(si, s), 0).r;
+			}
+		}
+
+		float attractionOf(int si, int sj) {
+			return attractionColumn[sj];
+		}
+		#else
+		void loadAttraction(int si) {}
+
+		float attractionOf(int si, int sj) {
+			return texelFetch(uAttractionMatrix, ivec2(si, sj), 0).r;
+		}
+		#endif
+
+		// Velocity change that particle j imparts on particle i, d = xj - xi
+		// away. A particle paired with itself has d2 == 0 and contributes nothing.
+		vec2 pairForce(vec2 d, float ri, float mi, int si,
+		               float rj, float mj, int sj) {
+			float d2 = dot(d, d);
+			if (d2 == 0.0) return vec2(0.0);
+
+			float dist = sqrt(d2);
+			if (dist > uMaxDist) return vec2(0.0);
+
+			float invd2 = 1.0 / d2;
+			float k = attractionOf(si, sj);
+
+			float massProd = mi * mj;
+
+			float contact = ri + rj;
+			float f;
+			if (dist > contact + uRepelDist) {
+				f = k * massProd * invd2;
+			} else {
+				float repelMag = (k != 0.0) ? abs(k) * massProd : massProd;
+				f = -repelMag * invd2;
+			}
+			return uForceScale * f * d;
+		}
+
+		// The all-pairs kernels see every particle once, wherever it is, and
+		// take the nearest of its images in a torus (minimum image)
+		vec2 nearestImage(vec2 d) {
+			if (uBoundary != 1) return d; // Boundary::Torus
+			return d - uWorldSize * round(d / uWorldSize);
+		}
+
+		// Mirrors applyBoundary() in SimulationParams.h, on both axes
+		void applyBoundary(inout vec2 pos, inout vec2 v) {
+			if (uBoundary == 1) { // Boundary::Torus
+				pos = mix(pos, pos + uWorldSize, lessThan(pos, vec2(0.0)));
+				pos = mix(pos, pos - uWorldSize, greaterThanEqual(pos, uWorldSize));
+			} else if (uBoundary == 2) { // Boundary::Reflect
+				bvec2 below = lessThan(pos, vec2(0.0));
+				bvec2 above = greaterThan(pos, uWorldSize);
+				pos = mix(pos, -pos, below);
+				pos = mix(pos, uWorldSize - (pos - uWorldSize), above);
+				v = mix(v, -v, bvec2(below.x || above.x, below.y || above.y));
+				pos = clamp(pos, vec2(0.0), uWorldSize);
+			}
+		}
+
+		// Velocities are in pixels per reference step, so a step of uDt
+		// moves by vel * h. Mirrored exactly by CpuSimulator::computeForces.
+		void integrate(uint i, vec4 hi, vec2 dV) {
+			vec2 acc = dV / hi.w;
+			vec4 state = vel[i];
+			float h = uDt / uReferenceDt;
+
+			vec2 v;
+			vec2 pos;
+			if (uIntegrator == 1) { // Integrator::VelocityVerlet
+				// Velocity Verlet with one force evaluation per step: complete
+				// the previous step's kick with this acceleration, then drift.
+				// The stored velocity belongs to the positions read this step.
+				v = (state.xy + 0.5 * (state.zw + acc) * uDt) * (1.0 - uDamping);
+				pos = hi.xy + v * h + 0.5 * acc * uDt * h;
+			} else {
+				// Semi-implicit Euler
+				v = (state.xy + acc * uDt) * (1.0 - uDamping);
+				pos = hi.xy + v * h;
+			}
+			applyBoundary(pos, v);
 
-		// Attraction matrix as a texture
-		uniform sampler2D uAttractionMatrix;
+			velOut[i] = vec4(v, acc);
+			hotOut[i] = vec4(pos, hi.zw);
+		}
+	)";
 
+	// Brute-force kernel: every invocation visits all uCount particles.
+	static const char* kComputeBruteForce = R"(
 		void main() {
 			uint i = gl_GlobalInvocationID.x;
 			if (i >= uint(uCount)) return;
 
-			vec2 xi = p[i].pos;
-			float ri = p[i].radius;
-			float mi = p[i].mass;
-			int si   = p[i].species;
+			vec4 hi = hot[i];
+			int si  = speciesOf(i);
+			loadAttraction(si);
 
 			vec2 dV = vec2(0.0);
 
-			for (int j = 0; j < uCount; ++j) {
-				if (j == int(i)) continue;
+			for (uint j = 0u; j < uint(uCount); ++j) {
+				vec4 hj = hot[j];
+				dV += pairForce(nearestImage(hj.xy - hi.xy), hi.z, hi.w, si, hj.z, hj.w, speciesOf(j));
+			}
+
+			integrate(i, hi, dV);
+		}
+	)";
+
+	// Tiled all-pairs kernel: each 256-wide workgroup stages blocks of 256
+	// particles (and the attraction matrix) in shared memory, and every thread
+	// of the group then consumes them from there instead of from the SSBO.
+	static const char* kComputeTiled = R"(
+		shared vec4 tileHot[256];
+		shared int  tileSpecies[256];
+
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			uint lid = gl_LocalInvocationID.x;
+			uint count = uint(uCount);
+			// Threads past the end still load tiles and reach every barrier
+			bool inRange = i < count;
 
-				vec2 xj = p[j].pos;
-				vec2 d  = xj - xi;
-				float d2 = dot(d, d);
-				if (d2 == 0.0) continue;
+			for (uint e = lid; e < uint(NUM_SPECIES * NUM_SPECIES); e += 256u) {
+				attractionTile[e] = texelFetch(uAttractionMatrix, ivec2(e % uint(NUM_SPECIES), e / uint(NUM_SPECIES)), 0).r;
+			}
 
-				float dist = sqrt(d2);
-				if (dist > uMaxDist) continue;
+			vec4 hi = inRange ? hot[i] : vec4(0.0);
+			int si  = inRange ? speciesOf(i) : 0;
 
-				float invd2 = 1.0 / d2;
-				float k = texelFetch(uAttractionMatrix, ivec2(si, p[j].species), 0).r;
+			vec2 dV = vec2(0.0);
 
-				float massProd = mi * p[j].mass;
+			for (uint base = 0u; base < count; base += 256u) {
+				uint j = base + lid;
+				if (j < count) {
+					tileHot[lid] = hot[j];
+					tileSpecies[lid] = speciesOf(j);
+				}
+				memoryBarrierShared();
+				barrier();
 
-				float contact = ri + p[j].radius;
-				float f;
-				if (dist > contact + uRepelDist) {
-					f = k * massProd * invd2;
-				} else {
-					float repelMag = (k != 0.0) ? abs(k) * massProd : massProd;
-					f = -repelMag * invd2;
+				if (inRange) {
+					uint tileSize = min(256u, count - base);
+					for (uint t = 0u; t < tileSize; ++t) {
+						vec4 hj = tileHot[t];
+						dV += pairForce(nearestImage(hj.xy - hi.xy), hi.z, hi.w, si, hj.z, hj.w, tileSpecies[t]);
+					}
 				}
-				dV += uForceScale * f * d;
+				barrier();
 			}
-			
-			vec2 acc = dV / mi;
-
-			// simple velocity + damping
-			vec2 v = p[i].vel + acc * uDt;
-			v *= (1.0 - uDamping);
 
-			p[i].vel = v;
-			p[i].pos = xi + v;
+			if (inRange) integrate(i, hi, dV);
 		}
 	)";
 
-	void Renderer::createAttractionTexture() {
-		const int numSpecies = Color::NUM_SPECIES;
-		std::vector<float> attractionData(numSpecies * numSpecies, 0.0f);
-		
-		// Fill the matrix from Color::attractionMatrix
-		for (const auto& [c1n, c2n, weight] : Color::attractionMatrix) {
-			int i = static_cast<int>(c1n);
-			int j = static_cast<int>(c2n);
-			attractionData[i * numSpecies + j] = weight;
+	// Uniform-grid binning. Cells are uCellSize (>= uMaxDist) wide, so every
+	// neighbour of a particle lies in the 3x3 block around its own cell,
+	// which wraps around the edges of a torus (see gridLayout() and
+	// neighbourRuns() in SimulationParams.h). Positions outside the grid are
+	// clamped into the border cells; clamping never separates two cells by
+	// more than one step, so this stays exact.
+	static const char* kGridCommon = R"(
+		// Counts during binning, then (after the scan) numCells + 1 offsets
+		layout(std430, binding = 5) buffer CellStarts {
+			uint cellStart[];
+		};
+
+		// Hot stream and packed species, both in cell order
+		layout(std430, binding = 6) buffer SortedHot {
+			vec4 sortedHot[];
+		};
+
+		layout(std430, binding = 7) buffer SortedSpecies {
+			uint sortedSpeciesWords[];
+		};
+
+		ivec2 cellCoord(vec2 pos) {
+			return clamp(ivec2(floor(pos / uCellSize)), ivec2(0), uGridDim - 1);
 		}
-		
-		// Create and configure the texture
-		glGenTextures(1, &attractionTexture);
-		glBindTexture(GL_TEXTURE_2D, attractionTexture);
-		
-		// Upload the data as an numSpecies x numSpecies R32F texture
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, numSpecies, numSpecies, 0, GL_RED, GL_FLOAT, attractionData.data());
-		
-		// Set texture parameters for exact pixel sampling
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
 
-	void Renderer::createComputeShader(){
-		GLuint cs = compile(GL_COMPUTE_SHADER, kCompute);
-		computeProgram = glCreateProgram();
-		glAttachShader(computeProgram, cs);
-		glLinkProgram(computeProgram);
-		GLint ok=0; glGetProgramiv(computeProgram, GL_LINK_STATUS, &ok);
-		if(!ok){
-			char log[1024]; GLsizei n=0; glGetProgramInfoLog(computeProgram, 1024, &n, log);
-			fprintf(stderr, "Compute program link error: %s\n", log);
+		uint cellIndex(vec2 pos) {
+			ivec2 c = cellCoord(pos);
+			return uint(c.y * uGridDim.x + c.x);
 		}
-		glDeleteShader(cs);
-	}
- 
-	void Renderer::initializeGPUBuffer(const std::vector<GPUParticle>& initialParticles, GLuint& particleBuffer) {
-		glGenBuffers(1, &particleBuffer);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleBuffer);
-		glBufferData(GL_SHADER_STORAGE_BUFFER,
-					 initialParticles.size() * sizeof(GPUParticle),
-					 initialParticles.data(), GL_DYNAMIC_DRAW);
-	}
 
-	void Renderer::drawPointsGPU(GLuint particleBuffer, size_t particleCount) {
-		if (particleCount == 0) return;
-	
-		glBindVertexArray(vao);
-		glUseProgram(shaderProgram);
-	
-		if (GLint loc = glGetUniformLocation(shaderProgram, "uFramebufferSize"); loc >= 0) {
-			glUniform2f(loc, (float)framebufferWidth, (float)framebufferHeight);
+		// Mirrors neighbourRuns(): the neighbour cells of c along one axis
+		// as up to two runs [x, y], and the offset that moves the particle
+		// next to the images in each (non-zero for ghost cells of a torus)
+		int neighbourRuns(int c, int cells, float period, out ivec2 runs[2], out float offsets[2]) {
+			runs[1] = ivec2(0, -1);
+			offsets[1] = 0.0;
+			if (uBoundary == 1) { // Boundary::Torus
+				if (c == 0) {
+					runs[0] = ivec2(cells - 1);
+					offsets[0] = period;
+					runs[1] = ivec2(0, 1);
+					return 2;
+				}
+				if (c == cells - 1) {
+					runs[0] = ivec2(c - 1, c);
+					offsets[0] = 0.0;
+					runs[1] = ivec2(0);
+					offsets[1] = -period;
+					return 2;
+				}
+			}
+			runs[0] = ivec2(max(c - 1, 0), min(c + 1, cells - 1));
+			offsets[0] = 0.0;
+			return 1;
 		}
-	
-		// ---------- Pass 1: OUTER GLOW (very wide, soft, faint) ----------
-		glUniform1i(glGetUniformLocation(shaderProgram, "uDoGlow"), 1);
-		glUniform1f(glGetUniformLocation(shaderProgram, "uRadiusScale"), 3.0f);   // huge radius
-		glUniform1f(glGetUniformLocation(shaderProgram, "uGlowSharpness"), 0.6f); // soft falloff
-		glUniform1f(glGetUniformLocation(shaderProgram, "uGlowIntensity"), 0.18f);// faint but covers area
-		glBlendFunc(GL_ONE, GL_ONE);
-		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)particleCount);
-	
-		// ---------- Pass 2: INNER GLOW (medium radius, tighter, bright) ----------
-		glUniform1f(glGetUniformLocation(shaderProgram, "uRadiusScale"), 1.5f);   // medium radius
-		glUniform1f(glGetUniformLocation(shaderProgram, "uGlowSharpness"), 1.1f); // tighter curve
-		glUniform1f(glGetUniformLocation(shaderProgram, "uGlowIntensity"), 0.50f);// make it HOT
-		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)particleCount);
-	
-		// ---------- Pass 3: CORE (regular alpha) ----------
-		glUniform1i(glGetUniformLocation(shaderProgram, "uDoGlow"), 0);
-		glUniform1f(glGetUniformLocation(shaderProgram, "uRadiusScale"), 1.0f);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)particleCount);
-	
-		glBindVertexArray(0);
-	}
+	)";
 
-	void Renderer::createGeometryGPU(GLuint particleBuffer) {
-		// A single quad's vertices. The vertex shader will scale and position it.
-		// We're using a triangle strip to draw the quad with 4 vertices.
-		static const float quadVertices[] = {
-			-1.0f, -1.0f, // bottom-left
-			 1.0f, -1.0f, // bottom-right
-			-1.0f,  1.0f, // top-left
-			 1.0f,  1.0f  // top-right
+	// Rank of each particle within its cell, written by the count pass and
+	// read by the scatter pass. Shares a binding with VelOut (unused there).
+	static const char* kParticleRankBlock = R"(
+		layout(std430, binding = 3) buffer ParticleRanks {
+			uint particleRank[];
 		};
+	)";
 
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+	// Pass 1: count particles per cell and remember each particle's rank.
+	static const char* kBinCount = R"(
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			if (i >= uint(uCount)) return;
 
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+			particleRank[i] = atomicAdd(cellStart[cellIndex(hot[i].xy)], 1u);
+		}
+	)";
+
+	// Pass 2: in-place exclusive prefix sum of the cell counts, plus the
+	// total in the extra last entry. A single 1024-wide workgroup; each thread
+	// serially sums a contiguous run of cells, the run totals are scanned in
+	// shared memory, then the runs are rewritten as offsets.
+	static const char* kBinScan = R"(
+		#version 430
+		layout(local_size_x = 1024) in;
 
-		// Wire the particle buffer as instanced attributes
-		glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
-		GLsizei stride = sizeof(GPUParticle);
+		layout(std430, binding = 5) buffer CellStarts {
+			uint cellStart[];
+		};
 
-		// aPosPx (loc=1): 2 floats at offset 0
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)GPU_PARTICLE_OFFSET(px));
-		glVertexAttribDivisor(1, 1);
+		layout(location = 0) uniform int uNumCells;
 
-		// aRadiusPx (loc=2): 1 float at offset offsetof(radius)
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void*)GPU_PARTICLE_OFFSET(radius));
-		glVertexAttribDivisor(2, 1);
+		shared uint runTotals[1024];
 
-		// aColor (loc=3): 3 floats at offset offsetof(r)
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)GPU_PARTICLE_OFFSET(r));
-		glVertexAttribDivisor(3, 1);
+		void main() {
+			uint t = gl_LocalInvocationID.x;
+			uint perThread = (uint(uNumCells) + 1023u) / 1024u;
+			uint begin = min(t * perThread, uint(uNumCells));
+			uint end = min(begin + perThread, uint(uNumCells));
 
-				glBindVertexArray(0);
-	}
+			uint sum = 0u;
+			for (uint c = begin; c < end; ++c) sum += cellStart[c];
+			runTotals[t] = sum;
+			memoryBarrierShared();
+			barrier();
 
-	void Renderer::dispatchComputeShader(GLuint particleBuffer, size_t particleCount, float deltaTime) {
-		glUseProgram(computeProgram);
+			// Hillis-Steele inclusive scan over the run totals
+			for (uint offset = 1u; offset < 1024u; offset <<= 1) {
+				uint v = (t >= offset) ? runTotals[t - offset] : 0u;
+				memoryBarrierShared();
+				barrier();
+				runTotals[t] += v;
+				memoryBarrierShared();
+				barrier();
+			}
 
-		// bind SSBO
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleBuffer);
+			uint running = runTotals[t] - sum;
+			for (uint c = begin; c < end; ++c) {
+				uint count = cellStart[c];
+				cellStart[c] = running;
+				running += count;
+			}
+			if (t == 1023u) cellStart[uNumCells] = runTotals[t];
+		}
+	)";
 
-		// Bind attraction matrix texture to texture unit 0
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, attractionTexture);
-		glUniform1i(glGetUniformLocation(computeProgram, "uAttractionMatrix"), 0);
-
-		// uniforms
-		glUniform1i(glGetUniformLocation(computeProgram, "uCount"), (GLint)particleCount);
-		glUniform1f(glGetUniformLocation(computeProgram, "uMaxDist"), 150.0f);
-		glUniform1f(glGetUniformLocation(computeProgram, "uRepelDist"), 30.0f);
-		glUniform1f(glGetUniformLocation(computeProgram, "uDt"), deltaTime);
-		glUniform1f(glGetUniformLocation(computeProgram, "uDamping"), 0.08f);
-		glUniform1f(glGetUniformLocation(computeProgram, "uForceScale"), 1.0f);
-
-		// dispatch
-		GLuint wg = 256;
-		GLuint numGroups = (GLuint)((particleCount + wg - 1) / wg);
-		glDispatchCompute(numGroups, 1, 1);
+	// Pass 3: scatter the hot stream and species into cell order.
+	static const char* kBinScatter = R"(
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			if (i >= uint(uCount)) return;
 
-		// ensure writes visible to vertex fetch
-		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
-	}
-}
- 
+			vec4 hi = hot[i];
+			uint slot = cellStart[cellIndex(hi.xy)] + particleRank[i];
+			sortedHot[slot] = hi;
+			atomicOr(sortedSpeciesWords[slot >> 2], uint(speciesOf(i)) << ((slot & 3u) * 8u));
+		}
+	)";
+
+	// Pass 4: forces from the 3x3 block of cells around each particle.
+	static const char* kComputeGrid = R"(
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			if (i >= uint(uCount)) return;
+
+			vec4 hi = hot[i];
+			int si  = speciesOf(i);
+			loadAttraction(si);
+
+			ivec2 ci = cellCoord(hi.xy);
+			ivec2 columns[2];
+			ivec2 rows[2];
+			float columnOffsets[2];
+			float rowOffsets[2];
+			int columnRuns = neighbourRuns(ci.x, uGridDim.x, uWorldSize.x, columns, columnOffsets);
+			int rowRuns = neighbourRuns(ci.y, uGridDim.y, uWorldSize.y, rows, rowOffsets);
+
+			vec2 dV = vec2(0.0);
+
+			for (int r = 0; r < rowRuns; ++r) {
+				for (int cy = rows[r].x; cy <= rows[r].y; ++cy) {
+					// cells of one row are contiguous in the sorted stream
+					uint rowBase = uint(cy * uGridDim.x);
+					for (int c = 0; c < columnRuns; ++c) {
+						vec2 xs = hi.xy + vec2(columnOffsets[c], rowOffsets[r]);
+						uint begin = cellStart[rowBase + uint(columns[c].x)];
+						uint end = cellStart[rowBase + uint(columns[c].y) + 1u];
+						for (uint k = begin; k < end; ++k) {
+							vec4 hk = sortedHot[k];
+							int sk = int((sortedSpeciesWords[k >> 2] >> ((k & 3u) * 8u)) & 0xFFu);
+							dV += pairForce(hk.xy - xs, hi.z, hi.w, si, hk.z, hk.w, sk);
+						}
+					}
+				}
+			}
+
+			integrate(i, hi, dV);
+		}
+	)";
+
+	// GPUParticle interchange record (std430 stride 64 bytes)
+	static const char* kInterchangeCommon = R"(
+		#version 430
+		layout(local_size_x = 256) in;
+
+		struct Particle {
+			vec2 pos;      // offset  0
+			vec2 vel;      // offset  8
+			float radius;  // offset 16
+			float mass;   // offset 20
+			vec2  acc;     // offset 24
+			vec4  color;   // offset 32  (16-byte aligned)
+			int   species; // offset 48
+			float _pad1;   // offset 52
+			vec2  _pad2;   // offset 56 -> total stride 64 bytes
+		};
+
+		layout(std430, binding = 0) buffer Hot {
+			vec4 hot[];
+		};
+
+		layout(std430, binding = 2) buffer Vel {
+			vec4 vel[];
+		};
+
+		layout(std430, binding = 4) buffer Species {
+			uint speciesWords[];
+		};
+
+		layout(std430, binding = 5) buffer Staging {
+			Particle staged[];
+		};
+
+		layout(std430, binding = 6) readonly buffer StagingIndex {
+			uint stagedIndex[];
+		};
+
+		layout(std430, binding = 7) buffer Colors {
+			vec4 color[];
+		};
+
+		layout(location = 0) uniform int uCount;   // records in the staging buffer
+		layout(location = 1) uniform int uIndexed; // 1: record k goes to stagedIndex[k], 0: to k
+	)";
+
+	// Staged GPUParticle records -> streams (uploads and respawns)
+	static const char* kUnpack = R"(
+		void main() {
+			uint k = gl_GlobalInvocationID.x;
+			if (k >= uint(uCount)) return;
+
+			uint i = (uIndexed != 0) ? stagedIndex[k] : k;
+			Particle q = staged[k];
+			hot[i] = vec4(q.pos, q.radius, q.mass);
+			vel[i] = vec4(q.vel, q.acc);
+			color[i] = q.color;
+
+			// other invocations may own the neighbouring bytes of this word
+			uint shift = (i & 3u) * 8u;
+			atomicAnd(speciesWords[i >> 2], ~(0xFFu << shift));
+			atomicOr(speciesWords[i >> 2], (uint(q.species) & 0xFFu) << shift);
+		}
+	)";
 
+	// Streams -> staged GPUParticle records (downloads)
+	static const char* kPack = R"(
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			if (i >= uint(uCount)) return;
+
+			vec4 h = hot[i];
+			int s = int((speciesWords[i >> 2] >> ((i & 3u) * 8u)) & 0xFFu);
+			vec4 v = vel[i];
+			staged[i] = Particle(h.xy, v.xy, h.z, h.w, v.zw, color[i], s, 0.0, vec2(0.0));
+		}
+	)";
+
+	// Fresh particles straight into the streams (resets): particle i is
+	// spawnRandomParticle(uKey.x, uKey.y, i, ...) from ParticleSpawner.h, bit
+	// for bit. Philox is integer arithmetic, and the float steps are one
+	// exact scaling and one correctly rounded product, as on the CPU.
+	static const char* kSpawn = R"(
+		layout(local_size_x = 256) in;
+
+		layout(std430, binding = 0) writeonly buffer Hot {
+			vec4 hot[];
+		};
+
+		layout(std430, binding = 2) writeonly buffer Vel {
+			vec4 vel[];
+		};
+
+		layout(std430, binding = 4) buffer Species {
+			uint speciesWords[]; // cleared by the caller
+		};
+
+		layout(std430, binding = 7) writeonly buffer Colors {
+			vec4 color[];
+		};
+
+		layout(location = 0) uniform int uCount;
+		layout(location = 1) uniform uvec2 uKey;   // (seed, generation)
+		layout(location = 2) uniform vec2 uWorld;  // world extent
+		layout(location = 3) uniform int uSpeciesCount;
+		layout(location = 4) uniform vec4 uSpeciesColor[MAX_SPECIES];
+		layout(location = SPECIES_BODY_LOCATION) uniform vec2 uSpeciesBody[MAX_SPECIES]; // radius, mass
+
+		uvec4 philox4x32(uvec4 c, uvec2 k) {
+			for (int round = 0; round < 10; ++round) {
+				if (round > 0) k += uvec2(0x9E3779B9u, 0xBB67AE85u);
+				uint hi0, lo0, hi1, lo1;
+				umulExtended(0xD2511F53u, c.x, hi0, lo0);
+				umulExtended(0xCD9E8D57u, c.z, hi1, lo1);
+				c = uvec4(hi1 ^ c.y ^ k.x, lo1, hi0 ^ c.w ^ k.y, lo0);
+			}
+			return c;
+		}
+
+		float unitFloat(uint bits) {
+			return float(bits >> 8u) * (1.0 / 16777216.0);
+		}
+
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			if (i >= uint(uCount)) return;
+
+			uvec4 bits = philox4x32(uvec4(i, 0u, 0u, 0u), uKey);
+			uint species, lo;
+			umulExtended(bits.x, uint(uSpeciesCount), species, lo);
+			precise vec2 pos = vec2(unitFloat(bits.y), unitFloat(bits.z)) * uWorld;
+
+			vec2 body = uSpeciesBody[species];
+			hot[i] = vec4(pos, body.x, body.y);
+			vel[i] = vec4(0.0);
+			color[i] = uSpeciesColor[species];
+			atomicOr(speciesWords[i >> 2], species << ((i & 3u) * 8u));
+		}
+	)";
+
+	// Front positions -> 16-bit fixed point per axis, x | (y << 16), for
+	// the trajectory recorder. Multiplying by a precomputed scale (rather
+	// than dividing by the extent) keeps the result identical to
+	// quantizePosition() on the CPU.
+	static const char* kQuantizePositions = R"(
+		#version 430
+		layout(local_size_x = 256) in;
+
+		layout(std430, binding = 0) readonly buffer Hot {
+			vec4 hot[];
+		};
+
+		layout(std430, binding = 5) writeonly buffer Quantized {
+			uint quantized[];
+		};
+
+		layout(location = 0) uniform int uCount;
+		layout(location = 1) uniform vec2 uScale; // 65535 / world extent
+
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			if (i >= uint(uCount)) return;
+
+			uvec2 q = uvec2(floor(clamp(hot[i].xy * uScale, 0.0, 65535.0) + 0.5));
+			quantized[i] = q.x | (q.y << 16);
+		}
+	)";
+
+	// Density splat (DrawMode::DensitySplat). Every particle adds its colour
+	// and disc area to the cell of SPLAT_CELL_PX pixels it lies in, as
+	// fixed-point sums (1/SPLAT_SCALE units) so the atomics stay integer;
+	// the resolve pass turns the sums into a density texture and blurs them
+	// horizontally, the blur pass vertically into the glow texture. Both
+	// Gaussians are GLOW_TAPS cells wide on either side of the centre.
+	static const char* kSplatCommon = R"(
+		layout(std430, binding = 5) buffer Splat {
+			uint splat[]; // per cell: colour * radius^2 (rgb), radius^2
+		};
+
+		layout(location = 1) uniform ivec2 uSplatSize;
+
+		float glowWeight(int d) {
+			float x = float(d) / GLOW_SIGMA;
+			return exp(-0.5 * x * x);
+		}
+
+		float glowNorm() {
+			float sum = 0.0;
+			for (int d = -GLOW_TAPS; d <= GLOW_TAPS; ++d) sum += glowWeight(d);
+			return 1.0 / sum;
+		}
+	)";
+
+	static const char* kSplatParticles = R"(
+		layout(local_size_x = 256) in;
+
+		layout(std430, binding = 0) readonly buffer Hot {
+			vec4 hot[];
+		};
+
+		layout(std430, binding = 7) readonly buffer Colors {
+			vec4 colors[];
+		};
+
+		layout(location = 0) uniform int uCount;
+
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			if (i >= uint(uCount)) return;
+
+			vec4 p = hot[i];
+			ivec2 cell = ivec2(floor(p.xy / SPLAT_CELL_PX));
+			if (any(lessThan(cell, ivec2(0))) || any(greaterThanEqual(cell, uSplatSize))) return;
+
+			float area = p.z * p.z * SPLAT_SCALE;
+			uvec3 c = uvec3(clamp(colors[i].rgb, 0.0, 1.0) * area + 0.5);
+			uint base = 4u * uint(cell.y * uSplatSize.x + cell.x);
+			if (c.r != 0u) atomicAdd(splat[base], c.r);
+			if (c.g != 0u) atomicAdd(splat[base + 1u], c.g);
+			if (c.b != 0u) atomicAdd(splat[base + 2u], c.b);
+			atomicAdd(splat[base + 3u], uint(area + 0.5));
+		}
+	)";
+
+	static const char* kSplatResolve = R"(
+		layout(local_size_x = 16, local_size_y = 16) in;
+
+		layout(rgba16f, binding = 0) writeonly uniform image2D uDensity; // mean colour, disc coverage
+		layout(rgba32f, binding = 1) writeonly uniform image2D uBlurX;
+
+		vec4 cellSum(int x, int y) {
+			uint base = 4u * uint(y * uSplatSize.x + x);
+			return vec4(splat[base], splat[base + 1u], splat[base + 2u], splat[base + 3u]) / SPLAT_SCALE;
+		}
+
+		void main() {
+			ivec2 cell = ivec2(gl_GlobalInvocationID.xy);
+			if (any(greaterThanEqual(cell, uSplatSize))) return;
+
+			vec4 own = cellSum(cell.x, cell.y);
+			float coverage = 3.14159265 * own.a / (SPLAT_CELL_PX * SPLAT_CELL_PX);
+			imageStore(uDensity, cell, vec4(own.rgb / max(own.a, 1e-6), min(coverage, 1024.0)));
+
+			vec3 sum = vec3(0.0);
+			for (int d = -GLOW_TAPS; d <= GLOW_TAPS; ++d) {
+				int x = cell.x + d;
+				if (x < 0 || x >= uSplatSize.x) continue;
+				sum += glowWeight(d) * cellSum(x, cell.y).rgb;
+			}
+			imageStore(uBlurX, cell, vec4(sum * glowNorm(), 0.0));
+		}
+	)";
+
+	static const char* kSplatBlur = R"(
+		layout(local_size_x = 16, local_size_y = 16) in;
+
+		layout(rgba32f, binding = 1) readonly uniform image2D uBlurX;
+		layout(rgba16f, binding = 2) writeonly uniform image2D uGlow;
+
+		layout(location = 2) uniform float uGlowScale; // glow per unit of colour * radius^2 in a cell
+
+		void main() {
+			ivec2 cell = ivec2(gl_GlobalInvocationID.xy);
+			if (any(greaterThanEqual(cell, uSplatSize))) return;
+
+			vec3 sum = vec3(0.0);
+			for (int d = -GLOW_TAPS; d <= GLOW_TAPS; ++d) {
+				int y = cell.y + d;
+				if (y < 0 || y >= uSplatSize.y) continue;
+				sum += glowWeight(d) * imageLoad(uBlurX, ivec2(cell.x, y)).rgb;
+			}
+			imageStore(uGlow, cell, vec4(min(sum * glowNorm() * uGlowScale, vec3(64.0)), 0.0));
+		}
+	)";
+
+	// Metrics (see Metrics.h). The passes run on the current front streams
+	// after a fresh binning and only ever write the metrics buffer and
+	// the union-find scratch, so they can run between any two steps.
+	// The metrics buffer is laid out as MetricsHeader followed by one
+	// SpeciesTotals per species; 64-bit fields are (low, high) word pairs.
+	static const char* kMetricsCommon = R"(
+		layout(std430, binding = 1) coherent buffer Metrics {
+			uint metrics[];
+		};
+
+		// Union-find parent of every sorted slot
+		layout(std430, binding = 3) coherent buffer ClusterParents {
+			uint clusterParent[];
+		};
+
+		// Word offsets into the metrics buffer
+		const uint kKineticEnergyWord = 0u;
+		const uint kWithNeighbourWord = 2u;
+		const uint kMixedNeighbourWord = 3u;
+		const uint kLargestClusterWord = 4u;
+		const uint kClusterSizesWord = 6u;
+		const uint kSpeciesWord = 38u;
+		const uint kSpeciesWords = 8u; // count, pad, sumX, sumY, sumSquares
+
+		// Exact 64-bit atomic addition: the carry out of the low word joins
+		// the high word, so the total is the same in any order
+		void addWide(uint at, uint lo, uint hi) {
+			uint previous = atomicAdd(metrics[at], lo);
+			atomicAdd(metrics[at + 1u], hi + ((previous + lo < previous) ? 1u : 0u));
+		}
+
+		// Splits the path on the way, as findRoot() in CpuSimulator.cpp
+		uint findRoot(uint x) {
+			uint p = clusterParent[x];
+			while (p != x) {
+				uint grandparent = clusterParent[p];
+				if (grandparent != p) clusterParent[x] = grandparent;
+				x = p;
+				p = grandparent;
+			}
+			return x;
+		}
+	)";
+
+	// Component size per root slot; the count and scatter passes are done
+	// with the rank buffer by then, so it holds these
+	static const char* kClusterSizeBlock = R"(
+		layout(std430, binding = 5) buffer ClusterSizes {
+			uint clusterSize[];
+		};
+	)";
+
+	// Nearest-neighbour key per sorted slot (metricsNeighbourKey() in
+	// Metrics.h), cleared to kNoNeighbourKey. Shares a binding with VelIn,
+	// which the neighbour and cluster passes do not read.
+	static const char* kNearestKeyBlock = R"(
+		layout(std430, binding = 2) buffer NearestKeys {
+			uint nearestKey[];
+		};
+
+		const uint kNoNeighbourKey = 0xFFFFFFFFu;
+		const uint kSpeciesMask = 63u; // kMetricsSpeciesBits
+	)";
+
+	// Metrics pass 1, per particle: kinetic energy and species sums, summed
+	// per workgroup in shared memory before one global addition per field.
+	// Also makes every slot its own component for pass 2.
+	static const char* kMetricsSums = R"(
+		// SpeciesTotals words of every species, then the kinetic energy pair
+		shared uint groupTotals[NUM_SPECIES * 8 + 2];
+
+		void addGroupWide(uint at, uint lo, uint hi) {
+			uint previous = atomicAdd(groupTotals[at], lo);
+			atomicAdd(groupTotals[at + 1u], hi + ((previous + lo < previous) ? 1u : 0u));
+		}
+
+		// metricsPosition() in Metrics.h
+		int fixedPosition(float x) {
+			return int(clamp(floor(x * 16.0 + 0.5), -16777216.0, 16777216.0));
+		}
+
+		void addSquare(uint at, int q) {
+			uint high, low;
+			umulExtended(uint(abs(q)), uint(abs(q)), high, low);
+			addGroupWide(at, low, high);
+		}
+
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			uint lid = gl_LocalInvocationID.x;
+			const uint energyWord = uint(NUM_SPECIES) * kSpeciesWords;
+			for (uint w = lid; w < energyWord + 2u; w += 256u) {
+				groupTotals[w] = 0u;
+			}
+			memoryBarrierShared();
+			barrier();
+
+			if (i < uint(uCount)) {
+				vec4 h = hot[i];
+				vec4 v = vel[i];
+
+				// metricsEnergy() in Metrics.h
+				precise float e = 0.5 * h.w * (v.x * v.x + v.y * v.y) * 65536.0;
+				e = clamp(e, 0.0, 281474976710656.0);
+				uint energyHigh = uint(e / 4294967296.0);
+				uint energyLow = uint(e - float(energyHigh) * 4294967296.0);
+				addGroupWide(energyWord, energyLow, energyHigh);
+
+				int qx = fixedPosition(h.x);
+				int qy = fixedPosition(h.y);
+				uint base = uint(speciesOf(i)) * kSpeciesWords;
+				atomicAdd(groupTotals[base], 1u);
+				addGroupWide(base + 2u, uint(qx), qx < 0 ? 0xFFFFFFFFu : 0u);
+				addGroupWide(base + 4u, uint(qy), qy < 0 ? 0xFFFFFFFFu : 0u);
+				addSquare(base + 6u, qx);
+				addSquare(base + 6u, qy);
+
+				clusterParent[i] = i;
+				clusterSize[i] = 0u;
+			}
+			memoryBarrierShared();
+			barrier();
+
+			// Word pairs; a count and its padding word form one as well
+			for (uint w = 2u * lid; w < energyWord + 2u; w += 512u) {
+				uint lo = groupTotals[w];
+				uint hi = groupTotals[w + 1u];
+				if ((lo | hi) != 0u) {
+					addWide(w == energyWord ? kKineticEnergyWord : kSpeciesWord + w, lo, hi);
+				}
+			}
+		}
+	)";
+
+	// Metrics pass 2, per sorted slot: every pair within the radius, once,
+	// from its higher slot. Lowers the nearest-neighbour key of both ends
+	// (ties go to the smaller species id, so the visiting order does not
+	// matter) and unites them lock-free: the larger root is hooked under the
+	// smaller, so parents only ever decrease.
+	static const char* kMetricsNeighbours = R"(
+		layout(location = 2) uniform float uRadiusSquared;
+		layout(location = 3) uniform float uRadius;
+
+		void unite(uint a, uint b) {
+			for (;;) {
+				a = findRoot(a);
+				b = findRoot(b);
+				if (a == b) return;
+				uint high = max(a, b);
+				uint low = min(a, b);
+				uint previous = atomicCompSwap(clusterParent[high], high, low);
+				if (previous == high) return;
+				a = previous; // the parent it was hooked under meanwhile
+				b = low;
+			}
+		}
+
+		// Mirrors reachedRuns(): the runs of neighbourRuns() that the
+		// radius reaches from coordinate p
+		int reachedRuns(float p, float size, int c, int cells, float period, out ivec2 runs[2], out float offsets[2]) {
+			float reach = uRadius + size * (1.0 / 1024.0);
+			int low = int(clamp(floor((p - reach) / size), float(c - 1), float(c)));
+			int high = int(clamp(floor((p + reach) / size), float(c), float(c + 1)));
+			runs[1] = ivec2(0, -1);
+			offsets[1] = 0.0;
+			if (uBoundary == 1) { // Boundary::Torus
+				if (low < 0) {
+					runs[0] = ivec2(cells - 1);
+					offsets[0] = period;
+					runs[1] = ivec2(0, high);
+					return 2;
+				}
+				if (high == cells) {
+					runs[0] = ivec2(low, cells - 1);
+					offsets[0] = 0.0;
+					runs[1] = ivec2(0);
+					offsets[1] = -period;
+					return 2;
+				}
+			}
+			runs[0] = ivec2(max(low, 0), min(high, cells - 1));
+			offsets[0] = 0.0;
+			return 1;
+		}
+
+		void main() {
+			uint slot = gl_GlobalInvocationID.x;
+			if (slot >= uint(uCount)) return;
+
+			vec2 xs = sortedHot[slot].xy;
+			uint ss = (sortedSpeciesWords[slot >> 2] >> ((slot & 3u) * 8u)) & 0xFFu;
+			ivec2 ci = cellCoord(xs);
+			ivec2 columns[2];
+			ivec2 rows[2];
+			float columnOffsets[2];
+			float rowOffsets[2];
+			int columnRuns = reachedRuns(xs.x, uCellSize.x, ci.x, uGridDim.x, uWorldSize.x, columns, columnOffsets);
+			int rowRuns = reachedRuns(xs.y, uCellSize.y, ci.y, uGridDim.y, uWorldSize.y, rows, rowOffsets);
+
+			uint ownKey = kNoNeighbourKey;
+			for (int r = 0; r < rowRuns; ++r) {
+				for (int cy = rows[r].x; cy <= rows[r].y; ++cy) {
+					uint rowBase = uint(cy * uGridDim.x);
+					for (int c = 0; c < columnRuns; ++c) {
+						vec2 offset = vec2(columnOffsets[c], rowOffsets[r]);
+						uint begin = cellStart[rowBase + uint(columns[c].x)];
+						uint end = min(cellStart[rowBase + uint(columns[c].y) + 1u], slot);
+						for (uint k = begin; k < end; ++k) {
+							// The same operations as the CPU filter. Each invocation
+							// runs ahead to its next pair within the radius, so
+							// those of a group settle their pairs together.
+							precise vec2 d = (sortedHot[k].xy - xs) - offset;
+							precise float d2 = d.x * d.x + d.y * d.y;
+							while (!(d2 <= uRadiusSquared) && ++k < end) {
+								d = (sortedHot[k].xy - xs) - offset;
+								d2 = d.x * d.x + d.y * d.y;
+							}
+							if (k == end) break;
+
+							uint distanceBits = floatBitsToUint(d2) & ~kSpeciesMask;
+							uint sk = (sortedSpeciesWords[k >> 2] >> ((k & 3u) * 8u)) & 0xFFu;
+							ownKey = min(ownKey, distanceBits | sk);
+							atomicMin(nearestKey[k], distanceBits | ss);
+							unite(slot, k);
+						}
+					}
+				}
+			}
+			if (ownKey != kNoNeighbourKey) atomicMin(nearestKey[slot], ownKey);
+		}
+	)";
+
+	// Prologue of the cluster passes, which need neither the particle
+	// streams nor the simulation constants
+	static const char* kClusterCommon = R"(
+		#version 430
+		layout(local_size_x = 256) in;
+
+		layout(location = 0) uniform int uCount;
+	)";
+
+	// Metrics pass 3, per sorted slot: component sizes, counted at the
+	// roots, and the particles with a neighbour, by its species
+	static const char* kClusterRoots = R"(
+		layout(std430, binding = 7) readonly buffer SortedSpecies {
+			uint sortedSpeciesWords[];
+		};
+
+		shared uint groupWithNeighbour;
+		shared uint groupMixedNeighbour;
+
+		void main() {
+			uint slot = gl_GlobalInvocationID.x;
+			if (gl_LocalInvocationID.x == 0u) {
+				groupWithNeighbour = 0u;
+				groupMixedNeighbour = 0u;
+			}
+			memoryBarrierShared();
+			barrier();
+
+			if (slot < uint(uCount)) {
+				atomicAdd(clusterSize[findRoot(slot)], 1u);
+				uint key = nearestKey[slot];
+				if (key != kNoNeighbourKey) {
+					atomicAdd(groupWithNeighbour, 1u);
+					uint ss = (sortedSpeciesWords[slot >> 2] >> ((slot & 3u) * 8u)) & 0xFFu;
+					if ((key & kSpeciesMask) != ss) atomicAdd(groupMixedNeighbour, 1u);
+				}
+			}
+			memoryBarrierShared();
+			barrier();
+
+			if (gl_LocalInvocationID.x == 0u) {
+				if (groupWithNeighbour != 0u) atomicAdd(metrics[kWithNeighbourWord], groupWithNeighbour);
+				if (groupMixedNeighbour != 0u) atomicAdd(metrics[kMixedNeighbourWord], groupMixedNeighbour);
+			}
+		}
+	)";
+
+	// Metrics pass 4, per sorted slot: size histogram and largest component
+	// over the roots
+	static const char* kClusterStats = R"(
+		shared uint groupSizes[32];
+		shared uint groupLargest;
+
+		void main() {
+			uint slot = gl_GlobalInvocationID.x;
+			uint lid = gl_LocalInvocationID.x;
+			if (lid < 32u) groupSizes[lid] = 0u;
+			if (lid == 0u) groupLargest = 0u;
+			memoryBarrierShared();
+			barrier();
+
+			if (slot < uint(uCount) && clusterParent[slot] == slot) {
+				uint size = clusterSize[slot];
+				atomicAdd(groupSizes[findMSB(size)], 1u);
+				atomicMax(groupLargest, size);
+			}
+			memoryBarrierShared();
+			barrier();
+
+			if (lid < 32u && groupSizes[lid] != 0u) atomicAdd(metrics[kClusterSizesWord + lid], groupSizes[lid]);
+			if (lid == 0u && groupLargest != 0u) atomicMax(metrics[kLargestClusterWord], groupLargest);
+		}
+	)";
+
+	void Renderer::createAttractionTexture() {
+		// Create and configure the texture
+		glGenTextures(1, &attractionTexture);
+		glBindTexture(GL_TEXTURE_2D, attractionTexture);
+		
+		// An numSpecies x numSpecies R32F texture, filled by setAttractionMatrix()
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, numSpecies, numSpecies, 0, GL_RED, GL_FLOAT, nullptr);
+		
+		// Set texture parameters for exact pixel sampling
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		
+		glBindTexture(GL_TEXTURE_2D, 0);
+		setAttractionMatrix(Color::attractionMatrix);
+	}
+
+	void Renderer::setAttractionMatrix(const Color::AttractionMatrix& matrix) {
+		glBindTexture(GL_TEXTURE_2D, attractionTexture);
+
+		// A new species count resizes the texture and respecialises the kernels
+		const int count = Color::speciesCount(matrix);
+		if (count != numSpecies) {
+			numSpecies = count;
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, numSpecies, numSpecies, 0, GL_RED, GL_FLOAT, nullptr);
+			createPhysicsPrograms();
+		}
+
+		// Row from of the matrix is texture row from
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, numSpecies, numSpecies, GL_RED, GL_FLOAT, matrix.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// The simulation constants, with force cells at least uMaxDist wide covering the world
+	Renderer::SimulationBlock Renderer::currentSimulationBlock() const {
+		static_assert(sizeof(SimulationBlock) == 64, "std140 layout of SimulationBlock");
+		const GridLayout layout = gridLayout(worldWidth, worldHeight, simParams.maxDist, simParams.boundary);
+
+		SimulationBlock block {};
+		block.maxDist = simParams.maxDist;
+		block.repelDist = simParams.repelDist;
+		block.damping = simParams.damping;
+		block.forceScale = simParams.forceScale;
+		block.gridDim[0] = layout.width;
+		block.gridDim[1] = layout.height;
+		block.cellSize[0] = layout.cellWidth;
+		block.cellSize[1] = layout.cellHeight;
+		block.worldSize[0] = worldWidth;
+		block.worldSize[1] = worldHeight;
+		block.referenceDt = kReferenceDt;
+		block.integrator = (GLint)simParams.integrator;
+		block.boundary = (GLint)simParams.boundary;
+		return block;
+	}
+
+	// The bindings are made on every step: other renderers or contexts may
+	// have rebound them, and two binds per step cost nothing measurable.
+	// Only the block's contents are cached, as uploads are not free.
+	void Renderer::bindSimulationState() {
+		glActiveTexture(GL_TEXTURE0 + kAttractionUnit);
+		glBindTexture(GL_TEXTURE_2D, attractionTexture);
+		glActiveTexture(GL_TEXTURE0);
+
+		const SimulationBlock block = currentSimulationBlock();
+		if (!simulationBlockBuffer) {
+			glGenBuffers(1, &simulationBlockBuffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, simulationBlockBuffer);
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(SimulationBlock), &block, GL_DYNAMIC_DRAW);
+			simulationBlock = block;
+		} else if (std::memcmp(&block, &simulationBlock, sizeof(block)) != 0) {
+			glBindBuffer(GL_UNIFORM_BUFFER, simulationBlockBuffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SimulationBlock), &block);
+			simulationBlock = block;
+		}
+
+		glBindBufferBase(GL_UNIFORM_BUFFER, kSimulationBlockBinding, simulationBlockBuffer);
+	}
+
+	static GLuint linkCompute(const std::string& src, const char* name){
+		GLuint cs = compile(GL_COMPUTE_SHADER, src.c_str());
+		GLuint program = glCreateProgram();
+		glAttachShader(program, cs);
+		glLinkProgram(program);
+		GLint ok=0; glGetProgramiv(program, GL_LINK_STATUS, &ok);
+		if(!ok){
+			char log[1024]; GLsizei n=0; glGetProgramInfoLog(program, 1024, &n, log);
+			fprintf(stderr, "Compute program '%s' link error: %s\n", name, log);
+		}
+		glDeleteShader(cs);
+		return program;
+	}
+
+	void Renderer::createComputeShader(){
+		createPhysicsPrograms();
+		const std::string interchange = kInterchangeCommon;
+		binScanProgram = linkCompute(kBinScan, "bin scan");
+		unpackProgram = linkCompute(interchange + kUnpack, "unpack");
+		packProgram = linkCompute(interchange + kPack, "pack");
+		quantizeProgram = linkCompute(kQuantizePositions, "quantize positions");
+		spawnProgram = linkCompute(std::string("#version 430\n") +
+			"#define MAX_SPECIES " + std::to_string(Color::MAX_SPECIES) + "\n" +
+			"#define SPECIES_BODY_LOCATION " + std::to_string(kSpeciesBodyLocation) + "\n" + kSpawn, "spawn");
+		const std::string cluster = std::string(kClusterCommon) + kMetricsCommon + kClusterSizeBlock;
+		clusterRootProgram = linkCompute(cluster + kNearestKeyBlock + kClusterRoots, "cluster roots");
+		clusterStatsProgram = linkCompute(cluster + kClusterStats, "cluster stats");
+		const std::string splat = std::string("#version 430\n") +
+			"#define SPLAT_CELL_PX " + std::to_string(kSplatCellPx) + ".0\n" +
+			"#define SPLAT_SCALE " + std::to_string(kSplatScale) + "\n" +
+			"#define GLOW_TAPS " + std::to_string(kGlowTaps) + "\n" +
+			"#define GLOW_SIGMA " + std::to_string(kGlowSigma) + "\n" + kSplatCommon;
+		splatProgram = linkCompute(splat + kSplatParticles, "density splat");
+		splatResolveProgram = linkCompute(splat + kSplatResolve, "splat resolve");
+		splatBlurProgram = linkCompute(splat + kSplatBlur, "splat blur");
+	}
+
+	// Programs built on kComputeCommon, specialised for numSpecies
+	void Renderer::createPhysicsPrograms(){
+		for (GLuint* program : { &computeProgram, &tiledComputeProgram, &gridComputeProgram,
+		                         &binCountProgram, &binScatterProgram,
+		                         &metricsSumsProgram, &metricsNeighbourProgram }) {
+			if (*program) glDeleteProgram(*program);
+		}
+
+		const std::string header = std::string(kComputeVersion) +
+			"#define NUM_SPECIES " + std::to_string(numSpecies) + "\n" +
+			"#define MAX_UNROLLED_SPECIES " + std::to_string(Color::MAX_UNROLLED_SPECIES) + "\n";
+		const std::string common = header + kComputeCommon;
+		const std::string grid = common + kGridCommon;
+		computeProgram = linkCompute(common + kComputeBruteForce, "brute force");
+		tiledComputeProgram = linkCompute(header + "#define SHARED_ATTRACTION\n" + kComputeCommon + kComputeTiled, "tiled");
+		gridComputeProgram = linkCompute(grid + kComputeGrid, "grid");
+		binCountProgram = linkCompute(grid + kParticleRankBlock + kBinCount, "bin count");
+		binScatterProgram = linkCompute(grid + kParticleRankBlock + kBinScatter, "bin scatter");
+		metricsSumsProgram = linkCompute(common + kMetricsCommon + kClusterSizeBlock + kMetricsSums, "metrics sums");
+		metricsNeighbourProgram = linkCompute(grid + kMetricsCommon + kNearestKeyBlock + kMetricsNeighbours,
+			"metrics neighbours");
+	}
+
+	// (Re)allocates an SSBO with undefined contents
+	static void allocateStorage(GLuint& buffer, size_t bytes) {
+		if (!buffer) glGenBuffers(1, &buffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)bytes, nullptr, GL_DYNAMIC_COPY);
+	}
+
+	static void clearStorage(GLuint buffer, size_t words, GLuint value = 0) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, (GLsizeiptr)(words * sizeof(GLuint)),
+							 GL_RED_INTEGER, GL_UNSIGNED_INT, &value);
+	}
+
+	static GLuint workGroupsFor(size_t count) {
+		const size_t wg = 256;
+		return (GLuint)((count + wg - 1) / wg);
+	}
+
+	void Renderer::allocateParticleStreams(size_t particleCount) {
+		for (int b = 0; b < 2; ++b) {
+			allocateStorage(hotBuffers[b], particleCount * kHotStride);
+			allocateStorage(velBuffers[b], particleCount * kVelStride);
+		}
+		allocateStorage(speciesBuffer, speciesWords(particleCount) * sizeof(GLuint));
+		allocateStorage(colorBuffer, particleCount * kColorStride);
+		frontBuffer = 0;
+		particleCapacity = particleCount;
+	}
+
+	void Renderer::ensureStagingCapacity(size_t recordCount) {
+		if (recordCount <= stagingCapacity) return;
+		allocateStorage(stagingBuffer, recordCount * sizeof(GPUParticle));
+		allocateStorage(stagingIndexBuffer, recordCount * sizeof(GLuint));
+		stagingIndices.reserve(recordCount);
+		stagingCapacity = recordCount;
+	}
+
+	void Renderer::bindInterchangeBuffers() {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kHotIn, hotBuffers[frontBuffer]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kVelIn, velBuffers[frontBuffer]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSpeciesIn, speciesBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kStaging, stagingBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kStagingIndex, stagingIndexBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kColor, colorBuffer);
+	}
+
+	void Renderer::dispatchUnpack(size_t recordCount, bool indexed) {
+		bindInterchangeBuffers();
+		glUseProgram(unpackProgram);
+		glUniform1i(kCountLocation, (GLint)recordCount);
+		glUniform1i(kIndexedLocation, indexed ? 1 : 0);
+		glDispatchCompute(workGroupsFor(recordCount), 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	}
+
+	void Renderer::initializeGPUBuffer(const std::vector<GPUParticle>& initialParticles) {
+		allocateParticleStreams(initialParticles.size());
+		uploadParticles(initialParticles);
+	}
+
+	void Renderer::uploadParticles(const std::vector<GPUParticle>& particles) {
+		uploadParticles(particles.data(), particles.size());
+	}
+
+	void Renderer::uploadParticles(const GPUParticle* particles, size_t count) {
+		if (count == 0) return;
+		if (count > particleCapacity) {
+			allocateParticleStreams(count);
+		}
+		ensureStagingCapacity(count);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, stagingBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GPUParticle), particles);
+		dispatchUnpack(count, false);
+		lastStepInput = -1;
+	}
+
+	void Renderer::writeParticles(const size_t* indices, const GPUParticle* values, size_t count) {
+		if (count == 0) return;
+		ensureStagingCapacity(count);
+
+		// Narrowed into reused scratch and uploaded like the records: the
+		// copy is queued, so the CPU never waits for the previous indexed
+		// unpack to finish reading the index buffer
+		stagingIndices.assign(indices, indices + count);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, stagingIndexBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GLuint), stagingIndices.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, stagingBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GPUParticle), values);
+		dispatchUnpack(count, true);
+		// The species stream is shared by both stream pairs
+		lastStepInput = -1;
+	}
+
+	void Renderer::spawnParticles(size_t count, float worldWidth, float worldHeight, uint32_t seed) {
+		if (count == 0) return;
+		if (count > particleCapacity) {
+			allocateParticleStreams(count);
+		}
+		clearStorage(speciesBuffer, speciesWords(count));
+		lastStepInput = -1;
+
+		const SpeciesTable& table = speciesTable(numSpecies);
+		GLfloat colors[Color::MAX_SPECIES][4];
+		GLfloat bodies[Color::MAX_SPECIES][2];
+		for (int s = 0; s < table.count; ++s) {
+			const SpeciesTraits& traits = table.traits[s];
+			colors[s][0] = traits.color.r;
+			colors[s][1] = traits.color.g;
+			colors[s][2] = traits.color.b;
+			colors[s][3] = 1.0f;
+			bodies[s][0] = traits.radius;
+			bodies[s][1] = traits.mass;
+		}
+
+		bindInterchangeBuffers();
+		glUseProgram(spawnProgram);
+		glUniform1i(kCountLocation, (GLint)count);
+		glUniform2ui(kSpawnKeyLocation, seed, RESET_GENERATION);
+		glUniform2f(kWorldLocation, worldWidth, worldHeight);
+		glUniform1i(kSpeciesCountLocation, table.count);
+		glUniform4fv(kSpeciesColorLocation, table.count, &colors[0][0]);
+		glUniform2fv(kSpeciesBodyLocation, table.count, &bodies[0][0]);
+		glDispatchCompute(workGroupsFor(count), 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	}
+
+	void Renderer::dispatchPack(size_t recordCount) {
+		ensureStagingCapacity(recordCount);
+		bindInterchangeBuffers();
+		glUseProgram(packProgram);
+		glUniform1i(kCountLocation, (GLint)recordCount);
+		glDispatchCompute(workGroupsFor(recordCount), 1, 1);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	}
+
+	void Renderer::downloadParticles(std::vector<GPUParticle>& particles) {
+		if (particles.empty()) return;
+		dispatchPack(particles.size());
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, stagingBuffer);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, particles.size() * sizeof(GPUParticle), particles.data());
+	}
+
+	bool Renderer::requestReadback(size_t particleCount) {
+		if (particleReadback.full() || particleCount == 0) return false;
+		dispatchPack(particleCount);
+
+		// The staging buffer is reused by the next upload, so the records
+		// are copied out to a buffer only the readback touches
+		const size_t bytes = particleCount * sizeof(GPUParticle);
+		glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, particleReadback.buffer(bytes));
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)bytes);
+		particleReadback.submit(bytes, 0);
+		return true;
+	}
+
+	bool Renderer::pollReadback(std::vector<GPUParticle>& particles) {
+		return particleReadback.poll(false, [&](const void* data, size_t bytes, uint64_t) {
+			particles.resize(bytes / sizeof(GPUParticle));
+			std::memcpy(particles.data(), data, bytes);
+		});
+	}
+
+	bool Renderer::requestPositions(size_t particleCount, uint64_t step, float worldWidth, float worldHeight) {
+		if (positionReadback.full() || particleCount == 0) return false;
+
+		// The pass writes straight into the slot, so only 4 bytes per
+		// particle ever cross the bus
+		const size_t bytes = particleCount * sizeof(GLuint);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kHotIn, hotBuffers[frontBuffer]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kQuantized, positionReadback.buffer(bytes));
+		glUseProgram(quantizeProgram);
+		glUniform1i(kCountLocation, (GLint)particleCount);
+		glUniform2f(kScaleLocation, 65535.0f / worldWidth, 65535.0f / worldHeight);
+		glDispatchCompute(workGroupsFor(particleCount), 1, 1);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		positionReadback.submit(bytes, step);
+		return true;
+	}
+
+	bool Renderer::pollPositions(std::vector<uint32_t>& quantized, uint64_t& step, bool wait) {
+		return positionReadback.poll(wait, [&](const void* data, size_t bytes, uint64_t tag) {
+			quantized.resize(bytes / sizeof(GLuint));
+			std::memcpy(quantized.data(), data, bytes);
+			step = tag;
+		});
+	}
+
+	void Renderer::drawPointsGPU(size_t particleCount) {
+		if (particleCount == 0) return;
+		const bool splat = drawMode == DrawMode::DensitySplat;
+		if (splat) drawSplatGlow(particleCount);
+	
+		glBindVertexArray(vao);
+		// Instance attributes follow whichever buffers hold the latest step
+		glBindVertexBuffer(kHotBinding, hotBuffers[frontBuffer], 0, kHotStride);
+		glBindVertexBuffer(kColorBinding, colorBuffer, 0, kColorStride);
+		if (drawMode == DrawMode::SinglePass) {
+			drawSinglePass(particleCount);
+			glBindVertexArray(0);
+			return;
+		}
+		glUseProgram(shaderProgram);
+		glUniform1f(drawUniforms.cullCoverage, splat ? kCoreCullCoverage : 0.0f);
+	
+		// ---------- Passes 1 and 2: OUTER and INNER GLOW ----------
+		if (!splat) {
+			glUniform1i(drawUniforms.doGlow, 1);
+			glBlendFunc(GL_ONE, GL_ONE);
+			for (const GlowPass& pass : kGlowPasses) {
+				glUniform1f(drawUniforms.radiusScale, pass.radiusScale);
+				glUniform1f(drawUniforms.glowSharpness, pass.sharpness);
+				glUniform1f(drawUniforms.glowIntensity, pass.intensity);
+				PROFILE_SCOPE(profiler, pass.name);
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)particleCount);
+			}
+		}
+	
+		// ---------- Pass 3: CORE (regular alpha) ----------
+		glUniform1i(drawUniforms.doGlow, 0);
+		glUniform1f(drawUniforms.radiusScale, 1.0f);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		{
+			PROFILE_SCOPE(profiler, "core");
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)particleCount);
+		}
+	
+		glBindVertexArray(0);
+	}
+
+	void Renderer::setDrawTarget(GLuint framebuffer, int width, int height) {
+		drawFramebuffer = framebuffer;
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, width, height);
+		if (width == targetWidth && height == targetHeight) return;
+		targetWidth = width;
+		targetHeight = height;
+		glProgramUniform2f(compositeProgram, compositeTargetSize, (float)width, (float)height);
+	}
+
+	void Renderer::ensureHdrTargets() {
+		if (hdrFramebuffer && hdrWidth == targetWidth && hdrHeight == targetHeight) return;
+		if (!hdrFramebuffer) glGenFramebuffers(1, &hdrFramebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hdrFramebuffer);
+		// Texture storage is immutable: a new target size needs new textures
+		GLuint* textures[] = { &hdrGlowTexture, &hdrCoreTexture };
+		for (int i = 0; i < 2; ++i) {
+			if (*textures[i]) glDeleteTextures(1, textures[i]);
+			glGenTextures(1, textures[i]);
+			glBindTexture(GL_TEXTURE_2D, *textures[i]);
+			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, targetWidth, targetHeight);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, *textures[i], 0);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+		if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			fprintf(stderr, "HDR framebuffer is incomplete\n");
+		}
+		hdrWidth = targetWidth;
+		hdrHeight = targetHeight;
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+	}
+
+	void Renderer::drawSinglePass(size_t particleCount) {
+		ensureHdrTargets();
+		// The glow target starts at the window's clear colour, so the
+		// resolve can clip background plus glow together
+		GLfloat background[4];
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, background);
+		const GLfloat transparent[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		{
+			PROFILE_SCOPE(profiler, "glow + core");
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hdrFramebuffer);
+			glClearBufferfv(GL_COLOR, 0, background);
+			glClearBufferfv(GL_COLOR, 1, transparent);
+			glBlendFunci(0, GL_ONE, GL_ONE);
+			glBlendFunci(1, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			glUseProgram(singlePassProgram);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)particleCount);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+		}
+
+		PROFILE_SCOPE(profiler, "resolve");
+		glActiveTexture(GL_TEXTURE0 + kHdrGlowUnit);
+		glBindTexture(GL_TEXTURE_2D, hdrGlowTexture);
+		glActiveTexture(GL_TEXTURE0 + kHdrCoreUnit);
+		glBindTexture(GL_TEXTURE_2D, hdrCoreTexture);
+		glActiveTexture(GL_TEXTURE0);
+		glUseProgram(hdrResolveProgram);
+		glBindVertexArray(fullscreenVao);
+		glDisable(GL_BLEND);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glEnable(GL_BLEND);
+	}
+
+	void Renderer::ensureSplatTargets() {
+		if (splatBuffer) return;
+		splatWidth = std::max(1, (int)std::ceil(worldWidth / kSplatCellPx));
+		splatHeight = std::max(1, (int)std::ceil(worldHeight / kSplatCellPx));
+		allocateStorage(splatBuffer, (size_t)splatWidth * splatHeight * 4 * sizeof(GLuint));
+
+		for (GLuint* texture : { &densityTexture, &blurTexture, &glowTexture }) {
+			glGenTextures(1, texture);
+			glBindTexture(GL_TEXTURE_2D, *texture);
+			glTexStorage2D(GL_TEXTURE_2D, 1, texture == &blurTexture ? GL_RGBA32F : GL_RGBA16F,
+						   splatWidth, splatHeight);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// Pixel coordinates to splat texture coordinates
+		const float toSplatX = 1.0f / (float)(kSplatCellPx * splatWidth);
+		const float toSplatY = 1.0f / (float)(kSplatCellPx * splatHeight);
+		for (GLuint program : { shaderProgram, compositeProgram }) {
+			glProgramUniform2f(program, glGetUniformLocation(program, "uPixelToSplat"), toSplatX, toSplatY);
+			glProgramUniform1i(program, glGetUniformLocation(program, "uDensity"), (GLint)kDensityUnit);
+		}
+		glProgramUniform1i(compositeProgram, glGetUniformLocation(compositeProgram, "uGlow"), (GLint)kGlowUnit);
+		glProgramUniform1f(compositeProgram, glGetUniformLocation(compositeProgram, "uCullCoverage"), kCoreCullCoverage);
+	}
+
+	void Renderer::drawSplatGlow(size_t particleCount) {
+		ensureSplatTargets();
+		const GLuint groupsX = (GLuint)(splatWidth + 15) / 16;
+		const GLuint groupsY = (GLuint)(splatHeight + 15) / 16;
+		{
+			PROFILE_SCOPE(profiler, "splat");
+			clearStorage(splatBuffer, (size_t)splatWidth * splatHeight * 4);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kHotIn, hotBuffers[frontBuffer]);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSplatColor, colorBuffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSplat, splatBuffer);
+			glUseProgram(splatProgram);
+			glUniform1i(kCountLocation, (GLint)particleCount);
+			glUniform2i(kSplatSizeLocation, splatWidth, splatHeight);
+			glDispatchCompute(workGroupsFor(particleCount), 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+			// Image units match the bindings written in the shaders
+			glBindImageTexture(0, densityTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+			glBindImageTexture(1, blurTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+			glBindImageTexture(2, glowTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+			glUseProgram(splatResolveProgram);
+			glUniform2i(kSplatSizeLocation, splatWidth, splatHeight);
+			glDispatchCompute(groupsX, groupsY, 1);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			glUseProgram(splatBlurProgram);
+			glUniform2i(kSplatSizeLocation, splatWidth, splatHeight);
+			const float cellArea = (float)(kSplatCellPx * kSplatCellPx);
+			glUniform1f(kGlowScaleLocation, glowEnergy() / cellArea);
+			glDispatchCompute(groupsX, groupsY, 1);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		}
+
+		glActiveTexture(GL_TEXTURE0 + kDensityUnit);
+		glBindTexture(GL_TEXTURE_2D, densityTexture);
+		glActiveTexture(GL_TEXTURE0 + kGlowUnit);
+		glBindTexture(GL_TEXTURE_2D, glowTexture);
+		glActiveTexture(GL_TEXTURE0);
+
+		PROFILE_SCOPE(profiler, "glow composite");
+		glUseProgram(compositeProgram);
+		glBindVertexArray(fullscreenVao);
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	void Renderer::createGeometryGPU() {
+		// A single quad's vertices. The vertex shader will scale and position it.
+		// We're using a triangle strip to draw the quad with 4 vertices.
+		static const float quadVertices[] = {
+			-1.0f, -1.0f, // bottom-left
+			 1.0f, -1.0f, // bottom-right
+			-1.0f,  1.0f, // top-left
+			 1.0f,  1.0f  // top-right
+		};
+
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+
+		glGenBuffers(1, &vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+		// Instanced attributes come from their own binding points so the
+		// ping-pong hot stream can be swapped without respecifying formats
+		glVertexBindingDivisor(kHotBinding, 1);
+		glVertexBindingDivisor(kColorBinding, 1);
+
+		// aPosPx (loc=1): hot.xy
+		glEnableVertexAttribArray(1);
+		glVertexAttribFormat(1, 2, GL_FLOAT, GL_FALSE, 0);
+		glVertexAttribBinding(1, kHotBinding);
+
+		// aRadiusPx (loc=2): hot.z
+		glEnableVertexAttribArray(2);
+		glVertexAttribFormat(2, 1, GL_FLOAT, GL_FALSE, 2 * sizeof(float));
+		glVertexAttribBinding(2, kHotBinding);
+
+		// aColor (loc=3): color.rgb
+		glEnableVertexAttribArray(3);
+		glVertexAttribFormat(3, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexAttribBinding(3, kColorBinding);
+
+				glBindVertexArray(0);
+	}
+
+	void Renderer::setNeighborSearch(NeighborSearch mode) {
+		neighborSearch = mode;
+	}
+
+	void Renderer::ensureGridBuffers(size_t particleCount, size_t cellCount) {
+		if (cellCount > gridCellCapacity) {
+			allocateStorage(cellStartBuffer, (cellCount + 1) * sizeof(GLuint));
+			gridCellCapacity = cellCount;
+		}
+		if (particleCount > gridParticleCapacity) {
+			allocateStorage(particleRankBuffer, particleCount * sizeof(GLuint));
+			allocateStorage(sortedHotBuffer, particleCount * kHotStride);
+			allocateStorage(sortedSpeciesBuffer, speciesWords(particleCount) * sizeof(GLuint));
+			gridParticleCapacity = particleCount;
+		}
+	}
+
+	void Renderer::dispatchComputeShader(size_t particleCount, float deltaTime) {
+		if (particleCount == 0) return;
+		const int back = 1 - frontBuffer;
+
+		// read the front streams, write the back ones
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kHotIn, hotBuffers[frontBuffer]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kHotOut, hotBuffers[back]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kVelIn, velBuffers[frontBuffer]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kVelOut, velBuffers[back]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSpeciesIn, speciesBuffer);
+
+		bindSimulationState();
+
+		const GLuint numGroups = workGroupsFor(particleCount);
+
+		if (neighborSearch == NeighborSearch::UniformGrid) {
+			dispatchGridPasses(particleCount, deltaTime, numGroups);
+		} else {
+			PROFILE_SCOPE(profiler, "forces");
+			const GLuint program = (neighborSearch == NeighborSearch::Tiled) ? tiledComputeProgram : computeProgram;
+			glUseProgram(program);
+			glUniform1i(kCountLocation, (GLint)particleCount);
+			glUniform1f(kDtLocation, deltaTime);
+			glDispatchCompute(numGroups, 1, 1);
+		}
+
+		// ensure writes visible to vertex fetch and later passes
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+		lastStepInput = frontBuffer;
+		lastStepCount = particleCount;
+		lastStepBinned = neighborSearch == NeighborSearch::UniformGrid;
+		frontBuffer = back;
+	}
+
+	// Sorts the hot stream and species at kHotIn/kSpeciesIn into cell
+	// order; expects the SimulationBlock bound (see bindSimulationState())
+	void Renderer::dispatchBinning(size_t particleCount, GLuint numGroups) {
+		const size_t numCells = (size_t)simulationBlock.gridDim[0] * (size_t)simulationBlock.gridDim[1];
+		ensureGridBuffers(particleCount, numCells);
+
+		clearStorage(cellStartBuffer, numCells + 1);
+		clearStorage(sortedSpeciesBuffer, speciesWords(particleCount));
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCellStart, cellStartBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSortedHot, sortedHotBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSortedSpecies, sortedSpeciesBuffer);
+
+		auto useGridProgram = [&](GLuint program) {
+			glUseProgram(program);
+			glUniform1i(kCountLocation, (GLint)particleCount);
+		};
+
+		{
+			PROFILE_SCOPE(profiler, "grid binning");
+
+			// 1) per-cell counts; ranks borrow the VelOut binding
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kParticleRank, particleRankBuffer);
+			useGridProgram(binCountProgram);
+			glDispatchCompute(numGroups, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+			// 2) prefix-sum offsets
+			glUseProgram(binScanProgram);
+			glUniform1i(kNumCellsLocation, (GLint)numCells);
+			glDispatchCompute(1, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+			// 3) scatter into cell order
+			useGridProgram(binScatterProgram);
+			glDispatchCompute(numGroups, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+	}
+
+	void Renderer::dispatchGridPasses(size_t particleCount, float deltaTime, GLuint numGroups) {
+		dispatchBinning(particleCount, numGroups);
+
+		// 4) forces over the 3x3 neighbourhood
+		PROFILE_SCOPE(profiler, "forces");
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kVelOut, velBuffers[1 - frontBuffer]);
+		glUseProgram(gridComputeProgram);
+		glUniform1i(kCountLocation, (GLint)particleCount);
+		glUniform1f(kDtLocation, deltaTime);
+		glDispatchCompute(numGroups, 1, 1);
+	}
+
+	bool Renderer::requestMetrics(size_t particleCount, uint64_t step, float radius, MetricsSource source) {
+		if (metricsReadback.full() || particleCount == 0) return false;
+		PROFILE_SCOPE(profiler, "metrics");
+
+		const size_t bytes = sizeof(MetricsHeader) + (size_t)numSpecies * sizeof(SpeciesTotals);
+		if (bytes > metricsCapacity) {
+			allocateStorage(metricsBuffer, bytes);
+			metricsCapacity = bytes;
+		}
+		if (particleCount > clusterCapacity) {
+			allocateStorage(clusterParentBuffer, particleCount * sizeof(GLuint));
+			allocateStorage(nearestKeyBuffer, particleCount * sizeof(GLuint));
+			clusterCapacity = particleCount;
+		}
+		clearStorage(metricsBuffer, bytes / sizeof(GLuint));
+		clearStorage(nearestKeyBuffer, particleCount, kNoNeighbourKey);
+
+		// Right after a step its input streams are still intact, and so is
+		// its binning unless it searched all pairs or the grid has changed
+		const bool fromLastStep = source == MetricsSource::LastStep && lastStepInput >= 0
+			&& lastStepCount == particleCount;
+		const int state = fromLastStep ? lastStepInput : frontBuffer;
+		const SimulationBlock block = currentSimulationBlock();
+		const bool binned = fromLastStep && lastStepBinned
+			&& std::memcmp(&block, &simulationBlock, sizeof(block)) == 0;
+		const float cappedRadius = metricsRadius(radius, simParams.maxDist);
+
+		bindSimulationState();
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kHotIn, hotBuffers[state]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSpeciesIn, speciesBuffer);
+		const GLuint numGroups = workGroupsFor(particleCount);
+		if (!binned) {
+			dispatchBinning(particleCount, numGroups);
+			lastStepBinned = fromLastStep;
+		}
+
+		// 1) sums over the particles
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kVelIn, velBuffers[state]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kMetrics, metricsBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kClusterParent, clusterParentBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kClusterSize, particleRankBuffer);
+		glUseProgram(metricsSumsProgram);
+		glUniform1i(kCountLocation, (GLint)particleCount);
+		glDispatchCompute(numGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		// 2) nearest neighbours and unions over the cells the radius reaches
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kNearestKey, nearestKeyBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCellStart, cellStartBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSortedHot, sortedHotBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSortedSpecies, sortedSpeciesBuffer);
+		glUseProgram(metricsNeighbourProgram);
+		glUniform1i(kCountLocation, (GLint)particleCount);
+		glUniform1f(kRadiusSquaredLocation, cappedRadius * cappedRadius);
+		glUniform1f(kRadiusLocation, cappedRadius);
+		glDispatchCompute(numGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		// 3) + 4) component sizes and the neighbour tally, then the histogram
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kClusterSize, particleRankBuffer);
+		glUseProgram(clusterRootProgram);
+		glUniform1i(kCountLocation, (GLint)particleCount);
+		glDispatchCompute(numGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		glUseProgram(clusterStatsProgram);
+		glUniform1i(kCountLocation, (GLint)particleCount);
+		glDispatchCompute(numGroups, 1, 1);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, metricsBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, metricsReadback.buffer(bytes));
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)bytes);
+		metricsReadback.submit(bytes, step);
+		metricsSpecies = numSpecies;
+		return true;
+	}
+
+	bool Renderer::pollMetrics(MetricsTotals& totals, uint64_t& step, bool wait) {
+		return metricsReadback.poll(wait, [&](const void* data, size_t, uint64_t tag) {
+			const auto* bytes = static_cast<const unsigned char*>(data);
+			totals.clear(metricsSpecies);
+			std::memcpy(&totals.header, bytes, sizeof(MetricsHeader));
+			std::memcpy(totals.species.data(), bytes + sizeof(MetricsHeader),
+				(size_t)metricsSpecies * sizeof(SpeciesTotals));
+			step = tag;
+		});
+	}
+}
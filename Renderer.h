@@ -1,36 +1,239 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "GPUParticle.h"
+#include "ParticleLayout.h"
 #include "Color.h"
+#include "DrawMode.h"
+#include "Metrics.h"
+#include "Profiler.h"
+#include "ReadbackRing.h"
+#include "SimulationParams.h"
  
 namespace Particles {
+
+	// Clear colour behind the particles, in the window and exported frames
+	constexpr GLfloat kBackgroundColor[4] = { 0.04f, 0.05f, 0.1f, 1.0f };
+
+	// How the compute pass finds interaction partners
+	enum class NeighborSearch {
+		BruteForce,  // all pairs, O(N^2), neighbours read straight from the SSBO
+		Tiled,       // all pairs, O(N^2), neighbours staged through shared memory
+		UniformGrid, // bin into uMaxDist-sized cells, visit the 3x3 block
+	};
  
  	class Renderer {
 	public:
-		Renderer(GLFWwindow* window);
+		// The world is worldWidth x worldHeight pixels, or the window's
+		// framebuffer size where they are 0; it is drawn scaled to the
+		// draw target
+		explicit Renderer(GLFWwindow* window, float worldWidth = 0.0f, float worldHeight = 0.0f);
 		~Renderer();
 
-		void drawPointsGPU(GLuint particleBuffer, size_t particleCount);
-		void initializeGPUBuffer(const std::vector<GPUParticle>& initialParticles, GLuint& particleBuffer);
-		void dispatchComputeShader(GLuint particleBuffer, size_t particleCount, float deltaTime);
-		void createGeometryGPU(GLuint particleBuffer);
+		void drawPointsGPU(size_t particleCount);
+		void initializeGPUBuffer(const std::vector<GPUParticle>& initialParticles);
+		void dispatchComputeShader(size_t particleCount, float deltaTime);
+		void createGeometryGPU();
+
+		// Conversion between GPUParticle records and the current (front)
+		// particle streams; all of them go through a staging buffer
+		void uploadParticles(const std::vector<GPUParticle>& particles);
+		void uploadParticles(const GPUParticle* particles, size_t count);
+		void writeParticles(const size_t* indices, const GPUParticle* values, size_t count);
+		void downloadParticles(std::vector<GPUParticle>& particles);
+		// resetSimulation() on the GPU: fills the streams with count fresh
+		// particles drawn from seed, identical to the ones resetSimulation()
+		// would upload, without building them on the CPU
+		void spawnParticles(size_t count, float worldWidth, float worldHeight, uint32_t seed);
+		// Non-blocking download: requestReadback() queues a pack and a copy
+		// into a readback buffer behind a fence; pollReadback() returns false
+		// until the GPU has passed the fence, then fills particles with the
+		// state as of the request. One readback is in flight at a time.
+		bool requestReadback(size_t particleCount);
+		bool pollReadback(std::vector<GPUParticle>& particles);
+		bool readbackPending() const { return particleReadback.pending(); }
+		// Trajectory readback: requestPositions() quantizes the current
+		// positions to 16 bits per axis (as quantizePosition() in
+		// Trajectory.h) into a ring slot behind a fence, and returns false
+		// while every slot is in flight. pollPositions() returns the oldest
+		// slot once its fence has passed, or waits for it if wait is set.
+		static constexpr int kPositionSlots = 8;
+		bool requestPositions(size_t particleCount, uint64_t step, float worldWidth, float worldHeight);
+		bool pollPositions(std::vector<uint32_t>& quantized, uint64_t& step, bool wait);
+		int positionsInFlight() const { return positionReadback.slotsInFlight(); }
+		// Metrics readback: requestMetrics() reduces the particles into a
+		// small buffer behind a fence (see Metrics.h); false while the
+		// previous request is still in flight. LastStep measures the streams
+		// the last dispatchComputeShader() read, over the grid it binned
+		// them into; Current, or LastStep once the particles have been
+		// written since, bins the front streams first. pollMetrics() returns
+		// the totals once the fence has passed, or waits for them if wait is
+		// set.
+		bool requestMetrics(size_t particleCount, uint64_t step, float radius, MetricsSource source);
+		bool pollMetrics(MetricsTotals& totals, uint64_t& step, bool wait);
+		bool metricsPending() const { return metricsReadback.pending(); }
+		// Replaces the species attraction weights used by later steps; a
+		// different species count relinks the physics programs
+		void setAttractionMatrix(const Color::AttractionMatrix& matrix);
+		void setNeighborSearch(NeighborSearch mode);
+		NeighborSearch getNeighborSearch() const { return neighborSearch; }
+		// Where drawPointsGPU() draws: a framebuffer of width x height
+		// pixels, bound with a matching viewport. The world is scaled to
+		// fill it. Defaults to the window.
+		void setDrawTarget(GLuint framebuffer, int width, int height);
+		void resetDrawTarget() { setDrawTarget(0, framebufferWidth, framebufferHeight); }
+		void setDrawMode(DrawMode mode) { drawMode = mode; }
+		DrawMode getDrawMode() const { return drawMode; }
+		void setSimulationParams(const SimulationParams& params) { simParams = params; }
+		const SimulationParams& getSimulationParams() const { return simParams; }
+		// Optional; compute and draw passes report into it when set
+		void setProfiler(Profiler* stageProfiler) { profiler = stageProfiler; }
 
 	private:
 		GLuint shaderProgram { 0 };
 		GLuint computeProgram { 0 };
+		GLuint tiledComputeProgram { 0 };
 		GLuint vao { 0 };
 		GLuint vbo { 0 };
 		GLuint instanceVbo { 0 }; // Kept for consistency, though its setup is unused
 		int framebufferWidth { 1 };
 		int framebufferHeight { 1 };
+		float worldWidth { 1.0f };
+		float worldHeight { 1.0f };
+		GLuint drawFramebuffer { 0 };
+		int targetWidth { 1 };
+		int targetHeight { 1 };
 		GLuint attractionTexture { 0 };
+		int numSpecies { 0 }; // of the attraction matrix the kernels were built for
+
+		// Particle streams (see the layout notes in Renderer.cpp). hot and vel
+		// are ping-pong pairs: steps read [frontBuffer] and write the other.
+		GLuint hotBuffers[2] { 0, 0 };
+		GLuint velBuffers[2] { 0, 0 };
+		GLuint speciesBuffer { 0 };
+		GLuint colorBuffer { 0 };
+		int frontBuffer { 0 };
+		size_t particleCapacity { 0 };
+
+		// GPUParticle records (and target indices) for pack/unpack
+		GLuint unpackProgram { 0 };
+		GLuint packProgram { 0 };
+		GLuint spawnProgram { 0 };
+		GLuint stagingBuffer { 0 };
+		GLuint stagingIndexBuffer { 0 };
+		std::vector<GLuint> stagingIndices; // writeParticles() indices, narrowed to 32 bits
+		size_t stagingCapacity { 0 };
+		ReadbackRing particleReadback;
+		GLuint quantizeProgram { 0 };
+		ReadbackRing positionReadback { kPositionSlots };
+		// Metrics passes, their result buffer and its readback copy
+		GLuint metricsSumsProgram { 0 };
+		GLuint metricsNeighbourProgram { 0 };
+		GLuint clusterRootProgram { 0 };
+		GLuint clusterStatsProgram { 0 };
+		GLuint metricsBuffer { 0 };
+		ReadbackRing metricsReadback;
+		size_t metricsCapacity { 0 }; // bytes
+		GLuint clusterParentBuffer { 0 };
+		GLuint nearestKeyBuffer { 0 };
+		size_t clusterCapacity { 0 };
+		int metricsSpecies { 0 };
+		// Stream pair the last step read, -1 once the particles change;
+		// lastStepBinned while the grid buffers still hold its binning
+		int lastStepInput { -1 };
+		size_t lastStepCount { 0 };
+		bool lastStepBinned { false };
+
+		// Density splat: a grid of kSplatCellPx-pixel cells the particles
+		// are accumulated into, its density, horizontal-blur and glow
+		// textures, and the composite pass; allocated on first use
+		GLuint splatProgram { 0 };
+		GLuint splatResolveProgram { 0 };
+		GLuint splatBlurProgram { 0 };
+		GLuint compositeProgram { 0 };
+		GLuint splatBuffer { 0 };
+		GLuint densityTexture { 0 };
+		GLuint blurTexture { 0 };
+		GLuint glowTexture { 0 };
+		int splatWidth { 0 };
+		int splatHeight { 0 };
+		// Single-pass drawing: HDR glow and core targets and their resolve
+		GLuint singlePassProgram { 0 };
+		GLuint hdrResolveProgram { 0 };
+		GLuint hdrFramebuffer { 0 };
+		GLuint hdrGlowTexture { 0 };
+		GLuint hdrCoreTexture { 0 };
+		int hdrWidth { 0 };
+		int hdrHeight { 0 };
+		GLuint fullscreenVao { 0 }; // attribute-less, for the resolve and composite passes
+		GLint compositeTargetSize { -1 };
+
+		NeighborSearch neighborSearch { NeighborSearch::UniformGrid };
+		DrawMode drawMode { DrawMode::Quads };
+		SimulationParams simParams;
+		Profiler* profiler { nullptr };
+
+		// std140 mirror of the SimulationBlock uniform block; the buffer is
+		// only rewritten when simParams or the grid size change
+		struct SimulationBlock {
+			float maxDist;
+			float repelDist;
+			float damping;
+			float forceScale;
+			GLint gridDim[2];
+			float cellSize[2];
+			float worldSize[2];
+			float referenceDt;
+			GLint integrator;
+			GLint boundary;
+			float _pad[3];
+		};
+		GLuint simulationBlockBuffer { 0 };
+		SimulationBlock simulationBlock {};
+
+		// Draw-program uniform locations, resolved once at link time
+		struct DrawUniforms {
+			GLint radiusScale { -1 };
+			GLint doGlow { -1 };
+			GLint glowIntensity { -1 };
+			GLint glowSharpness { -1 };
+			GLint cullCoverage { -1 };
+		};
+		DrawUniforms drawUniforms;
+
+		// Uniform-grid binning programs and scratch buffers
+		GLuint gridComputeProgram { 0 };
+		GLuint binCountProgram { 0 };
+		GLuint binScanProgram { 0 };
+		GLuint binScatterProgram { 0 };
+		GLuint cellStartBuffer { 0 };
+		GLuint particleRankBuffer { 0 };
+		GLuint sortedHotBuffer { 0 };
+		GLuint sortedSpeciesBuffer { 0 };
+		size_t gridCellCapacity { 0 };
+		size_t gridParticleCapacity { 0 };
 
 		void createShaders();
 		void createComputeShader();
+		void createPhysicsPrograms();
 		void updateFramebufferSize(GLFWwindow* window);
 		void createAttractionTexture();
+		void bindSimulationState();
+		void allocateParticleStreams(size_t particleCount);
+		void ensureStagingCapacity(size_t recordCount);
+		void bindInterchangeBuffers();
+		void dispatchUnpack(size_t recordCount, bool indexed);
+		void dispatchPack(size_t recordCount);
+		void ensureGridBuffers(size_t particleCount, size_t cellCount);
+		SimulationBlock currentSimulationBlock() const;
+		void dispatchBinning(size_t particleCount, GLuint numGroups);
+		void dispatchGridPasses(size_t particleCount, float deltaTime, GLuint numGroups);
+		void ensureHdrTargets();
+		void drawSinglePass(size_t particleCount);
+		void ensureSplatTargets();
+		void drawSplatGlow(size_t particleCount);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "SimulationParams.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace Particles {
+
+    bool readSimulationParams(const std::string& filename, SimulationParams& params, std::string& error) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            error = "could not open '" + filename + "'";
+            return false;
+        }
+
+        SimulationParams loaded;
+        loaded.integrator = params.integrator;
+        loaded.boundary = params.boundary;
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line)) {
+            ++lineNumber;
+            if (line.empty() || line[0] == '#') continue;
+
+            std::istringstream iss(line);
+            std::string name;
+            float value;
+            if (!(iss >> name)) continue; // blank
+            if (!(iss >> value) || !std::isfinite(value)) {
+                error = "could not parse line " + std::to_string(lineNumber) + ": " + line;
+                return false;
+            }
+
+            bool valid = true;
+            if (name == "maxDist") {
+                loaded.maxDist = value;
+                valid = value > 0.0f;
+            } else if (name == "repelDist") {
+                loaded.repelDist = value;
+                valid = value >= 0.0f;
+            } else if (name == "damping") {
+                loaded.damping = value;
+                valid = value >= 0.0f && value <= 1.0f;
+            } else if (name == "forceScale") {
+                loaded.forceScale = value;
+            } else {
+                error = "unknown parameter '" + name + "' on line " + std::to_string(lineNumber);
+                return false;
+            }
+            if (!valid) {
+                error = "value out of range on line " + std::to_string(lineNumber) + ": " + line;
+                return false;
+            }
+        }
+
+        params = loaded;
+        return true;
+    }
+
+    const char* boundaryName(Boundary boundary) {
+        switch (boundary) {
+            case Boundary::Open: return "open";
+            case Boundary::Torus: return "torus";
+            case Boundary::Reflect: return "reflect";
+        }
+        return "unknown";
+    }
+
+    GridLayout gridLayout(float worldWidth, float worldHeight, float minCellSize, Boundary boundary) {
+        GridLayout layout;
+        if (boundary == Boundary::Torus) {
+            layout.width = std::max(3, (int)(worldWidth / minCellSize));
+            layout.height = std::max(3, (int)(worldHeight / minCellSize));
+            layout.cellWidth = worldWidth / (float)layout.width;
+            layout.cellHeight = worldHeight / (float)layout.height;
+        } else {
+            layout.width = std::max(1, (int)std::ceil(worldWidth / minCellSize));
+            layout.height = std::max(1, (int)std::ceil(worldHeight / minCellSize));
+            layout.cellWidth = minCellSize;
+            layout.cellHeight = minCellSize;
+        }
+        return layout;
+    }
+
+    int neighbourRuns(int c, int cells, float period, Boundary boundary, CellRun runs[2]) {
+        if (boundary == Boundary::Torus) {
+            if (c == 0) {
+                runs[0] = { cells - 1, cells - 1, period };
+                runs[1] = { 0, 1, 0.0f };
+                return 2;
+            }
+            if (c == cells - 1) {
+                runs[0] = { c - 1, c, 0.0f };
+                runs[1] = { 0, 0, -period };
+                return 2;
+            }
+            runs[0] = { c - 1, c + 1, 0.0f };
+            return 1;
+        }
+        runs[0] = { std::max(c - 1, 0), std::min(c + 1, cells - 1), 0.0f };
+        return 1;
+    }
+
+    int reachedRuns(float p, float reach, float size, int c, int cells, float period, Boundary boundary,
+                    CellRun runs[2]) {
+        reach += size * (1.0f / 1024.0f);
+        // Clamped before the conversion: open-world positions can lie far outside the grid
+        const int low = (int)std::min(std::max(std::floor((p - reach) / size), (float)(c - 1)), (float)c);
+        const int high = (int)std::min(std::max(std::floor((p + reach) / size), (float)c), (float)(c + 1));
+        if (boundary == Boundary::Torus) {
+            if (low < 0) {
+                runs[0] = { cells - 1, cells - 1, period };
+                runs[1] = { 0, high, 0.0f };
+                return 2;
+            }
+            if (high == cells) {
+                runs[0] = { low, cells - 1, 0.0f };
+                runs[1] = { 0, 0, -period };
+                return 2;
+            }
+        }
+        runs[0] = { std::max(low, 0), std::min(high, cells - 1), 0.0f };
+        return 1;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+
+namespace Particles {
+
+    // Step length the velocity units refer to: velocities are in pixels per
+    // kReferenceDt, so a step of dt moves a particle by vel * dt / kReferenceDt
+    constexpr float kReferenceDt = 0.016f;
+
+    // How a step turns forces into new velocities and positions
+    enum class Integrator {
+        SemiImplicitEuler = 0, // v += a dt, then x += v h
+        VelocityVerlet = 1,    // x += v h + a dt h / 2, v += (a_prev + a) dt / 2
+    };
+
+    // What happens at the edges of the world [0, width) x [0, height)
+    enum class Boundary {
+        Open = 0,    // none: particles drift out, the grid clamps them into its border cells
+        Torus = 1,   // periodic: an edge leads to the opposite one, forces act on the nearest image
+        Reflect = 2, // walls: a particle that crosses one is mirrored back and its normal velocity flips
+    };
+
+    // Constants of the force law, shared by every physics backend
+    struct SimulationParams {
+        float maxDist = 150.0f;    // interaction cutoff in pixels (also the minimum grid cell size)
+        float repelDist = 30.0f;   // extra distance beyond contact where repulsion applies
+        float damping = 0.08f;     // fraction of velocity removed per step
+        float forceScale = 1.0f;   // global force multiplier
+        Integrator integrator = Integrator::SemiImplicitEuler;
+        Boundary boundary = Boundary::Open;
+    };
+
+    const char* boundaryName(Boundary boundary);
+
+    // Uniform grid over the world for the neighbour search, with cells at
+    // least minCellSize on a side. Open and reflecting worlds use square
+    // cells and round the count up. A torus needs the cells to tile the
+    // period exactly, so its count is rounded down and the cells stretched
+    // to fit, and it has at least 3 cells per axis so that the wrapped 3x3
+    // block never visits a cell twice (in a world under 3 * minCellSize
+    // across, pairs further apart than a third of it may then be missed).
+    struct GridLayout {
+        int width;
+        int height;
+        float cellWidth;
+        float cellHeight;
+    };
+    GridLayout gridLayout(float worldWidth, float worldHeight, float minCellSize, Boundary boundary);
+
+    // Neighbour cells of cell c along one grid axis of cells cells, as up
+    // to two runs of adjacent cells. In a torus the block wraps around the
+    // edges: the cells on the far side act as ghost copies of themselves,
+    // displaced by one period, and a run's offset is what to add to the
+    // particle's own coordinate so that xj - (xi + offset) is the distance
+    // to that image. Elsewhere the block is clamped to the grid and the
+    // offset is 0. Mirrored by neighbourRuns() in the grid kernels.
+    struct CellRun {
+        int first;
+        int last;
+        float offset;
+    };
+    int neighbourRuns(int c, int cells, float period, Boundary boundary, CellRun runs[2]);
+
+    // The part of neighbourRuns() that a search of radius reach around
+    // coordinate p (binned into cell c of size wide cells) can touch: the
+    // cell beside c only when p comes within reach of it. Lets a search
+    // with a radius under the cell size skip most of the 3x3 block. Pads
+    // reach by a sliver of a cell, so rounding never drops a pair at the
+    // edge. Mirrored by reachedRuns() in the metrics kernel.
+    int reachedRuns(float p, float reach, float size, int c, int cells, float period, Boundary boundary,
+                    CellRun runs[2]);
+
+    // Keeps a position inside [0, extent) for one axis after a step (see
+    // Boundary); v is the velocity along the same axis. Open does nothing.
+    // Assumes no step moves a particle further than one extent, and uses
+    // the same operations as applyBoundary() in the compute shaders.
+    inline void applyBoundary(float& p, float& v, float extent, Boundary boundary) {
+        if (boundary == Boundary::Torus) {
+            if (p < 0.0f) p += extent;
+            if (p >= extent) p -= extent;
+        } else if (boundary == Boundary::Reflect) {
+            if (p < 0.0f) {
+                p = -p;
+                v = -v;
+            } else if (p > extent) {
+                p = extent - (p - extent);
+                v = -v;
+            }
+            p = p < 0.0f ? 0.0f : (p > extent ? extent : p);
+        }
+    }
+
+    // Reads the force-law constants from a parameters file: one "name value"
+    // pair per line (maxDist, repelDist, damping, forceScale), '#' starts a
+    // comment. Names the file leaves out take their default values;
+    // params.integrator and params.boundary are not part of the file and
+    // are left alone. On failure error says why and params is unchanged.
+    bool readSimulationParams(const std::string& filename, SimulationParams& params, std::string& error);
+}
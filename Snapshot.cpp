@@ -0,0 +1,284 @@
+#include "Snapshot.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Particles {
+
+    static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool writeSnapshot(const std::string& path, const SnapshotState& state,
+                       const GPUParticle* particles, size_t particleCount, std::string& error) {
+        const int numSpecies = Color::speciesCount(state.attraction);
+        const Color::AttractionMatrix& matrix = state.attraction;
+
+        SnapshotHeader header {};
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+        header.version = kSnapshotVersion;
+        header.headerBytes = sizeof(SnapshotHeader);
+        header.particleCount = particleCount;
+        header.stepCount = state.stepCount;
+        header.matrixOffset = sizeof(SnapshotHeader);
+        header.rngOffset = header.matrixOffset + matrix.size() * sizeof(float);
+        header.rngBytes = state.rngState.size();
+        header.particleOffset = alignUp(header.rngOffset + header.rngBytes, 64);
+        header.particleStride = sizeof(GPUParticle);
+        header.numSpecies = (uint32_t)numSpecies;
+        header.integrator = (uint32_t)state.params.integrator;
+        header.worldWidth = state.worldWidth;
+        header.worldHeight = state.worldHeight;
+        header.deltaTime = state.deltaTime;
+        header.maxDist = state.params.maxDist;
+        header.repelDist = state.params.repelDist;
+        header.damping = state.params.damping;
+        header.forceScale = state.params.forceScale;
+        header.boundary = (uint32_t)state.params.boundary;
+
+        const std::string tempPath = path + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                error = "could not open '" + tempPath + "' for writing";
+                return false;
+            }
+            const char zeros[64] = {};
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(matrix.data()), (std::streamsize)(matrix.size() * sizeof(float)));
+            out.write(state.rngState.data(), (std::streamsize)state.rngState.size());
+            out.write(zeros, (std::streamsize)(header.particleOffset - header.rngOffset - header.rngBytes));
+            out.write(reinterpret_cast<const char*>(particles), (std::streamsize)(particleCount * sizeof(GPUParticle)));
+            if (!out) {
+                error = "write to '" + tempPath + "' failed";
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tempPath, path, ec);
+        if (ec) {
+            error = "could not rename '" + tempPath + "' to '" + path + "': " + ec.message();
+            return false;
+        }
+        return true;
+    }
+
+    SnapshotFile::~SnapshotFile() {
+        close();
+    }
+
+    bool SnapshotFile::open(const std::string& path, std::string& error) {
+        close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            error = "could not open '" + path + "'";
+            return false;
+        }
+        fileHandle = file;
+        LARGE_INTEGER fileSize {};
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            error = "could not read the size of '" + path + "'";
+            close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+        mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle != nullptr) {
+            data = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (data == nullptr) {
+            error = "could not map '" + path + "'";
+            close();
+            return false;
+        }
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "could not open '" + path + "'";
+            return false;
+        }
+        struct stat info {};
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            error = "could not read the size of '" + path + "'";
+            ::close(fd);
+            return false;
+        }
+        size = (size_t)info.st_size;
+        // The mapping stays valid after the descriptor is closed
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            error = "could not map '" + path + "'";
+            size = 0;
+            return false;
+        }
+        data = static_cast<const unsigned char*>(mapped);
+        // The whole file is about to be read; start paging it in now
+        madvise(mapped, size, MADV_WILLNEED);
+#endif
+
+        if (!parse(error)) {
+            error = "'" + path + "': " + error;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void SnapshotFile::close() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mappingHandle) CloseHandle(mappingHandle);
+        if (fileHandle) CloseHandle(fileHandle);
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+#else
+        if (data) munmap(const_cast<unsigned char*>(data), size);
+#endif
+        data = nullptr;
+        size = 0;
+        particleData = nullptr;
+        count = 0;
+        loadedState = SnapshotState {};
+    }
+
+    bool SnapshotFile::parse(std::string& error) {
+        SnapshotHeader header;
+        if (size < sizeof(header)) {
+            error = "too short for a snapshot header";
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+
+        if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0) {
+            error = "not a particle snapshot";
+            return false;
+        }
+        if (header.version != kSnapshotVersion) {
+            error = "unsupported snapshot version " + std::to_string(header.version);
+            return false;
+        }
+        if (header.particleStride != sizeof(GPUParticle)) {
+            error = "particle stride " + std::to_string(header.particleStride) + " does not match GPUParticle";
+            return false;
+        }
+        if (header.numSpecies < (uint32_t)Color::MIN_SPECIES || header.numSpecies > (uint32_t)Color::MAX_SPECIES) {
+            error = "unsupported species count " + std::to_string(header.numSpecies);
+            return false;
+        }
+
+        const uint64_t matrixBytes = (uint64_t)header.numSpecies * header.numSpecies * sizeof(float);
+        const bool inBounds = header.headerBytes >= sizeof(SnapshotHeader)
+            && header.matrixOffset <= size && matrixBytes <= size - header.matrixOffset
+            && header.rngOffset <= size && header.rngBytes <= size - header.rngOffset
+            && header.particleOffset <= size && header.particleOffset % 64 == 0
+            && header.particleCount <= (size - header.particleOffset) / sizeof(GPUParticle);
+        if (!inBounds) {
+            error = "truncated or corrupt snapshot";
+            return false;
+        }
+
+        loadedState.stepCount = header.stepCount;
+        loadedState.worldWidth = header.worldWidth;
+        loadedState.worldHeight = header.worldHeight;
+        loadedState.deltaTime = header.deltaTime;
+        loadedState.params.maxDist = header.maxDist;
+        loadedState.params.repelDist = header.repelDist;
+        loadedState.params.damping = header.damping;
+        loadedState.params.forceScale = header.forceScale;
+        loadedState.params.integrator = header.integrator == (uint32_t)Integrator::VelocityVerlet
+            ? Integrator::VelocityVerlet : Integrator::SemiImplicitEuler;
+        loadedState.params.boundary = header.boundary <= (uint32_t)Boundary::Reflect
+            ? (Boundary)header.boundary : Boundary::Open;
+
+        const int numSpecies = (int)header.numSpecies;
+        loadedState.attraction = Color::AttractionMatrix(numSpecies);
+        std::memcpy(loadedState.attraction.data(), data + header.matrixOffset, (size_t)matrixBytes);
+        loadedState.rngState.assign(reinterpret_cast<const char*>(data + header.rngOffset), header.rngBytes);
+
+        // The species index every backend looks up the matrix and the
+        // per-species totals with; out of range it reads past them
+        const auto* particles = reinterpret_cast<const GPUParticle*>(data + header.particleOffset);
+        for (uint64_t i = 0; i < header.particleCount; ++i) {
+            if (particles[i].colorSpecies < 0 || particles[i].colorSpecies >= numSpecies) {
+                error = "particle " + std::to_string(i) + " has species " + std::to_string(particles[i].colorSpecies)
+                    + " outside the " + std::to_string(numSpecies) + " of the matrix";
+                return false;
+            }
+        }
+
+        particleData = particles;
+        count = (size_t)header.particleCount;
+        return true;
+    }
+
+    SnapshotWriter::SnapshotWriter() {
+        worker = std::thread([this] { run(); });
+    }
+
+    SnapshotWriter::~SnapshotWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void SnapshotWriter::save(std::string path, SnapshotState state, std::vector<GPUParticle> particles) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(Job { std::move(path), std::move(state), std::move(particles) });
+            ++inFlight;
+        }
+        wake.notify_one();
+    }
+
+    size_t SnapshotWriter::pending() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return inFlight;
+    }
+
+    void SnapshotWriter::run() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            std::string error;
+            if (writeSnapshot(job.path, job.state, job.particles.data(), job.particles.size(), error)) {
+                std::cout << "Snapshot of " << job.particles.size() << " particles at step " << job.state.stepCount
+                          << " saved to '" << job.path << "'" << std::endl;
+            } else {
+                std::cout << "Snapshot save failed: " << error << std::endl;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            --inFlight;
+        }
+    }
+}
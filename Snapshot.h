@@ -0,0 +1,135 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Color.h"
+#include "GPUParticle.h"
+#include "SimulationParams.h"
+
+namespace Particles {
+
+    // On-disk layout, version 1 (little-endian, every offset from the start
+    // of the file):
+    //
+    //   SnapshotHeader                       128 bytes
+    //   attraction matrix                    numSpecies^2 float32, [from * numSpecies + to]
+    //   RNG state                            rngBytes of text, as written by operator<<
+    //   particles (64-byte aligned)          particleCount GPUParticle records
+    //
+    // The particle array is stored exactly as GPUParticle, so a loader can
+    // hand the mapped bytes to the GPU without touching individual records.
+    constexpr char kSnapshotMagic[8] = { 'P', 'S', 'I', 'M', 'S', 'N', 'A', 'P' };
+    constexpr uint32_t kSnapshotVersion = 1;
+
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerBytes;
+        uint64_t particleCount;
+        uint64_t stepCount;
+        uint64_t matrixOffset;
+        uint64_t rngOffset;
+        uint64_t rngBytes;
+        uint64_t particleOffset;
+        uint32_t particleStride;
+        uint32_t numSpecies;
+        uint32_t integrator;
+        float worldWidth;
+        float worldHeight;
+        float deltaTime;
+        float maxDist;
+        float repelDist;
+        float damping;
+        float forceScale;
+        uint32_t boundary; // 0 (Open) in files written before it existed
+        uint32_t reserved[5];
+    };
+    static_assert(sizeof(SnapshotHeader) == 128, "snapshot header layout");
+
+    // Everything in a snapshot except the particles
+    struct SnapshotState {
+        uint64_t stepCount = 0;
+        float worldWidth = 0.0f;
+        float worldHeight = 0.0f;
+        float deltaTime = 0.0f;
+        SimulationParams params;
+        Color::AttractionMatrix attraction;
+        std::string rngState; // std::mt19937 streamed with operator<<
+    };
+
+    // Writes the snapshot to a temporary file next to path and renames it
+    // into place, so a reader never sees a half-written file
+    bool writeSnapshot(const std::string& path, const SnapshotState& state,
+                       const GPUParticle* particles, size_t particleCount, std::string& error);
+
+    // A snapshot opened for reading. The particles are not copied: they
+    // point into a read-only mapping of the file that lives as long as this
+    // object.
+    class SnapshotFile {
+    public:
+        SnapshotFile() = default;
+        ~SnapshotFile();
+        SnapshotFile(const SnapshotFile&) = delete;
+        SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+        // Maps the file and validates the header and the particles'
+        // species; the previous file, if any, is closed first
+        bool open(const std::string& path, std::string& error);
+        void close();
+
+        const SnapshotState& state() const { return loadedState; }
+        const GPUParticle* particles() const { return particleData; }
+        size_t particleCount() const { return count; }
+
+    private:
+        const unsigned char* data { nullptr };
+        size_t size { 0 };
+#ifdef _WIN32
+        void* fileHandle { nullptr };
+        void* mappingHandle { nullptr };
+#endif
+        SnapshotState loadedState;
+        const GPUParticle* particleData { nullptr };
+        size_t count { 0 };
+
+        bool parse(std::string& error);
+    };
+
+    // Saves snapshots on a background thread, in the order they were
+    // queued, and reports each result on stdout. The destructor finishes
+    // every queued save.
+    class SnapshotWriter {
+    public:
+        SnapshotWriter();
+        ~SnapshotWriter();
+        SnapshotWriter(const SnapshotWriter&) = delete;
+        SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+        void save(std::string path, SnapshotState state, std::vector<GPUParticle> particles);
+        // Saves queued or being written
+        size_t pending() const;
+
+    private:
+        struct Job {
+            std::string path;
+            SnapshotState state;
+            std::vector<GPUParticle> particles;
+        };
+
+        std::thread worker;
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<Job> jobs;
+        size_t inFlight { 0 };
+        bool stopping { false };
+
+        void run();
+    };
+}
@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace Particles {
+
+    ThreadPool::ThreadPool(size_t threadCount) {
+        if (threadCount == 0) {
+            threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        workers.reserve(threadCount - 1);
+        for (size_t i = 1; i < threadCount; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::runChunks() {
+        const size_t numChunks = (jobCount + jobChunk - 1) / jobChunk;
+        for (size_t c = nextChunk.fetch_add(1); c < numChunks; c = nextChunk.fetch_add(1)) {
+            const size_t begin = c * jobChunk;
+            (*job)(begin, std::min(begin + jobChunk, jobCount));
+        }
+    }
+
+    void ThreadPool::workerLoop() {
+        size_t seenGeneration = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) return;
+                seenGeneration = generation;
+            }
+
+            runChunks();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busyWorkers == 0) done.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::parallelFor(size_t count, RangeFn fn, size_t minChunk) {
+        if (count == 0) return;
+        if (workers.empty() || count <= minChunk) {
+            fn(0, count);
+            return;
+        }
+
+        // Several chunks per thread so that dense regions do not serialise the loop
+        const size_t target = (count + size() * 8 - 1) / (size() * 8);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            jobCount = count;
+            jobChunk = std::max(minChunk, target);
+            nextChunk.store(0);
+            busyWorkers = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+
+        runChunks();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busyWorkers == 0; });
+        job = nullptr;
+    }
+
+    void ThreadPool::forEachSlice(FunctionRef<void(size_t slice)> fn) {
+        parallelFor(size(), [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) fn(t);
+        }, 1);
+    }
+}
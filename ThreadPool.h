@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Particles {
+
+    // Non-owning reference to a callable. Unlike std::function it never
+    // copies the callable, so handing a capturing lambda to the pool does
+    // not allocate; the callable must outlive the call it is passed to.
+    template <typename Signature>
+    class FunctionRef;
+
+    template <typename R, typename... Args>
+    class FunctionRef<R(Args...)> {
+    public:
+        template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, FunctionRef>>>
+        FunctionRef(F&& fn)
+            : object(const_cast<void*>(static_cast<const void*>(std::addressof(fn)))),
+              invoke([](void* target, Args... args) -> R {
+                  return (*static_cast<std::remove_reference_t<F>*>(target))(std::forward<Args>(args)...);
+              }) {}
+
+        R operator()(Args... args) const { return invoke(object, std::forward<Args>(args)...); }
+
+    private:
+        void* object;
+        R (*invoke)(void*, Args...);
+    };
+
+    // Fixed set of worker threads that execute data-parallel loops.
+    // The calling thread takes part in every loop, so a pool of size 1
+    // runs everything inline without any synchronisation.
+    class ThreadPool {
+    public:
+        using RangeFn = FunctionRef<void(size_t begin, size_t end)>;
+
+        // threadCount == 0 uses std::thread::hardware_concurrency()
+        explicit ThreadPool(size_t threadCount = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t size() const { return workers.size() + 1; }
+
+        // Calls fn on disjoint [begin, end) chunks covering [0, count).
+        // Chunks are handed out dynamically, so uneven work is balanced.
+        void parallelFor(size_t count, RangeFn fn, size_t minChunk = 256);
+
+        // Calls fn(t) exactly once for every t in [0, size()). Used for work
+        // split into one fixed, deterministic slice per thread.
+        void forEachSlice(FunctionRef<void(size_t slice)> fn);
+
+    private:
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        // Current job, published under the mutex
+        const RangeFn* job { nullptr };
+        size_t jobCount { 0 };
+        size_t jobChunk { 1 };
+        std::atomic<size_t> nextChunk { 0 };
+        size_t generation { 0 };
+        size_t busyWorkers { 0 };
+        bool stopping { false };
+
+        void workerLoop();
+        void runChunks();
+    };
+}
@@ -0,0 +1,242 @@
+#include "Trajectory.h"
+
+#include <cstring>
+
+namespace Particles {
+
+    void quantizePositions(const std::vector<GPUParticle>& particles, float worldWidth, float worldHeight,
+                           std::vector<uint32_t>& quantized) {
+        const float scaleX = kQuantizedMax / worldWidth;
+        const float scaleY = kQuantizedMax / worldHeight;
+        quantized.resize(particles.size());
+        for (size_t i = 0; i < particles.size(); ++i) {
+            quantized[i] = quantizePosition(particles[i].px, particles[i].py, scaleX, scaleY);
+        }
+    }
+
+    // Component `axis` (0 = x, 1 = y) of a packed position
+    static int32_t component(uint32_t packed, int axis) {
+        return (int32_t)((packed >> (16 * axis)) & 0xFFFFu);
+    }
+
+    static int32_t predict(const std::vector<uint32_t>* previous, int order, size_t i, int axis) {
+        const int32_t last = component(previous[0][i], axis);
+        return order == 1 ? last : 2 * last - component(previous[1][i], axis);
+    }
+
+    static void putVarint(std::vector<uint8_t>& out, int32_t value) {
+        uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+        while (zigzag >= 0x80u) {
+            out.push_back((uint8_t)(zigzag | 0x80u));
+            zigzag >>= 7;
+        }
+        out.push_back((uint8_t)zigzag);
+    }
+
+    static bool getVarint(const uint8_t*& in, const uint8_t* end, int32_t& value) {
+        uint32_t zigzag = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (in == end) return false;
+            const uint8_t byte = *in++;
+            zigzag |= (uint32_t)(byte & 0x7Fu) << shift;
+            if ((byte & 0x80u) == 0) {
+                value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1u);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    TrajectoryWriter::TrajectoryWriter(size_t queueDepth)
+        : queue(queueDepth) {
+    }
+
+    TrajectoryWriter::~TrajectoryWriter() {
+        close();
+    }
+
+    bool TrajectoryWriter::open(const std::string& path, const TrajectoryInfo& recording, std::string& error) {
+        close();
+        if (recording.particleCount == 0 || recording.worldWidth <= 0.0f || recording.worldHeight <= 0.0f) {
+            error = "nothing to record";
+            return false;
+        }
+
+        file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            error = "could not open '" + path + "' for writing";
+            return false;
+        }
+
+        info = recording;
+        info.stepInterval = std::max<uint32_t>(1, info.stepInterval);
+        info.keyframeInterval = std::max<uint32_t>(1, info.keyframeInterval);
+
+        TrajectoryHeader header {};
+        std::memcpy(header.magic, kTrajectoryMagic, sizeof(header.magic));
+        header.version = kTrajectoryVersion;
+        header.headerBytes = sizeof(TrajectoryHeader);
+        header.particleCount = info.particleCount;
+        header.stepInterval = info.stepInterval;
+        header.keyframeInterval = info.keyframeInterval;
+        header.worldWidth = info.worldWidth;
+        header.worldHeight = info.worldHeight;
+        header.deltaTime = info.deltaTime;
+        if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+            error = "write to '" + path + "' failed";
+            std::fclose(file);
+            file = nullptr;
+            return false;
+        }
+
+        byteCount = sizeof(header);
+        previous[0].clear();
+        previous[1].clear();
+        queue.start(1, [this](Frame& frame) { return write(frame); });
+        return true;
+    }
+
+    void TrajectoryWriter::push(uint64_t step, std::vector<uint32_t> quantized) {
+        if (file == nullptr || quantized.size() != info.particleCount) return;
+        queue.push(step, std::move(quantized));
+    }
+
+    bool TrajectoryWriter::close() {
+        if (file == nullptr) return true;
+        const bool written = queue.stop();
+        const bool ok = std::fclose(file) == 0 && written;
+        file = nullptr;
+        return ok;
+    }
+
+    uint64_t TrajectoryWriter::bytesWritten() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return byteCount;
+    }
+
+    bool TrajectoryWriter::write(Frame& frame) {
+        TrajectoryFrameHeader header {};
+        header.step = frame.key;
+        header.order = (uint8_t)encode(frame);
+        header.payloadBytes = (uint32_t)payload.size();
+        const bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+            && std::fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+
+        // The frame becomes the prediction base; the oldest base is recycled
+        std::vector<uint32_t> spent = std::move(previous[1]);
+        previous[1] = std::move(previous[0]);
+        previous[0] = std::move(frame.data);
+        frame.data = std::move(spent);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        byteCount += sizeof(header) + payload.size();
+        return written;
+    }
+
+    int TrajectoryWriter::encode(const Frame& frame) {
+        const uint64_t sinceKey = frame.sequence % info.keyframeInterval;
+        const int order = sinceKey == 0 ? 0 : (int)std::min<uint64_t>(sinceKey, 2);
+        const std::vector<uint32_t>& positions = frame.data;
+
+        payload.clear();
+        if (order == 0) {
+            payload.resize(positions.size() * sizeof(uint32_t));
+            std::memcpy(payload.data(), positions.data(), payload.size());
+            return order;
+        }
+
+        for (size_t i = 0; i < positions.size(); ++i) {
+            for (int axis = 0; axis < 2; ++axis) {
+                putVarint(payload, component(positions[i], axis) - predict(previous, order, i, axis));
+            }
+        }
+        return order;
+    }
+
+    TrajectoryReader::~TrajectoryReader() {
+        if (file) std::fclose(file);
+    }
+
+    bool TrajectoryReader::open(const std::string& path, std::string& error) {
+        if (file) std::fclose(file);
+        previous[0].clear();
+        previous[1].clear();
+        lastError.clear();
+
+        file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            error = "could not open '" + path + "'";
+            return false;
+        }
+
+        TrajectoryHeader header;
+        if (std::fread(&header, sizeof(header), 1, file) != 1
+            || std::memcmp(header.magic, kTrajectoryMagic, sizeof(header.magic)) != 0) {
+            error = "'" + path + "' is not a trajectory file";
+        } else if (header.version != kTrajectoryVersion) {
+            error = "'" + path + "' has unsupported version " + std::to_string(header.version);
+        } else if (header.headerBytes < sizeof(header)
+                   || std::fseek(file, (long)header.headerBytes, SEEK_SET) != 0) {
+            error = "'" + path + "' has a corrupt header";
+        } else {
+            info.particleCount = header.particleCount;
+            info.stepInterval = header.stepInterval;
+            info.keyframeInterval = header.keyframeInterval;
+            info.worldWidth = header.worldWidth;
+            info.worldHeight = header.worldHeight;
+            info.deltaTime = header.deltaTime;
+            return true;
+        }
+
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    bool TrajectoryReader::next(uint64_t& step, std::vector<uint32_t>& quantized) {
+        if (file == nullptr) return false;
+
+        TrajectoryFrameHeader header;
+        if (std::fread(&header, sizeof(header), 1, file) != 1) {
+            return false; // end of file
+        }
+        const size_t count = (size_t)info.particleCount;
+        const bool keyFrame = header.order == 0;
+        if (header.order > 2 || (keyFrame && header.payloadBytes != count * sizeof(uint32_t))
+            || (!keyFrame && previous[header.order - 1].size() != count)) {
+            lastError = "corrupt frame header";
+            return false;
+        }
+
+        payload.resize(header.payloadBytes);
+        if (std::fread(payload.data(), 1, payload.size(), file) != payload.size()) {
+            lastError = "truncated frame";
+            return false;
+        }
+
+        quantized.resize(count);
+        if (keyFrame) {
+            std::memcpy(quantized.data(), payload.data(), payload.size());
+        } else {
+            const uint8_t* in = payload.data();
+            const uint8_t* end = in + payload.size();
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t packed = 0;
+                for (int axis = 0; axis < 2; ++axis) {
+                    int32_t residual;
+                    if (!getVarint(in, end, residual)) {
+                        lastError = "truncated frame payload";
+                        return false;
+                    }
+                    packed |= ((uint32_t)(predict(previous, header.order, i, axis) + residual) & 0xFFFFu) << (16 * axis);
+                }
+                quantized[i] = packed;
+            }
+        }
+
+        previous[1].swap(previous[0]);
+        previous[0] = quantized;
+        step = header.step;
+        return true;
+    }
+}
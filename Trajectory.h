@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "GPUParticle.h"
+#include "WorkQueue.h"
+
+namespace Particles {
+
+    // Trajectory files hold the position of every particle every
+    // stepInterval steps, quantized to 16 bits per axis against the world
+    // extents (1 unit = extent / 65535). Positions are packed as
+    // x | (y << 16), one uint32 per particle.
+    //
+    // Layout, version 1 (little-endian):
+    //
+    //   TrajectoryHeader                       64 bytes
+    //   frames, each:
+    //     TrajectoryFrameHeader                16 bytes
+    //     payload                              payloadBytes
+    //
+    // The payload of a key frame is the packed positions as they are. Every
+    // other frame stores, per particle and axis, the difference from a
+    // prediction: the previous frame (order 1) or linear extrapolation from
+    // the previous two (order 2). Differences are zigzag-mapped and written
+    // as LEB128 varints, so a particle moving a few pixels per frame costs
+    // two or three bytes instead of 64. A key frame starts the stream and
+    // then every keyframeInterval frames, so a reader can start there.
+    constexpr char kTrajectoryMagic[8] = { 'P', 'S', 'I', 'M', 'T', 'R', 'A', 'J' };
+    constexpr uint32_t kTrajectoryVersion = 1;
+    constexpr float kQuantizedMax = 65535.0f;
+
+    struct TrajectoryHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerBytes;
+        uint64_t particleCount;
+        uint32_t stepInterval;
+        uint32_t keyframeInterval;
+        float worldWidth;
+        float worldHeight;
+        float deltaTime;
+        uint32_t reserved[5];
+    };
+    static_assert(sizeof(TrajectoryHeader) == 64, "trajectory header layout");
+
+    struct TrajectoryFrameHeader {
+        uint64_t step;
+        uint32_t payloadBytes;
+        uint8_t order; // 0 = key frame, 1 or 2 = prediction order
+        uint8_t reserved[3];
+    };
+    static_assert(sizeof(TrajectoryFrameHeader) == 16, "trajectory frame header layout");
+
+    // What a recording covers; particleCount stays fixed for the whole file
+    struct TrajectoryInfo {
+        uint64_t particleCount = 0;
+        uint32_t stepInterval = 1;
+        uint32_t keyframeInterval = 64;
+        float worldWidth = 0.0f;
+        float worldHeight = 0.0f;
+        float deltaTime = 0.0f;
+    };
+
+    // scale = kQuantizedMax / extent. The GPU quantization pass uses the
+    // same operations, so both backends record identical values.
+    inline uint32_t quantizePosition(float x, float y, float scaleX, float scaleY) {
+        const float qx = std::floor(std::min(std::max(x * scaleX, 0.0f), kQuantizedMax) + 0.5f);
+        const float qy = std::floor(std::min(std::max(y * scaleY, 0.0f), kQuantizedMax) + 0.5f);
+        return (uint32_t)qx | ((uint32_t)qy << 16);
+    }
+
+    inline float dequantizeX(uint32_t packed, float worldWidth) {
+        return (float)(packed & 0xFFFFu) * (worldWidth / kQuantizedMax);
+    }
+
+    inline float dequantizeY(uint32_t packed, float worldHeight) {
+        return (float)(packed >> 16) * (worldHeight / kQuantizedMax);
+    }
+
+    void quantizePositions(const std::vector<GPUParticle>& particles, float worldWidth, float worldHeight,
+                           std::vector<uint32_t>& quantized);
+
+    // Encodes and writes frames on a background thread, fed through a
+    // WorkQueue. Prediction bases that drop out of use go back to the queue
+    // as spare buffers for takeBuffer().
+    class TrajectoryWriter {
+    public:
+        explicit TrajectoryWriter(size_t queueDepth = 8);
+        ~TrajectoryWriter();
+        TrajectoryWriter(const TrajectoryWriter&) = delete;
+        TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+        bool open(const std::string& path, const TrajectoryInfo& info, std::string& error);
+        bool isOpen() const { return file != nullptr; }
+        const TrajectoryInfo& getInfo() const { return info; }
+
+        std::vector<uint32_t> takeBuffer() { return queue.takeBuffer(); }
+        // quantized must hold info.particleCount packed positions
+        void push(uint64_t step, std::vector<uint32_t> quantized);
+        // Writes every queued frame and closes the file; false if any write failed
+        bool close();
+
+        uint64_t framesWritten() const { return queue.itemsProcessed(); }
+        uint64_t bytesWritten() const;
+
+    private:
+        using Frame = WorkQueue<uint32_t>::Item;
+
+        TrajectoryInfo info;
+        std::FILE* file { nullptr };
+        WorkQueue<uint32_t> queue;
+        mutable std::mutex mutex; // guards byteCount
+        uint64_t byteCount { 0 };
+
+        // Encoder state, only touched by the worker
+        std::vector<uint32_t> previous[2]; // [0] = last frame, [1] = the one before
+        std::vector<uint8_t> payload;
+
+        bool write(Frame& frame);
+        // Fills payload and returns the frame's prediction order
+        int encode(const Frame& frame);
+    };
+
+    // Reads a trajectory file front to back
+    class TrajectoryReader {
+    public:
+        TrajectoryReader() = default;
+        ~TrajectoryReader();
+        TrajectoryReader(const TrajectoryReader&) = delete;
+        TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+        bool open(const std::string& path, std::string& error);
+        const TrajectoryInfo& getInfo() const { return info; }
+
+        // Decodes the next frame into quantized (packed positions). Returns
+        // false at the end of the file or, with error set, on a corrupt one.
+        bool next(uint64_t& step, std::vector<uint32_t>& quantized);
+        const std::string& error() const { return lastError; }
+
+    private:
+        TrajectoryInfo info;
+        std::FILE* file { nullptr };
+        std::vector<uint32_t> previous[2];
+        std::vector<uint8_t> payload;
+        std::string lastError;
+    };
+}
@@ -0,0 +1,85 @@
+// Reads a trajectory recorded with --record: prints a summary and
+// optionally converts it to CSV (step,particle,x,y in world units)
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Trajectory.h"
+
+int main(int argc, char** argv) {
+    std::string inputPath;
+    std::string csvPath;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--csv=", 0) == 0 && arg.size() > 6) {
+            csvPath = arg.substr(6);
+        } else if (inputPath.empty() && arg.rfind("--", 0) != 0) {
+            inputPath = arg;
+        } else {
+            inputPath.clear();
+            break;
+        }
+    }
+    if (inputPath.empty()) {
+        std::cout << "Usage: ParticleTrajectoryDump FILE [--csv=OUT]" << std::endl;
+        return -1;
+    }
+
+    Particles::TrajectoryReader reader;
+    std::string error;
+    if (!reader.open(inputPath, error)) {
+        std::cout << "Failed to open trajectory: " << error << std::endl;
+        return -1;
+    }
+    const Particles::TrajectoryInfo& info = reader.getInfo();
+
+    std::FILE* csv = nullptr;
+    if (!csvPath.empty()) {
+        csv = std::fopen(csvPath.c_str(), "w");
+        if (csv == nullptr) {
+            std::cout << "Failed to open '" << csvPath << "' for writing" << std::endl;
+            return -1;
+        }
+        std::fprintf(csv, "step,particle,x,y\n");
+    }
+
+    std::vector<uint32_t> quantized;
+    uint64_t step = 0;
+    uint64_t frames = 0;
+    uint64_t firstStep = 0;
+    while (reader.next(step, quantized)) {
+        if (frames++ == 0) firstStep = step;
+        if (csv != nullptr) {
+            for (size_t i = 0; i < quantized.size(); ++i) {
+                std::fprintf(csv, "%llu,%zu,%g,%g\n", (unsigned long long)step, i,
+                             Particles::dequantizeX(quantized[i], info.worldWidth),
+                             Particles::dequantizeY(quantized[i], info.worldHeight));
+            }
+        }
+    }
+    if (csv != nullptr) std::fclose(csv);
+
+    std::FILE* file = std::fopen(inputPath.c_str(), "rb");
+    long long fileBytes = 0;
+    if (file != nullptr) {
+        std::fseek(file, 0, SEEK_END);
+        fileBytes = std::ftell(file);
+        std::fclose(file);
+    }
+    const double particleFrames = (double)frames * (double)info.particleCount;
+
+    std::cout << info.particleCount << " particles, " << info.worldWidth << "x" << info.worldHeight
+              << " world, dt " << info.deltaTime << ", every " << info.stepInterval << " steps, key frame every "
+              << info.keyframeInterval << " frames\n"
+              << frames << " frames (steps " << firstStep << " to " << step << "), " << fileBytes << " bytes, "
+              << (particleFrames > 0.0 ? fileBytes / particleFrames : 0.0)
+              << " bytes per particle-frame (raw GPUParticle: " << sizeof(GPUParticle) << ")" << std::endl;
+
+    if (!reader.error().empty()) {
+        std::cout << "Stopped early: " << reader.error() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "TrajectoryRecorder.h"
+
+namespace Particles {
+
+    TrajectoryRecorder::TrajectoryRecorder(TrajectoryWriter& writer, Renderer* renderer)
+        : writer(writer), renderer(renderer) {
+    }
+
+    void TrajectoryRecorder::afterStep(uint64_t step, const std::vector<GPUParticle>* cpuParticles) {
+        const TrajectoryInfo& info = writer.getInfo();
+        if (!writer.isOpen() || step % info.stepInterval != 0) return;
+
+        if (renderer == nullptr) {
+            if (cpuParticles == nullptr) return;
+            std::vector<uint32_t> quantized = writer.takeBuffer();
+            quantizePositions(*cpuParticles, info.worldWidth, info.worldHeight, quantized);
+            writer.push(step, std::move(quantized));
+            return;
+        }
+
+        // A full ring means the GPU is more than kPositionSlots recorded
+        // steps behind; wait for the oldest to make room
+        while (!renderer->requestPositions((size_t)info.particleCount, step, info.worldWidth, info.worldHeight)) {
+            if (!forwardOldest(true)) return;
+        }
+        poll();
+    }
+
+    void TrajectoryRecorder::poll() {
+        while (renderer != nullptr && forwardOldest(false)) {
+        }
+    }
+
+    void TrajectoryRecorder::finish() {
+        while (renderer != nullptr && renderer->positionsInFlight() > 0) {
+            forwardOldest(true);
+        }
+    }
+
+    bool TrajectoryRecorder::forwardOldest(bool wait) {
+        std::vector<uint32_t> quantized = writer.takeBuffer();
+        uint64_t step = 0;
+        if (!renderer->pollPositions(quantized, step, wait)) return false;
+        writer.push(step, std::move(quantized));
+        return true;
+    }
+}
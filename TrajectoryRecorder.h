@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GPUParticle.h"
+#include "Renderer.h"
+#include "Trajectory.h"
+
+namespace Particles {
+
+    // Feeds a TrajectoryWriter from either physics backend. With a renderer
+    // the positions are quantized on the GPU and come back through its
+    // fenced readback ring; without one (CPU backend) they are quantized
+    // from the simulator's particles. Either way the render loop only waits
+    // when every readback slot or the writer's queue is full.
+    class TrajectoryRecorder {
+    public:
+        // renderer == nullptr records from the particles passed to afterStep()
+        TrajectoryRecorder(TrajectoryWriter& writer, Renderer* renderer);
+
+        // Call once after every step; records every stepInterval-th step
+        void afterStep(uint64_t step, const std::vector<GPUParticle>* cpuParticles = nullptr);
+        // Hands finished readbacks to the writer without waiting
+        void poll();
+        // Waits for every readback in flight and hands it to the writer
+        void finish();
+
+    private:
+        TrajectoryWriter& writer;
+        Renderer* renderer;
+
+        bool forwardOldest(bool wait);
+    };
+}
@@ -0,0 +1,71 @@
+#include "UniverseBatch.h"
+
+#include "ParticleSpawner.h"
+
+namespace Particles {
+
+    UniverseBatch::UniverseBatch(float worldWidth, float worldHeight, size_t threadCount,
+                                 const SimulationParams& params)
+        : worldWidth(worldWidth), worldHeight(worldHeight), params(params), pool(threadCount),
+          forceKernel(bestForceKernel()) {
+    }
+
+    bool UniverseBatch::setForceKernel(ForceKernelIsa isa) {
+        if (!forceKernelAvailable(isa)) return false;
+        forceKernel = isa;
+        for (Universe& universe : universes) {
+            universe.sim->setForceKernel(isa);
+        }
+        return true;
+    }
+
+    size_t UniverseBatch::add(const std::vector<GPUParticle>& particles, const Color::AttractionMatrix& matrix,
+                              uint32_t rngSeed) {
+        Universe universe;
+        // One thread each: the batch parallelizes across universes instead
+        universe.sim = std::make_unique<CpuSimulator>(worldWidth, worldHeight, 1, params);
+        universe.sim->setAttractionMatrix(matrix);
+        universe.sim->setForceKernel(forceKernel);
+        universe.sim->setParticles(particles);
+        universe.matrix = matrix;
+        universe.rng.seed(rngSeed);
+        universes.push_back(std::move(universe));
+        return universes.size() - 1;
+    }
+
+    void UniverseBatch::step(float deltaTime, bool rollDeaths) {
+        pool.parallelFor(universes.size(), [&](size_t begin, size_t end) {
+            for (size_t u = begin; u < end; ++u) {
+                Universe& universe = universes[u];
+                universe.sim->step(deltaTime);
+                if (!rollDeaths) continue;
+
+                std::vector<GPUParticle>& particles = universe.sim->particles();
+                universe.stepArena.reset();
+                const DeathRoll deaths = Particles::rollDeaths(universe.rng, particles.size(), worldWidth,
+                                                               worldHeight, universe.stepArena);
+                for (size_t i = 0; i < deaths.count; ++i) {
+                    particles[deaths.indices[i]] = deaths.births[i];
+                }
+            }
+        }, 1);
+    }
+
+    const std::vector<GPUParticle>& UniverseBatch::particles(size_t universe) const {
+        return universes[universe].sim->particles();
+    }
+
+    const Color::AttractionMatrix& UniverseBatch::attraction(size_t universe) const {
+        return universes[universe].matrix;
+    }
+
+    double UniverseBatch::meanKineticEnergy(size_t universe) const {
+        const std::vector<GPUParticle>& particles = universes[universe].sim->particles();
+        if (particles.empty()) return 0.0;
+        double energy = 0.0;
+        for (const GPUParticle& p : particles) {
+            energy += 0.5 * (double)p.mass * ((double)p.vx * p.vx + (double)p.vy * p.vy);
+        }
+        return energy / (double)particles.size();
+    }
+}
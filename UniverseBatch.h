@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Color.h"
+#include "CpuSimulator.h"
+#include "FrameArena.h"
+#include "GPUParticle.h"
+#include "SimulationParams.h"
+#include "ThreadPool.h"
+
+namespace Particles {
+
+    // M independent simulations stepped together, for searches over
+    // attraction matrices. Each universe has its own particles, attraction
+    // matrix and death/rebirth RNG, and all of them share the world size,
+    // parameters and species count. A step advances every universe once,
+    // handing whole universes to the worker threads: with many small worlds
+    // this keeps every core busy where splitting a single world would not.
+    //
+    // A universe always runs on one thread, and CpuSimulator results do not
+    // depend on the thread count, so each universe evolves exactly like a
+    // standalone run with the same particles, matrix and seed.
+    class UniverseBatch {
+    public:
+        // threadCount == 0 uses every hardware thread
+        UniverseBatch(float worldWidth, float worldHeight, size_t threadCount = 0,
+                      const SimulationParams& params = SimulationParams{});
+
+        // Adds a universe and returns its index. rngSeed seeds its
+        // death/rebirth RNG.
+        size_t add(const std::vector<GPUParticle>& particles, const Color::AttractionMatrix& matrix,
+                   uint32_t rngSeed);
+
+        // Advances every universe by one step; with rollDeaths each one then
+        // replaces its dead particles as rollDeaths() decides
+        void step(float deltaTime, bool rollDeaths = true);
+
+        // Force kernel of every universe, present and future (see
+        // CpuSimulator::setForceKernel); false if isa is not available
+        bool setForceKernel(ForceKernelIsa isa);
+
+        size_t size() const { return universes.size(); }
+        size_t threadCount() const { return pool.size(); }
+        const std::vector<GPUParticle>& particles(size_t universe) const;
+        const Color::AttractionMatrix& attraction(size_t universe) const;
+
+        // Mean of m |v|^2 / 2 over a universe's particles
+        double meanKineticEnergy(size_t universe) const;
+
+    private:
+        struct Universe {
+            std::unique_ptr<CpuSimulator> sim;
+            Color::AttractionMatrix matrix;
+            std::mt19937 rng;
+            FrameArena stepArena { 4 * 1024 }; // death/rebirth lists of the current step
+
+        };
+
+        float worldWidth;
+        float worldHeight;
+        SimulationParams params;
+        ThreadPool pool;
+        ForceKernelIsa forceKernel;
+        std::vector<Universe> universes;
+    };
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Particles {
+
+    // Bounded hand-off from the simulation thread to background workers,
+    // shared by the trajectory and frame writers. push() moves a buffer in
+    // without copying; once depth items are waiting it blocks, so output can
+    // slow the simulation down but never grows without bound. Each worker
+    // calls process() on one item at a time, in push order across workers;
+    // afterwards the item's buffer (or whatever process() leaves in it) is
+    // kept for takeBuffer() to hand out again.
+    template <typename Element>
+    class WorkQueue {
+    public:
+        using Buffer = std::vector<Element>;
+
+        struct Item {
+            uint64_t key;     // passed through from push()
+            uint64_t sequence; // 0, 1, 2, ... in push order since start()
+            Buffer data;
+        };
+
+        // Returns false if the item could not be written
+        using Process = std::function<bool(Item& item)>;
+
+        explicit WorkQueue(size_t depth)
+            : depth(std::max<size_t>(1, depth)) {}
+        ~WorkQueue() { stop(); }
+        WorkQueue(const WorkQueue&) = delete;
+        WorkQueue& operator=(const WorkQueue&) = delete;
+
+        void start(size_t threads, Process process) {
+            stop();
+            work = std::move(process);
+            stopping = false;
+            failed = false;
+            pushed = 0;
+            processed = 0;
+            for (size_t i = 0; i < std::max<size_t>(1, threads); ++i) {
+                workers.emplace_back([this] { run(); });
+            }
+        }
+
+        // Processes every queued item and joins the workers; false if any
+        // process() call failed since start()
+        bool stop() {
+            if (workers.empty()) return true;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (std::thread& worker : workers) worker.join();
+            workers.clear();
+            return !failed;
+        }
+
+        // An empty buffer or, once items have been processed, a spent one
+        Buffer takeBuffer() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (spareBuffers.empty()) return {};
+            Buffer buffer = std::move(spareBuffers.back());
+            spareBuffers.pop_back();
+            return buffer;
+        }
+
+        void push(uint64_t key, Buffer data) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                space.wait(lock, [&] { return items.size() < depth; });
+                items.push_back(Item { key, pushed++, std::move(data) });
+            }
+            wake.notify_one();
+        }
+
+        uint64_t itemsProcessed() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return processed;
+        }
+
+        size_t getDepth() const { return depth; }
+
+    private:
+        size_t depth;
+        Process work;
+        std::vector<std::thread> workers;
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable space;
+        std::deque<Item> items;
+        std::vector<Buffer> spareBuffers;
+        bool stopping { false };
+        bool failed { false };
+        uint64_t pushed { 0 };
+        uint64_t processed { 0 };
+
+        void run() {
+            for (;;) {
+                Item item;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [&] { return stopping || !items.empty(); });
+                    if (items.empty()) return;
+                    item = std::move(items.front());
+                    items.pop_front();
+                }
+                space.notify_one();
+
+                const bool ok = work(item);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = failed || !ok;
+                ++processed;
+                if (item.data.capacity() > 0 && spareBuffers.size() < depth) {
+                    spareBuffers.push_back(std::move(item.data));
+                }
+            }
+        }
+    };
+}
@@ -1,68 +1,55 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <memory>
 #include <random>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include "ConfigWatcher.h"
+#include "CpuSimulator.h"
+#include "FrameArena.h"
+#include "FrameCapture.h"
+#include "FrameExport.h"
+#include "HeadlessRun.h"
+#include "LaunchOptions.h"
+#include "Metrics.h"
+#include "MetricsRecorder.h"
+#include "ParticleSpawner.h"
+#include "Profiler.h"
 #include "Renderer.h"
+#include "Snapshot.h"
+#include "Trajectory.h"
+#include "TrajectoryRecorder.h"
 #include "Geometry.h"
 #include "Color.h"
 #include "GPUParticle.h"
 
 using namespace Geometry;
 using namespace Color;
+using namespace Particles;
 
-// Set this to false to disable the P, R, and Esc keybindings
+// Set this to false to disable the P, R, G, T, C, V, S, L, D and Esc keybindings
 constexpr bool ENABLE_KEYBINDINGS = true;
-constexpr float DEATH_PROBABILITY = 0.0001f;
 
 // A simple struct to hold the simulation's state
 struct SimulationState {
     bool isPaused = false;
     bool shouldRestart = false;
+    bool shouldToggleNeighborSearch = false;
+    bool shouldToggleProfiler = false;
+    bool shouldToggleTrace = false;
+    bool shouldToggleIntegrator = false;
+    bool shouldCycleBoundary = false;
+    bool shouldSaveSnapshot = false;
+    bool shouldLoadSnapshot = false;
+    bool shouldToggleDrawMode = false;
 };
 
-float generateRandomRadius(std::mt19937& rng, float maxRadius) {
-    // Probability is inversely proportional to radius
-    
-    // Create a piecewise linear distribution
-    // Probability density: f(r) = k/r where k is normalization constant
-    // Over [1,3]: integral of k/r dr = k * ln(3) = 1, so k = 1/ln(3)
-    
-    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
-    float u = uniform(rng);
-    
-    // Inverse CDF: F^(-1)(u) = exp(u * ln(3))
-    // This gives us the desired inverse probability distribution
-    return std::exp(u * std::log(maxRadius));
-}
-
-inline float calculateMass(float radius) {
-    // For simplicity, we'll use just r³ as the mass (ignoring constants)
-    return radius * radius * radius;
-}
-
-GPUParticle createRandomParticle(std::mt19937& rng, const GLFWvidmode* videoMode) {
-    std::uniform_real_distribution<float> xdist(0.0f, (float)videoMode->width);
-    std::uniform_real_distribution<float> ydist(0.0f, (float)videoMode->height);
-    std::uniform_int_distribution<size_t> colorVal(0, NUM_SPECIES - 1);
-    
-    const float radius = 1.0f;
-    const float mass = calculateMass(radius);
-    const auto color = colorMap.at(static_cast<ColorSpecies>(colorVal(rng)));
-    
-    return GPUParticle{
-        xdist(rng), ydist(rng),                   // px, py
-        0.0f, 0.0f,                               // vx, vy
-        radius, mass,                             // radius, mass
-        {0.0f, 0.0f},                             // _gap_to_32
-        color.r, color.g, color.b, 1.0f,          // r, g, b, a
-        colorToSpecies(color),                    // species
-        0.0f,                                     // _pad1
-        {0.0f, 0.0f}                              // _pad2
-    };
-}
-
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     auto* state = static_cast<SimulationState*>(glfwGetWindowUserPointer(window));
     if (state == nullptr) return;
@@ -78,30 +65,57 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             case GLFW_KEY_R:
                 state->shouldRestart = true;
                 break;
+            case GLFW_KEY_G:
+                state->shouldToggleNeighborSearch = true;
+                break;
+            case GLFW_KEY_T:
+                state->shouldToggleProfiler = true;
+                break;
+            case GLFW_KEY_C:
+                state->shouldToggleTrace = true;
+                break;
+            case GLFW_KEY_V:
+                state->shouldToggleIntegrator = true;
+                break;
+            case GLFW_KEY_B:
+                state->shouldCycleBoundary = true;
+                break;
+            case GLFW_KEY_S:
+                state->shouldSaveSnapshot = true;
+                break;
+            case GLFW_KEY_L:
+                state->shouldLoadSnapshot = true;
+                break;
+            case GLFW_KEY_D:
+                state->shouldToggleDrawMode = true;
+                break;
         }
     }
 }
 
-void resetSimulation(
-    std::vector<GPUParticle>& particles,
-    int numPoints,
-    const GLFWvidmode* videoMode
-) {
-    particles.clear();
-
-    std::mt19937 rng{std::random_device{}()};
-    
-    for (int i = 0; i < numPoints; ++i) {
-        particles.push_back(createRandomParticle(rng, videoMode));
-    }
-}
 
+int main(int argc, char** argv) {
+	LaunchOptions options;
+	if (!parseLaunchOptions(argc, argv, options)) {
+		return -1;
+	}
 
-int main() {
-	// Load attraction matrix from file
-	if (!loadAttractionMatrixFromFile()) {
+	// Load attraction matrix and simulation parameters from file
+	if (!loadAttractionMatrixFromFile(options.matrixPath)) {
 		std::cout << "Using default attraction matrix." << std::endl;
 	}
+	if (std::filesystem::exists(options.paramsPath)) {
+		std::string error;
+		if (readSimulationParams(options.paramsPath, options.params, error)) {
+			std::cout << "Loaded simulation parameters from '" << options.paramsPath << "'" << std::endl;
+		} else {
+			std::cout << "Warning: Simulation parameters " << error << ". Using defaults." << std::endl;
+		}
+	}
+
+	if (options.headless) {
+		return runHeadless(options);
+	}
 	
 	if (!glfwInit()) {
 		std::cout << "Failed to initialize GLFW" << std::endl;
@@ -143,9 +157,10 @@ int main() {
     glEnable(GL_BLEND);
 
 
-	glClearColor(0.04f, 0.05f, 0.1f, 1.0f);
+	glClearColor(kBackgroundColor[0], kBackgroundColor[1], kBackgroundColor[2], kBackgroundColor[3]);
 
-	constexpr int numPoints = 30000;
+	// Replaced by the particle count of a loaded snapshot
+	int numPoints = 30000;
 	
     // Create state and set up callbacks
     SimulationState simState;
@@ -159,83 +174,491 @@ int main() {
 	std::vector<GPUParticle> particles;
 	particles.reserve(numPoints);
 
-    // Perform the initial simulation setup
-    resetSimulation(particles, numPoints, mode);
+    // Perform the initial simulation setup; the world fills the screen
+    // whatever its size
+    const float worldWidth = options.worldSizeGiven ? options.worldWidth : (float)mode->width;
+    const float worldHeight = options.worldSizeGiven ? options.worldHeight : (float)mode->height;
+    resetSimulation(particles, numPoints, worldWidth, worldHeight, std::random_device{}());
 
-	Particles::Renderer renderer(window);
+	Particles::Profiler profiler;
+	profiler.setEnabled(options.profile);
 
-	// Initialize GPU buffer
-	GLuint particleBuffer = 0;
-	renderer.initializeGPUBuffer(particles, particleBuffer);
+	Particles::Renderer renderer(window, worldWidth, worldHeight);
+	renderer.setProfiler(&profiler);
+
+	renderer.setSimulationParams(options.params);
+	renderer.setDrawMode(options.drawMode);
+
+	// Initialize GPU buffers
+	renderer.initializeGPUBuffer(particles);
 	
 	// Set up GPU geometry
-	renderer.createGeometryGPU(particleBuffer);
+	renderer.createGeometryGPU();
+
+	// With the CPU backend the GPU buffer only mirrors the simulator for drawing
+	std::unique_ptr<Particles::CpuSimulator> cpuSim;
+	if (options.backend == PhysicsBackend::Cpu) {
+		cpuSim = std::make_unique<Particles::CpuSimulator>(
+			worldWidth, worldHeight, options.threads, renderer.getSimulationParams());
+		cpuSim->setParticles(particles);
+		if (options.forceKernelGiven) cpuSim->setForceKernel(options.forceKernel);
+		std::cout << "CPU physics backend with " << cpuSim->threadCount() << " threads, "
+		          << Particles::forceKernelName(cpuSim->getForceKernel()) << " force kernel." << std::endl;
+	}
 
-	// Time tracking for delta time
-	double lastTime = glfwGetTime();
+	// Edits to the matrix and parameter files apply between steps
+	Particles::ConfigWatcher configWatcher;
+	if (options.watch) {
+		std::string error;
+		if (configWatcher.start(options.matrixPath, options.paramsPath, error)) {
+			std::cout << "Watching '" << options.matrixPath << "' and '" << options.paramsPath << "' for changes" << std::endl;
+		} else {
+			std::cout << "Hot reload unavailable: " << error << std::endl;
+		}
+	}
 
 	std::mt19937 rng{std::random_device{}()};
+	// Per-frame scratch (the death/rebirth lists), released at the top of every frame
+	Particles::FrameArena frameArena;
+
+	// Fixed step length; a loaded snapshot brings its own
+	float stepDt = options.deltaTime;
+	uint64_t stepCount = 0;
+
+	// Saves run on the writer thread. On the GPU backend the particles come
+	// from a fenced readback that is polled once per frame, so saving never
+	// stalls the loop; pendingSnapshot holds the rest of the state as of
+	// the request.
+	Particles::SnapshotWriter snapshotWriter;
+	Particles::SnapshotState pendingSnapshot;
+	std::vector<GPUParticle> readbackParticles;
+
+	// Trajectory recording (--record), fed after every step
+	Particles::TrajectoryWriter trajectory;
+	Particles::TrajectoryRecorder recorder(trajectory, cpuSim ? nullptr : &renderer);
+
+	// Structure metrics (--metrics), measured every few steps. A state is
+	// measured by the step that starts from it; one that is about to be
+	// replaced instead is measured on the spot.
+	Particles::MetricsWriter metrics;
+	Particles::MetricsRecorder metricsRecorder(metrics, &renderer, cpuSim.get());
+
+	// Frame export (--export): every exportInterval-th presented frame is
+	// drawn offscreen at the export size, read back and encoded
+	Particles::FrameWriter frameWriter(options.exportThreads);
+	std::unique_ptr<Particles::FrameCapture> frameCapture;
+	uint64_t presentedFrames = 0;
+
+	// The metrics columns cover a fixed species count
+	auto stopMetricsIfSpeciesChange = [&](int species) {
+		if (!metrics.isOpen() || species == metrics.getInfo().numSpecies) return;
+		metricsRecorder.measureCurrent(stepCount, numPoints);
+		metricsRecorder.finish();
+		metrics.close();
+		std::cout << "Metrics stopped: the species count changed" << std::endl;
+	};
+
+	auto captureSnapshot = [&]() {
+		Particles::SnapshotState state;
+		state.stepCount = stepCount;
+		state.worldWidth = worldWidth;
+		state.worldHeight = worldHeight;
+		state.deltaTime = stepDt;
+		state.params = renderer.getSimulationParams();
+		state.attraction = Color::attractionMatrix;
+		std::ostringstream rngState;
+		rngState << rng;
+		state.rngState = rngState.str();
+		return state;
+	};
+
+	// Maps the file and uploads the particle array straight from the mapping
+	auto loadSnapshot = [&](const std::string& path) {
+		const auto start = std::chrono::steady_clock::now();
+		Particles::SnapshotFile snapshot;
+		std::string error;
+		if (!snapshot.open(path, error) || snapshot.particleCount() == 0) {
+			std::cout << "Failed to load snapshot: " << (error.empty() ? "no particles" : error) << std::endl;
+			return false;
+		}
+		const Particles::SnapshotState& state = snapshot.state();
+		if (state.worldWidth != worldWidth || state.worldHeight != worldHeight) {
+			std::cout << "Snapshot world is " << state.worldWidth << "x" << state.worldHeight
+			          << ", the window is " << worldWidth << "x" << worldHeight << std::endl;
+		}
+
+		// A recording covers a fixed particle count
+		if (trajectory.isOpen() && snapshot.particleCount() != trajectory.getInfo().particleCount) {
+			recorder.finish();
+			trajectory.close();
+			std::cout << "Recording stopped: the snapshot has a different particle count" << std::endl;
+		}
+
+		stopMetricsIfSpeciesChange(Color::speciesCount(state.attraction));
+		metricsRecorder.measureCurrent(stepCount, numPoints);
+		Color::attractionMatrix = state.attraction;
+		renderer.setAttractionMatrix(state.attraction);
+		renderer.setSimulationParams(state.params);
+		numPoints = (int)snapshot.particleCount();
+		renderer.uploadParticles(snapshot.particles(), snapshot.particleCount());
+		if (cpuSim) {
+			cpuSim->setAttractionMatrix(state.attraction);
+			cpuSim->setParams(state.params);
+			cpuSim->setParticles(std::vector<GPUParticle>(snapshot.particles(),
+			                                              snapshot.particles() + snapshot.particleCount()));
+		}
+		std::istringstream(state.rngState) >> rng;
+		stepDt = state.deltaTime;
+		stepCount = state.stepCount;
+
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Loaded " << numPoints << " particles at step " << stepCount << " from '" << path
+		          << "' in " << ms << " ms" << std::endl;
+		return true;
+	};
+
+	if (!options.loadPath.empty() && !loadSnapshot(options.loadPath)) {
+		glfwTerminate();
+		return -1;
+	}
+
+	if (!options.recordPath.empty()) {
+		Particles::TrajectoryInfo recording;
+		recording.particleCount = (uint64_t)numPoints;
+		recording.stepInterval = options.recordInterval;
+		recording.worldWidth = worldWidth;
+		recording.worldHeight = worldHeight;
+		recording.deltaTime = stepDt;
+		std::string error;
+		if (!trajectory.open(options.recordPath, recording, error)) {
+			std::cout << "Failed to start recording: " << error << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		recorder.afterStep(stepCount, cpuSim ? &cpuSim->particles() : nullptr);
+	}
+
+	if (!options.metricsPath.empty()) {
+		Particles::MetricsInfo info;
+		info.numSpecies = Color::speciesCount(Color::attractionMatrix);
+		info.stepInterval = options.metricsInterval;
+		info.radius = options.metricsRadius;
+		std::string error;
+		if (!metrics.open(options.metricsPath, info, error)) {
+			std::cout << "Failed to start metrics: " << error << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+	}
+
+	int framebufferWidth = 0, framebufferHeight = 0;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+
+	if (!options.exportPath.empty()) {
+		// Defaults to the window, rounded down to even sizes for Y4M
+		Particles::FrameExportInfo info;
+		info.width = options.exportWidth > 0 ? options.exportWidth : framebufferWidth & ~1;
+		info.height = options.exportHeight > 0 ? options.exportHeight : framebufferHeight & ~1;
+		info.frameRate = options.exportFrameRate;
+		std::string error;
+		if (!frameWriter.open(options.exportPath, info, error)) {
+			std::cout << "Failed to start export: " << error << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		frameCapture = std::make_unique<Particles::FrameCapture>(frameWriter, renderer);
+		std::cout << "Exporting " << info.width << "x" << info.height << " frames to '" << options.exportPath << "'"
+		          << std::endl;
+	}
+
+	// Time tracking for the fixed-step scheduler; accumulator holds real
+	// time not yet simulated
+	double lastTime = glfwGetTime();
+	double accumulator = 0.0;
+	double lastProfileReport = lastTime;
+
 	while (!glfwWindowShouldClose(window)) {
+        profiler.beginFrame();
+        frameArena.reset();
+
         // Handle Restarting
         if (simState.shouldRestart) {
-            resetSimulation(particles, numPoints, mode);
-            // Re-upload all particle data to the GPU buffer
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleBuffer);
-            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, particles.size() * sizeof(GPUParticle), particles.data());
+            metricsRecorder.measureCurrent(stepCount, numPoints);
+            const uint32_t seed = (uint32_t)rng();
+            if (cpuSim) {
+                resetSimulation(particles, numPoints, worldWidth, worldHeight, seed);
+                cpuSim->setParticles(particles);
+                renderer.uploadParticles(particles);
+            } else {
+                // Drawn straight into the GPU buffer, nothing to upload
+                renderer.spawnParticles(numPoints, worldWidth, worldHeight, seed);
+            }
+            stepCount = 0;
             
             simState.shouldRestart = false;
             simState.isPaused = false;
         }
         
-        // Only update the simulation logic if not paused
-        if (!simState.isPaused) {
-            // ---- GPU simulation step ----
-            double currentTime = glfwGetTime();
-            float deltaTime = static_cast<float>(currentTime - lastTime);
-            lastTime = currentTime;
-            
-            deltaTime = std::min(deltaTime, 0.016f);
+        // Cycle uniform grid -> brute force -> tiled all-pairs -> uniform grid
+        if (simState.shouldToggleNeighborSearch) {
+            Particles::NeighborSearch next = Particles::NeighborSearch::UniformGrid;
+            const char* name = "uniform grid";
+            switch (renderer.getNeighborSearch()) {
+                case Particles::NeighborSearch::UniformGrid:
+                    next = Particles::NeighborSearch::BruteForce;
+                    name = "brute force";
+                    break;
+                case Particles::NeighborSearch::BruteForce:
+                    next = Particles::NeighborSearch::Tiled;
+                    name = "tiled all-pairs";
+                    break;
+                case Particles::NeighborSearch::Tiled:
+                    break;
+            }
+            renderer.setNeighborSearch(next);
+            std::cout << "Neighbor search: " << name << std::endl;
+            simState.shouldToggleNeighborSearch = false;
+        }
+
+        if (simState.shouldToggleProfiler) {
+            profiler.setEnabled(!profiler.isEnabled());
+            std::cout << "Profiler " << (profiler.isEnabled() ? "on" : "off") << std::endl;
+            simState.shouldToggleProfiler = false;
+        }
+        if (simState.shouldToggleTrace) {
+            if (!profiler.isTracing()) {
+                profiler.startTrace();
+                std::cout << "Capturing trace (press C again to stop)" << std::endl;
+            } else if (profiler.writeTrace(options.tracePath)) {
+                std::cout << "Trace written to '" << options.tracePath << "'" << std::endl;
+            }
+            simState.shouldToggleTrace = false;
+        }
+
+        if (simState.shouldToggleDrawMode) {
+            Particles::DrawMode next = Particles::DrawMode::Quads;
+            const char* name = "quads";
+            switch (renderer.getDrawMode()) {
+                case Particles::DrawMode::Quads:
+                    next = Particles::DrawMode::SinglePass;
+                    name = "single-pass HDR";
+                    break;
+                case Particles::DrawMode::SinglePass:
+                    next = Particles::DrawMode::DensitySplat;
+                    name = "density splat";
+                    break;
+                case Particles::DrawMode::DensitySplat:
+                    break;
+            }
+            renderer.setDrawMode(next);
+            std::cout << "Drawing: " << name << std::endl;
+            simState.shouldToggleDrawMode = false;
+        }
 
-            renderer.dispatchComputeShader(particleBuffer, numPoints, deltaTime);
+        if (simState.shouldToggleIntegrator) {
+            Particles::SimulationParams params = renderer.getSimulationParams();
+            const bool verlet = params.integrator != Particles::Integrator::VelocityVerlet;
+            params.integrator = verlet ? Particles::Integrator::VelocityVerlet
+                                       : Particles::Integrator::SemiImplicitEuler;
+            renderer.setSimulationParams(params);
+            if (cpuSim) {
+                cpuSim->setParams(params);
+            }
+            std::cout << "Integrator: " << (verlet ? "velocity Verlet" : "semi-implicit Euler") << std::endl;
+            simState.shouldToggleIntegrator = false;
+        }
+
+        if (simState.shouldCycleBoundary) {
+            Particles::SimulationParams params = renderer.getSimulationParams();
+            params.boundary = params.boundary == Particles::Boundary::Open ? Particles::Boundary::Torus
+                            : params.boundary == Particles::Boundary::Torus ? Particles::Boundary::Reflect
+                            : Particles::Boundary::Open;
+            renderer.setSimulationParams(params);
+            if (cpuSim) {
+                cpuSim->setParams(params);
+            }
+            std::cout << "Boundary: " << Particles::boundaryName(params.boundary) << std::endl;
+            simState.shouldCycleBoundary = false;
+        }
 
-            std::vector<size_t> deadIndices;
-            std::uniform_real_distribution<float> deathDist(0.0f, 1.0f);
+        if (simState.shouldSaveSnapshot) {
+            if (cpuSim) {
+                snapshotWriter.save(options.snapshotPath, captureSnapshot(), cpuSim->particles());
+            } else if (renderer.requestReadback(numPoints)) {
+                pendingSnapshot = captureSnapshot();
+            } else {
+                std::cout << "A snapshot is already being read back" << std::endl;
+            }
+            simState.shouldSaveSnapshot = false;
+        }
+        if (renderer.pollReadback(readbackParticles)) {
+            snapshotWriter.save(options.snapshotPath, std::move(pendingSnapshot), std::move(readbackParticles));
+        }
+        if (simState.shouldLoadSnapshot) {
+            loadSnapshot(options.snapshotPath);
+            simState.shouldLoadSnapshot = false;
+        }
 
-            for (size_t i = 0; i < numPoints; ++i) {
-                // Check if the particle dies this frame
-                if (deathDist(rng) < DEATH_PROBABILITY) {
-                    deadIndices.push_back(i);
+        Particles::ConfigUpdate config;
+        if (configWatcher.poll(config, renderer.getSimulationParams())) {
+            if (config.hasMatrix) {
+                const int previousSpecies = Color::speciesCount(Color::attractionMatrix);
+                const int species = Color::speciesCount(config.matrix);
+                stopMetricsIfSpeciesChange(species);
+                Color::attractionMatrix = std::move(config.matrix);
+                renderer.setAttractionMatrix(Color::attractionMatrix);
+                if (cpuSim) {
+                    cpuSim->setAttractionMatrix(Color::attractionMatrix);
                 }
+                // Positions and velocities carry over; species ids must
+                // stay below the new count and the palette may change
+                if (species != previousSpecies) {
+                    if (cpuSim) {
+                        assignSpecies(cpuSim->particles(), species);
+                        renderer.uploadParticles(cpuSim->particles());
+                    } else {
+                        particles.resize(numPoints);
+                        renderer.downloadParticles(particles);
+                        assignSpecies(particles, species);
+                        renderer.uploadParticles(particles);
+                    }
+                }
+                std::cout << "Reloaded attraction matrix with " << species << " species" << std::endl;
+            }
+            if (config.hasParams) {
+                // The file only holds the force law; the integrator and the
+                // boundary stay as chosen
+                Particles::SimulationParams params = config.params;
+                params.integrator = renderer.getSimulationParams().integrator;
+                params.boundary = renderer.getSimulationParams().boundary;
+                renderer.setSimulationParams(params);
+                if (cpuSim) {
+                    cpuSim->setParams(params);
+                }
+                std::cout << "Reloaded simulation parameters" << std::endl;
+            }
+        }
+
+        // ---- Fixed-timestep simulation ----
+        const double currentTime = glfwGetTime();
+        const double frameTime = currentTime - lastTime;
+        lastTime = currentTime;
+
+        // Only update the simulation logic if not paused
+        if (!simState.isPaused) {
+            int steps = options.substeps;
+            if (steps == 0) {
+                // Bank the frame time and spend it in whole steps; time beyond
+                // maxSubsteps steps is dropped instead of owed to later frames
+                accumulator = std::min(accumulator + frameTime, (double)options.maxSubsteps * stepDt);
+                steps = (int)(accumulator / stepDt);
+                accumulator -= steps * (double)stepDt;
             }
 
-            if (!deadIndices.empty()) {
-                std::vector<GPUParticle> newBirths;
-                newBirths.reserve(deadIndices.size());
-                
-                for (size_t i = 0; i < deadIndices.size(); ++i) {
-                    newBirths.push_back(createRandomParticle(rng, mode));
+            // All steps are queued back to back; nothing waits on the GPU
+            for (int step = 0; step < steps; ++step) {
+                {
+                    PROFILE_SCOPE(&profiler, "physics");
+                    if (cpuSim) {
+                        cpuSim->step(stepDt);
+                    } else {
+                        renderer.dispatchComputeShader(numPoints, stepDt);
+                    }
+                }
+                ++stepCount;
+
+                // Before the deaths: it measures the state the step started from
+                if (metrics.isOpen()) {
+                    PROFILE_SCOPE(&profiler, "metrics");
+                    metricsRecorder.afterStep(stepCount, numPoints);
+                }
+
+                {
+                    PROFILE_SCOPE(&profiler, "death/rebirth");
+                    const DeathRoll deaths = rollDeaths(rng, numPoints, worldWidth, worldHeight, frameArena);
+
+                    if (!deaths.empty()) {
+                        if (cpuSim) {
+                            for (size_t i = 0; i < deaths.count; ++i) {
+                                cpuSim->particles()[deaths.indices[i]] = deaths.births[i];
+                            }
+                        } else {
+                            renderer.writeParticles(deaths.indices, deaths.births, deaths.count);
+                        }
+                    }
                 }
 
-                glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleBuffer);
-                for (size_t i = 0; i < deadIndices.size(); ++i) {
-                    size_t gpuIndex = deadIndices[i];
-                    const GLsizeiptr offset = static_cast<GLsizeiptr>(gpuIndex) * sizeof(GPUParticle);
-                    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset,
-                                    sizeof(GPUParticle), &newBirths[i]);
+                if (trajectory.isOpen()) {
+                    PROFILE_SCOPE(&profiler, "record");
+                    recorder.afterStep(stepCount, cpuSim ? &cpuSim->particles() : nullptr);
                 }
             }
+            recorder.poll();
+            metricsRecorder.poll();
+
+            if (cpuSim && steps > 0) {
+                PROFILE_SCOPE(&profiler, "upload");
+                renderer.uploadParticles(cpuSim->particles());
+            }
         }
 
 		// ---- Draw (always, even when paused) ----
-		glClear(GL_COLOR_BUFFER_BIT);
-		renderer.drawPointsGPU(particleBuffer, numPoints);
-		glfwSwapBuffers(window);
+		{
+			PROFILE_SCOPE(&profiler, "draw");
+			if (frameCapture && presentedFrames % options.exportInterval == 0) {
+				PROFILE_SCOPE(&profiler, "export");
+				frameCapture->capture(numPoints);
+				frameCapture->present(framebufferWidth, framebufferHeight);
+			} else {
+				glClear(GL_COLOR_BUFFER_BIT);
+				renderer.drawPointsGPU(numPoints);
+			}
+			if (frameCapture) frameCapture->poll();
+			++presentedFrames;
+		}
+		profiler.drawOverlay(framebufferWidth, framebufferHeight);
+		{
+			PROFILE_SCOPE(&profiler, "swap");
+			glfwSwapBuffers(window);
+		}
+		profiler.endFrame();
 		glfwPollEvents();
+
+		// The overlay bars are unlabelled, so print the numbers once a second
+		if (profiler.isEnabled() && glfwGetTime() - lastProfileReport >= 1.0) {
+			std::cout << profiler.summary() << std::endl;
+			lastProfileReport = glfwGetTime();
+		}
+	}
+
+	if (trajectory.isOpen()) {
+		recorder.finish();
+		if (trajectory.close()) {
+			std::cout << "Recorded " << trajectory.framesWritten() << " frames to '" << options.recordPath << "'" << std::endl;
+		} else {
+			std::cout << "Failed to write trajectory '" << options.recordPath << "'" << std::endl;
+		}
+	}
+
+	if (metrics.isOpen()) {
+		metricsRecorder.measureCurrent(stepCount, numPoints);
+		metricsRecorder.finish();
+		const uint64_t rows = metrics.rowsWritten();
+		if (metrics.close()) {
+			std::cout << "Wrote " << rows << " metrics rows to '" << options.metricsPath << "'" << std::endl;
+		} else {
+			std::cout << "Failed to write metrics '" << options.metricsPath << "'" << std::endl;
+		}
 	}
 
-	// Cleanup
-	if (particleBuffer) {
-		glDeleteBuffers(1, &particleBuffer);
+	if (frameCapture) {
+		frameCapture->finish();
+		frameCapture.reset();
+		if (frameWriter.close()) {
+			std::cout << "Exported " << frameWriter.framesWritten() << " frames to '" << options.exportPath << "'" << std::endl;
+		} else {
+			std::cout << "Failed to write frames to '" << options.exportPath << "'" << std::endl;
+		}
 	}
 
 	glfwTerminate();
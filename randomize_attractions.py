@@ -1,5 +1,17 @@
+import argparse
 import random
 
+MIN_SPECIES = 2
+MAX_SPECIES = 64  # matching Color::MIN_SPECIES / Color::MAX_SPECIES
+
+# Names of the classic palette (the first eight values of ColorSpecies in Color.h)
+CLASSIC_SPECIES = ['RED', 'GREEN', 'BLUE', 'YELLOW', 'CYAN', 'MAGENTA', 'PURPLE', 'ORANGE']
+
+def species_names(num_species):
+    if num_species <= len(CLASSIC_SPECIES):
+        return CLASSIC_SPECIES[:num_species]
+    return [f"S{i}" for i in range(num_species)]
+
 # Generate randomized values directly
 def generate_random_matrix(num_values, low=1, high=5):
     values = []
@@ -11,56 +23,54 @@ def generate_random_matrix(num_values, low=1, high=5):
         values.append(rounded_val)
     return values
 
-def write_attraction_matrix_to_file(filename="attraction_matrix.txt"):
-    # Color species in order (matching the enum in Color.h)
-    species = ['RED', 'GREEN', 'BLUE', 'YELLOW', 'CYAN', 'MAGENTA', 'PURPLE', 'ORANGE']
-    
-    # Generate 64 random values (8x8 matrix)
-    values = generate_random_matrix(64)
-    
+def write_attraction_matrix_to_file(filename="attraction_matrix.txt", num_species=8):
+    species = species_names(num_species)
+
+    # One value per (from, to) pair
+    values = generate_random_matrix(num_species * num_species)
+
     # Write to file in a simple format: from_species to_species attraction_value
     with open(filename, 'w') as f:
         f.write("# Attraction matrix data\n")
         f.write("# Format: from_species to_species attraction_value\n")
+        f.write(f"# Species: {num_species}\n")
         f.write(f"# Species order: {' '.join(species)}\n")
         f.write("\n")
-        
+
         value_index = 0
-        for i, species1 in enumerate(species):
-            for j, species2 in enumerate(species):
+        for i in range(num_species):
+            for j in range(num_species):
                 value = values[value_index]
                 f.write(f"{i} {j} {value}\n")
                 value_index += 1
-    
-    print(f"Attraction matrix written to {filename}")
+
+    print(f"Attraction matrix with {num_species} species written to {filename}")
     return filename
 
-def generate_attraction_matrix_string():
-    # Color species in order
-    species = ['RED', 'GREEN', 'BLUE', 'YELLOW', 'CYAN', 'MAGENTA', 'PURPLE', 'ORANGE']
-    
-    # Generate 64 random values (8x8 matrix)
-    values = generate_random_matrix(64)
-    
-    # Build the matrix string
-    matrix_string = "const AttractionMatrix attractionMatrix = {\n"
-    
-    value_index = 0
-    for i, species1 in enumerate(species):
-        for j, species2 in enumerate(species):
-            value = values[value_index]
-            matrix_string += f"        {{ColorSpecies::{species1}, ColorSpecies::{species2}, {value}f}},\n"
-            value_index += 1
-        
-        # Add blank line between species groups for readability
-        if i < len(species) - 1:
-            matrix_string += "\n"
-    
-    matrix_string += "    };"
-    
+def generate_attraction_matrix_string(num_species=8):
+    species = species_names(num_species)
+
+    values = generate_random_matrix(num_species * num_species)
+
+    # Row-major weights, one row per "from" species, as defaultAttractionWeights in Color.h
+    matrix_string = f"constexpr float attractionWeights[{num_species} * {num_species}] = {{\n"
+    for i in range(num_species):
+        row = values[i * num_species:(i + 1) * num_species]
+        matrix_string += "    " + ", ".join(f"{value:4.1f}f" for value in row) + f", // {species[i]}\n"
+    matrix_string += "};\n"
+    matrix_string += f"const AttractionMatrix attractionMatrix({num_species}, attractionWeights);"
+
     return matrix_string
 
 if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Write a random attraction matrix file.")
+    parser.add_argument("--species", type=int, default=8,
+                        help=f"number of species ({MIN_SPECIES}-{MAX_SPECIES}, default 8)")
+    parser.add_argument("--output", default="attraction_matrix.txt", help="file to write")
+    args = parser.parse_args()
+    if not MIN_SPECIES <= args.species <= MAX_SPECIES:
+        parser.error(f"--species must be between {MIN_SPECIES} and {MAX_SPECIES}")
+
     # Write to file instead of printing C++ code
-    write_attraction_matrix_to_file()
+    write_attraction_matrix_to_file(args.output, args.species)
     print("Run the C++ program to use the generated attraction matrix.")
\ No newline at end of file